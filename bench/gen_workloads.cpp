@@ -0,0 +1,251 @@
+// Generates the benchmark workloads in bench/workloads/: one raw firmware
+// image per workload plus manifest.txt, which vesp-bench reads for the
+// cycle budget and the registers each program expects at entry. The
+// emulator's ISA has no immediate loads, so addresses and constants come
+// in through registers instead of a literal pool.
+//
+// The images are checked in; rerun this (make bench-workloads) only when
+// a workload changes, so results stay comparable across commits.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t FIRMWARE_BASE = 0x40080000;
+constexpr uint32_t UART_BASE = 0x3FF40000;
+constexpr uint32_t GPIO_BASE = 0x3FF44000;
+
+// A tiny assembler for the emulator's instruction encodings
+class Program {
+private:
+    std::vector<uint8_t> bytes;
+
+    void narrow(uint32_t word) {
+        bytes.push_back(static_cast<uint8_t>(word));
+        bytes.push_back(static_cast<uint8_t>(word >> 8));
+    }
+
+    void wide(uint32_t word) {
+        narrow(word);
+        bytes.push_back(static_cast<uint8_t>(word >> 16));
+    }
+
+    // L32I.N/S32I.N share bits [11:8] between the register and the offset,
+    // so register r can only reach base + 16r .. base + 16r + 15
+    static uint32_t memoryOffset(unsigned reg, uint32_t offset) {
+        if (offset >> 4 != reg) {
+            throw std::logic_error("Offset " + std::to_string(offset) + " unreachable for a" + std::to_string(reg));
+        }
+        return offset;
+    }
+
+public:
+    uint32_t here() const { return FIRMWARE_BASE + static_cast<uint32_t>(bytes.size()); }
+    const std::vector<uint8_t>& image() const { return bytes; }
+
+    void l32i(unsigned r, unsigned s, uint32_t offset) { narrow(0x0 | memoryOffset(r, offset) << 4 | s << 12); }
+    void s32i(unsigned r, unsigned s, uint32_t offset) { narrow(0x1 | memoryOffset(r, offset) << 4 | s << 12); }
+    void add(unsigned r, unsigned s, unsigned t) { narrow(0x2 | t << 4 | r << 8 | s << 12); }
+    void jmp(unsigned r) { narrow(0x3 | r << 8); }
+    void nop() { narrow(0x4); }
+    void sub(unsigned r, unsigned s, unsigned t) { narrow(0x5 | t << 4 | r << 8 | s << 12); }
+    void mov(unsigned r, unsigned s) { narrow(0x6 | r << 8 | s << 12); }
+    // Forward branch of up to 15 halfwords; as is implied by the offset's high nibble (a0)
+    void beqz0(unsigned t, unsigned halfwords) { narrow(0x7 | (halfwords & 0x0F) << 4 | t << 12); }
+    void waiti() { narrow(0x8); }
+    void mula(unsigned s, unsigned t) { wide(0xB | 0x2 << 4 | s << 12 | t << 16); }
+
+    // LOOP reg ... loopEnd(): the body runs reg times
+    size_t loop(unsigned reg) {
+        size_t at = bytes.size();
+        wide(0xA | reg << 8);
+        return at;
+    }
+
+    void loopEnd(size_t at) {
+        // LEND = LOOP address + 4 + imm8
+        size_t imm = bytes.size() - at - 4;
+        if (imm > 0xFF) {
+            throw std::logic_error("Loop body too long");
+        }
+        bytes[at + 2] = static_cast<uint8_t>(imm);
+    }
+};
+
+struct Workload {
+    std::string name;
+    uint64_t cycles;
+    Program program;
+    std::map<unsigned, uint32_t> registers;
+};
+
+// ALU chain plus a multiply-accumulate, the inner loop of most DSP code
+Workload integerKernel() {
+    Workload w{"integer", 30000000, {}, {}};
+    Program& p = w.program;
+    uint32_t start = p.here();
+    size_t loop = p.loop(2);
+    p.add(4, 4, 5);
+    p.add(5, 5, 4);
+    p.sub(6, 6, 4);
+    p.mula(4, 5);
+    p.add(7, 7, 6);
+    p.loopEnd(loop);
+    p.jmp(3);
+    w.registers = {{2, 1000}, {3, start}, {4, 1}, {5, 1}};
+    return w;
+}
+
+// Word-by-word copy of 16KB between two RAM buffers, unrolled by four
+Workload memoryCopy() {
+    constexpr uint32_t SOURCE = 0x3FFA0000;
+    constexpr uint32_t DESTINATION = 0x3FFB0000;
+    constexpr uint32_t BYTES = 0x4000;
+
+    Workload w{"memcpy", 20000000, {}, {}};
+    Program& p = w.program;
+    uint32_t start = p.here();
+    size_t loop = p.loop(2);
+    for (uint32_t offset = 0; offset < 16; offset += 4) {
+        p.l32i(0, 8, offset);
+        p.s32i(0, 9, offset);
+    }
+    p.add(8, 8, 10);
+    p.add(9, 9, 10);
+    p.loopEnd(loop);
+    p.mov(8, 11);
+    p.mov(9, 12);
+    p.jmp(3);
+    w.registers = {{2, BYTES / 16}, {3, start}, {8, SOURCE}, {9, DESTINATION},
+                   {10, 16}, {11, SOURCE}, {12, DESTINATION}};
+    return w;
+}
+
+// Status-register polling: UART status and GPIO levels, test and branch
+Workload mmioPolling() {
+    Workload w{"mmio-poll", 10000000, {}, {}};
+    Program& p = w.program;
+    uint32_t start = p.here();
+    p.l32i(0, 8, 0x04);          // UART status
+    p.beqz0(13, 0);              // a13 never matches, so this falls through
+    p.l32i(0, 9, 0x0C);          // GPIO IN (0x3C)
+    p.beqz0(13, 0);
+    p.jmp(3);
+    w.registers = {{3, start}, {8, UART_BASE}, {9, GPIO_BASE + 0x30}, {13, 0xFFFFFFFF}};
+    return w;
+}
+
+// printf-style logging: 15 characters and a newline per line
+Workload uartLogging() {
+    Workload w{"uart-log", 10000000, {}, {}};
+    Program& p = w.program;
+    uint32_t start = p.here();
+    size_t loop = p.loop(2);
+    for (int i = 0; i < 15; i++) {
+        p.s32i(0, 8, 0x00);
+    }
+    p.s32i(1, 9, 0x10);
+    p.loopEnd(loop);
+    p.jmp(3);
+    w.registers = {{0, 'x'}, {1, '\n'}, {2, 64}, {3, start}, {8, UART_BASE}, {9, UART_BASE - 0x10}};
+    return w;
+}
+
+// Two levels of small calls (call0-style: return address in a0)
+Workload callHeavy() {
+    Workload w{"call-heavy", 20000000, {}, {}};
+    Program& p = w.program;
+    uint32_t start = p.here();
+    size_t loop = p.loop(2);
+    p.mov(0, 6);
+    p.jmp(5);                    // call f
+    uint32_t returnFromF = p.here();
+    p.add(7, 7, 4);
+    p.loopEnd(loop);
+    p.jmp(3);
+
+    uint32_t f = p.here();
+    p.add(8, 8, 9);
+    p.mov(12, 0);
+    p.mov(0, 10);
+    p.jmp(11);                   // call g
+    uint32_t returnFromG = p.here();
+    p.mov(0, 12);
+    p.jmp(0);
+
+    uint32_t g = p.here();
+    p.add(9, 9, 8);
+    p.sub(13, 13, 9);
+    p.jmp(0);
+
+    w.registers = {{2, 1000}, {3, start}, {4, 1}, {5, f}, {6, returnFromF},
+                   {9, 1}, {10, returnFromG}, {11, g}};
+    return w;
+}
+
+// Toggle a GPIO pin with its interrupt enabled, sleep in WAITI until the
+// change wakes the core, acknowledge, repeat
+Workload interruptHeavy() {
+    Workload w{"interrupt-heavy", 10000000, {}, {}};
+    Program& p = w.program;
+    p.s32i(1, 7, 0x10);          // ENABLE = 1
+    p.s32i(8, 9, 0x80);          // PIN_CONFIG(0) = interrupt on either edge
+    uint32_t loop = p.here();
+    p.s32i(1, 4, 0x10);          // OUT_W1TS
+    p.waiti();
+    p.s32i(1, 6, 0x10);          // STATUS_W1TC
+    p.s32i(1, 5, 0x10);          // OUT_W1TC
+    p.waiti();
+    p.s32i(1, 6, 0x10);
+    p.jmp(3);
+    w.registers = {{1, 1}, {3, loop}, {4, GPIO_BASE + 0x08 - 0x10}, {5, GPIO_BASE + 0x0C - 0x10},
+                   {6, GPIO_BASE + 0x4C - 0x10}, {7, GPIO_BASE + 0x20 - 0x10},
+                   {8, 0x80}, {9, GPIO_BASE + 0x54 - 0x80}};
+    return w;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = argc > 1 ? argv[1] : "bench/workloads";
+
+    std::vector<Workload> workloads = {
+        integerKernel(), memoryCopy(), mmioPolling(), uartLogging(), callHeavy(), interruptHeavy(),
+    };
+
+    std::ofstream manifest(directory + "/manifest.txt");
+    if (!manifest.is_open()) {
+        std::cerr << "Could not write " << directory << "/manifest.txt" << std::endl;
+        return 1;
+    }
+    manifest << "# Generated by bench/gen_workloads.cpp; edit that and run make bench-workloads\n";
+    manifest << "# name image cycles [aN=value ...]\n";
+
+    for (const auto& workload : workloads) {
+        std::string image = workload.name + ".bin";
+        std::ofstream file(directory + "/" + image, std::ios::binary);
+        const auto& bytes = workload.program.image();
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!file) {
+            std::cerr << "Could not write " << image << std::endl;
+            return 1;
+        }
+
+        manifest << workload.name << " " << image << " " << workload.cycles;
+        for (const auto& [reg, value] : workload.registers) {
+            char text[16];
+            std::snprintf(text, sizeof(text), "0x%x", value);
+            manifest << " a" << reg << "=" << text;
+        }
+        manifest << "\n";
+        std::cout << workload.name << ": " << bytes.size() << " bytes" << std::endl;
+    }
+    return 0;
+}
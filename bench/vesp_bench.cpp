@@ -0,0 +1,277 @@
+// Runs the workloads in bench/workloads/ and prints one JSON document with
+// host time, guest instructions, MIPS and peak RSS for each. Every workload
+// runs in a forked child so its peak RSS is its own and a crash in one
+// doesn't take down the rest.
+
+#include "Emulator.h"
+#include "peripherals/UART.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Workload {
+    std::string name;
+    std::string image;
+    uint64_t cycles;
+    std::vector<std::pair<uint8_t, uint32_t>> registers;
+};
+
+// What a child reports back through its pipe
+struct Measurement {
+    uint64_t instructions;
+    uint64_t cycles;
+    double seconds;
+    bool faulted;
+};
+
+struct Result {
+    Measurement best;
+    long peakRssKB;
+    bool ok;
+};
+
+std::vector<Workload> readManifest(const std::string& directory) {
+    std::string path = directory + "/manifest.txt";
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    std::vector<Workload> workloads;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        Workload workload;
+        if (!(fields >> workload.name >> workload.image >> workload.cycles)) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected name, image and cycles");
+        }
+        std::string assignment;
+        while (fields >> assignment) {
+            size_t equals = assignment.find('=');
+            if (assignment[0] != 'a' || equals == std::string::npos) {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": bad register " + assignment);
+            }
+            unsigned long reg = std::stoul(assignment.substr(1, equals - 1));
+            if (reg > 15) {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": bad register " + assignment);
+            }
+            workload.registers.emplace_back(static_cast<uint8_t>(reg),
+                                            static_cast<uint32_t>(std::stoul(assignment.substr(equals + 1), nullptr, 0)));
+        }
+        workload.image = directory + "/" + workload.image;
+        workloads.push_back(workload);
+    }
+    return workloads;
+}
+
+std::vector<uint8_t> readImage(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Child side: build a fresh emulator, run the workload once, report
+Measurement measure(const Workload& workload, uint64_t cycles, bool timing) {
+    std::vector<uint8_t> image = readImage(workload.image);
+
+    Emulator emulator;
+    if (timing) {
+        emulator.enableTiming();
+    }
+    if (UART* uart = emulator.getUART()) {
+        uart->setOutputCallback([](uint8_t) {});
+    }
+    emulator.loadFirmware(image);
+    for (const auto& [reg, value] : workload.registers) {
+        emulator.getCPU()->setRegister(reg, value);
+    }
+
+    uint64_t startInstructions = emulator.getCPU()->getRetiredInstructions();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t ran = emulator.runFor(cycles);
+    auto end = std::chrono::steady_clock::now();
+
+    return {emulator.getCPU()->getRetiredInstructions() - startInstructions, ran,
+            std::chrono::duration<double>(end - start).count(), emulator.hasFaulted()};
+}
+
+Result runWorkload(const Workload& workload, uint64_t cycles, int repeat, bool timing) {
+    Result result{{0, 0, 0.0, false}, 0, false};
+
+    for (int i = 0; i < repeat; i++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error(std::string("fork: ") + std::strerror(errno));
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            // Banners and guest output would mix into the JSON
+            int devNull = open("/dev/null", O_WRONLY);
+            if (devNull >= 0) {
+                dup2(devNull, STDOUT_FILENO);
+            }
+            int status = 0;
+            try {
+                Measurement measurement = measure(workload, cycles, timing);
+                if (write(fds[1], &measurement, sizeof(measurement)) != sizeof(measurement)) {
+                    status = 1;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << workload.name << ": " << e.what() << std::endl;
+                status = 1;
+            }
+            _exit(status);
+        }
+
+        close(fds[1]);
+        Measurement measurement{};
+        bool received = read(fds[0], &measurement, sizeof(measurement)) == sizeof(measurement);
+        close(fds[0]);
+
+        int status = 0;
+        struct rusage usage{};
+        wait4(pid, &status, 0, &usage);
+        if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return result;
+        }
+
+        // ru_maxrss is in kilobytes on Linux
+        result.peakRssKB = std::max(result.peakRssKB, usage.ru_maxrss);
+        if (!result.ok || measurement.seconds < result.best.seconds) {
+            result.best = measurement;
+        }
+        result.ok = true;
+    }
+    return result;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [options] [workload...]" << std::endl;
+    std::cerr << "  Runs the benchmark workloads and prints the results as JSON" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --workloads <dir>    Workload directory (default bench/workloads)" << std::endl;
+    std::cerr << "  --repeat <n>         Run each workload n times and keep the fastest (default 3)" << std::endl;
+    std::cerr << "  --scale <x>          Multiply every workload's cycle budget by x" << std::endl;
+    std::cerr << "  --label <text>       Tag the results, usually with the commit" << std::endl;
+    std::cerr << "  --timing             Run with the timing model, so cycles are predicted device cycles" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = "bench/workloads";
+    std::string label;
+    int repeat = 3;
+    double scale = 1.0;
+    bool timing = false;
+    std::vector<std::string> selected;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--workloads" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--scale" && i + 1 < argc) {
+            scale = std::stod(argv[++i]);
+        } else if (arg == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        } else if (arg == "--timing") {
+            timing = true;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            selected.push_back(arg);
+        }
+    }
+
+    std::vector<Workload> workloads;
+    try {
+        workloads = readManifest(directory);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    bool allOk = true;
+    std::cout << "{\n  \"label\": " << jsonString(label) << ",\n  \"repeat\": " << repeat
+              << ",\n  \"timing\": " << (timing ? "true" : "false")
+              << ",\n  \"workloads\": [";
+    bool first = true;
+    for (const auto& workload : workloads) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), workload.name) == selected.end()) {
+            continue;
+        }
+
+        uint64_t cycles = static_cast<uint64_t>(static_cast<double>(workload.cycles) * scale);
+        Result result = runWorkload(workload, cycles, repeat, timing);
+        const Measurement& m = result.best;
+        double mips = result.ok && m.seconds > 0 ? static_cast<double>(m.instructions) / m.seconds / 1e6 : 0.0;
+        bool ok = result.ok && !m.faulted;
+        allOk = allOk && ok;
+
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "%s\n    {\"name\": %s, \"ok\": %s, \"instructions\": %llu, \"cycles\": %llu, "
+                      "\"host_seconds\": %.6f, \"mips\": %.2f, \"peak_rss_kb\": %ld}",
+                      first ? "" : ",", jsonString(workload.name).c_str(), ok ? "true" : "false",
+                      static_cast<unsigned long long>(m.instructions), static_cast<unsigned long long>(m.cycles),
+                      m.seconds, mips, result.peakRssKB);
+        std::cout << line << std::flush;
+        first = false;
+
+        std::fprintf(stderr, "%-16s %8.2f MIPS %12llu instr %8.3f s %8ld KB%s\n", workload.name.c_str(), mips,
+                     static_cast<unsigned long long>(m.instructions), m.seconds, result.peakRssKB,
+                     ok ? "" : "  FAILED");
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+
+    return allOk ? 0 : 1;
+}
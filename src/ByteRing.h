@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+
+// Fixed-capacity byte FIFO for peripheral buffers. Storage is allocated once
+// up front, so pushing, popping and clearing never allocate. Bytes pushed
+// into a full ring are dropped, the way a hardware FIFO overflows.
+class ByteRing {
+private:
+    std::unique_ptr<uint8_t[]> storage;
+    size_t mask;
+    size_t head;  // Bytes ever popped; the oldest byte is at head & mask
+    size_t tail;  // Bytes ever pushed
+
+public:
+    explicit ByteRing(size_t capacity) : storage(new uint8_t[capacity]), mask(capacity - 1), head(0), tail(0) {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("ByteRing capacity must be a power of two");
+        }
+    }
+
+    bool push(uint8_t byte) {
+        if (size() == capacity()) {
+            return false;
+        }
+        storage[tail++ & mask] = byte;
+        return true;
+    }
+
+    // Returns how many bytes fit
+    size_t push(const uint8_t* data, size_t length) {
+        length = std::min(length, capacity() - size());
+        for (size_t i = 0; i < length; i++) {
+            storage[(tail + i) & mask] = data[i];
+        }
+        tail += length;
+        return length;
+    }
+
+    uint8_t front() const { return storage[head & mask]; }
+    void pop(size_t count = 1) { head += std::min(count, size()); }
+
+    // index 0 is the oldest byte
+    uint8_t operator[](size_t index) const { return storage[(head + index) & mask]; }
+
+    // The oldest count bytes as one run, for handing to DMA. If they wrap
+    // around the end of storage the ring is rotated in place first.
+    const uint8_t* contiguous(size_t count) {
+        size_t start = head & mask;
+        if (start + count > capacity()) {
+            std::rotate(storage.get(), storage.get() + start, storage.get() + capacity());
+            tail = size();
+            head = 0;
+            start = 0;
+        }
+        return storage.get() + start;
+    }
+
+    bool empty() const { return head == tail; }
+    size_t size() const { return tail - head; }
+    size_t capacity() const { return mask + 1; }
+    void clear() { head = tail = 0; }
+};
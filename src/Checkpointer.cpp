@@ -0,0 +1,370 @@
+#include "Checkpointer.h"
+#include "Memory.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'V', 'E', 'S', 'P', 'C', 'K', 'P', '1'};
+constexpr uint32_t FRAME_MAGIC = 0x54504B43;  // "CKPT"
+
+enum PageEncoding : uint8_t {
+    PAGE_ZERO = 0,
+    PAGE_RAW = 1,
+    PAGE_PACKED = 2,
+};
+
+template <typename T>
+void put(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T take(const uint8_t*& data, const uint8_t* end) {
+    if (static_cast<size_t>(end - data) < sizeof(T)) {
+        throw std::runtime_error("Truncated checkpoint frame");
+    }
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return value;
+}
+
+uint32_t checksum(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// PackBits: a header byte n >= 0 is followed by n + 1 literal bytes, n < 0 by
+// one byte repeated 1 - n times. RAM pages are mostly zeros and fill
+// patterns, which this handles well for almost no CPU.
+void packBits(const uint8_t* in, size_t length, std::vector<uint8_t>& out) {
+    size_t i = 0;
+    while (i < length) {
+        size_t run = 1;
+        while (i + run < length && run < 128 && in[i + run] == in[i]) run++;
+        if (run >= 3) {
+            out.push_back(static_cast<uint8_t>(1 - static_cast<int>(run)));
+            out.push_back(in[i]);
+            i += run;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < length && i - start < 128) {
+            if (i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2]) break;
+            i++;
+        }
+        out.push_back(static_cast<uint8_t>(i - start - 1));
+        out.insert(out.end(), in + start, in + i);
+    }
+}
+
+void unpackBits(const uint8_t* in, size_t length, uint8_t* out, size_t outLength) {
+    const uint8_t* end = in + length;
+    size_t written = 0;
+    while (in < end) {
+        int8_t header = static_cast<int8_t>(*in++);
+        if (header >= 0) {
+            size_t count = static_cast<size_t>(header) + 1;
+            if (static_cast<size_t>(end - in) < count || written + count > outLength) {
+                throw std::runtime_error("Corrupt checkpoint page");
+            }
+            std::memcpy(out + written, in, count);
+            in += count;
+            written += count;
+        } else if (header != -128) {
+            size_t count = static_cast<size_t>(1 - header);
+            if (in == end || written + count > outLength) {
+                throw std::runtime_error("Corrupt checkpoint page");
+            }
+            std::memset(out + written, *in++, count);
+            written += count;
+        }
+    }
+    if (written != outLength) {
+        throw std::runtime_error("Corrupt checkpoint page");
+    }
+}
+
+void writeAll(int fd, const uint8_t* data, size_t length) {
+    while (length) {
+        ssize_t result = ::write(fd, data, length);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Checkpoint write failed: ") + std::strerror(errno));
+        }
+        data += result;
+        length -= static_cast<size_t>(result);
+    }
+}
+
+}
+
+Checkpointer::Checkpointer(const std::string& checkpointPath, uint32_t fullInterval)
+    : path(checkpointPath), fullEvery(std::max<uint32_t>(fullInterval, 1)), fd(-1), sequence(0),
+      writing(false), stopping(false), written(0), bytesWritten(0) {
+    writer = std::thread([this]() { writerLoop(); });
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    writer.join();
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool Checkpointer::busy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending || writing;
+}
+
+void Checkpointer::submit(std::unique_ptr<Frame> frame) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+        // Normally the caller checks busy() first, so this doesn't wait
+        idle.wait(lock, [this]() { return !pending; });
+        pending = std::move(frame);
+    }
+    sequence++;
+    wakeWriter.notify_one();
+}
+
+void Checkpointer::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return !pending && !writing; });
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+uint64_t Checkpointer::getWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+uint64_t Checkpointer::getBytesWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesWritten;
+}
+
+void Checkpointer::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wakeWriter.wait(lock, [this]() { return pending || stopping; });
+        if (!pending) {
+            break;
+        }
+
+        std::unique_ptr<Frame> frame = std::move(pending);
+        writing = true;
+        lock.unlock();
+
+        std::string failure;
+        try {
+            if (error.empty()) {
+                writeFrame(*frame);
+            }
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+        frame.reset();
+
+        lock.lock();
+        writing = false;
+        if (!failure.empty()) {
+            error = failure;
+        }
+        idle.notify_all();
+    }
+}
+
+void Checkpointer::writeFrame(const Frame& frame) {
+    std::vector<uint8_t> body;
+    body.reserve(frame.pageData.size() / 4 + 4096);
+
+    put(body, frame.full);
+    put(body, static_cast<uint32_t>(sizeof(XtensaLX6::State)));
+    put(body, frame.cpu);
+    put(body, frame.cycles);
+
+    put(body, static_cast<uint32_t>(frame.peripherals.size()));
+    for (const auto& state : frame.peripherals) {
+        put(body, static_cast<uint32_t>(state.size()));
+        body.insert(body.end(), state.begin(), state.end());
+    }
+
+    put(body, static_cast<uint32_t>(frame.pages.size()));
+    std::vector<uint8_t> packed;
+    for (size_t i = 0; i < frame.pages.size(); i++) {
+        const uint8_t* page = frame.pageData.data() + i * Memory::PAGE_SIZE;
+        put(body, frame.pages[i]);
+
+        if (std::all_of(page, page + Memory::PAGE_SIZE, [](uint8_t byte) { return byte == 0; })) {
+            put(body, PAGE_ZERO);
+            continue;
+        }
+
+        packed.clear();
+        packBits(page, Memory::PAGE_SIZE, packed);
+        if (packed.size() < Memory::PAGE_SIZE) {
+            put(body, PAGE_PACKED);
+            put(body, static_cast<uint32_t>(packed.size()));
+            body.insert(body.end(), packed.begin(), packed.end());
+        } else {
+            put(body, PAGE_RAW);
+            body.insert(body.end(), page, page + Memory::PAGE_SIZE);
+        }
+    }
+
+    std::vector<uint8_t> record;
+    record.reserve(body.size() + 12);
+    put(record, FRAME_MAGIC);
+    put(record, static_cast<uint32_t>(body.size()));
+    record.insert(record.end(), body.begin(), body.end());
+    put(record, checksum(body.data(), body.size()));
+
+    if (frame.full || fd < 0) {
+        // Build the new file beside the old one and swap it in, so there is
+        // a complete checkpoint on disk at every moment
+        std::string temporary = path + ".tmp";
+        int next = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (next < 0) {
+            throw std::runtime_error("Could not create " + temporary + ": " + std::strerror(errno));
+        }
+        try {
+            writeAll(next, reinterpret_cast<const uint8_t*>(FILE_MAGIC), sizeof(FILE_MAGIC));
+            writeAll(next, record.data(), record.size());
+            if (fdatasync(next) < 0 || rename(temporary.c_str(), path.c_str()) < 0) {
+                throw std::runtime_error("Could not replace " + path + ": " + std::strerror(errno));
+            }
+        } catch (...) {
+            close(next);
+            throw;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = next;
+    } else {
+        writeAll(fd, record.data(), record.size());
+        if (fdatasync(fd) < 0) {
+            throw std::runtime_error(std::string("Checkpoint sync failed: ") + std::strerror(errno));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    written++;
+    bytesWritten += record.size();
+}
+
+Checkpointer::Image Checkpointer::load(const std::string& path, size_t ramSize) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open checkpoint: " + path);
+    }
+    std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (contents.size() < sizeof(FILE_MAGIC) || std::memcmp(contents.data(), FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        throw std::runtime_error("Not a vesp checkpoint: " + path);
+    }
+
+    Image image{};
+    image.ram.assign(ramSize, 0);
+
+    const uint8_t* data = contents.data() + sizeof(FILE_MAGIC);
+    const uint8_t* end = contents.data() + contents.size();
+    while (static_cast<size_t>(end - data) >= 8) {
+        const uint8_t* header = data;
+        uint32_t magic = take<uint32_t>(header, end);
+        uint32_t length = take<uint32_t>(header, end);
+        if (magic != FRAME_MAGIC || static_cast<size_t>(end - header) < static_cast<size_t>(length) + 4) {
+            break;  // Torn tail from an interrupted write
+        }
+        const uint8_t* body = header;
+        const uint8_t* bodyEnd = body + length;
+        const uint8_t* trailer = bodyEnd;
+        if (take<uint32_t>(trailer, end) != checksum(body, length)) {
+            break;
+        }
+        data = trailer;
+
+        bool full = take<bool>(body, bodyEnd);
+        if (image.frames == 0 && !full) {
+            throw std::runtime_error("Checkpoint does not start with a full frame");
+        }
+        if (take<uint32_t>(body, bodyEnd) != sizeof(XtensaLX6::State)) {
+            throw std::runtime_error("Checkpoint was written by an incompatible vesp build");
+        }
+        image.cpu = take<XtensaLX6::State>(body, bodyEnd);
+        image.cycles = take<uint64_t>(body, bodyEnd);
+
+        image.peripherals.resize(take<uint32_t>(body, bodyEnd));
+        for (auto& state : image.peripherals) {
+            uint32_t size = take<uint32_t>(body, bodyEnd);
+            if (static_cast<size_t>(bodyEnd - body) < size) {
+                throw std::runtime_error("Truncated checkpoint frame");
+            }
+            state.assign(body, body + size);
+            body += size;
+        }
+
+        uint32_t pageCount = take<uint32_t>(body, bodyEnd);
+        for (uint32_t i = 0; i < pageCount; i++) {
+            uint32_t index = take<uint32_t>(body, bodyEnd);
+            if ((static_cast<size_t>(index) + 1) * Memory::PAGE_SIZE > ramSize) {
+                throw std::runtime_error("Checkpoint page outside RAM");
+            }
+            uint8_t* page = image.ram.data() + static_cast<size_t>(index) * Memory::PAGE_SIZE;
+
+            switch (take<uint8_t>(body, bodyEnd)) {
+                case PAGE_ZERO:
+                    std::memset(page, 0, Memory::PAGE_SIZE);
+                    break;
+                case PAGE_RAW:
+                    if (static_cast<size_t>(bodyEnd - body) < Memory::PAGE_SIZE) {
+                        throw std::runtime_error("Truncated checkpoint frame");
+                    }
+                    std::memcpy(page, body, Memory::PAGE_SIZE);
+                    body += Memory::PAGE_SIZE;
+                    break;
+                case PAGE_PACKED: {
+                    uint32_t size = take<uint32_t>(body, bodyEnd);
+                    if (static_cast<size_t>(bodyEnd - body) < size) {
+                        throw std::runtime_error("Truncated checkpoint frame");
+                    }
+                    unpackBits(body, size, page, Memory::PAGE_SIZE);
+                    body += size;
+                    break;
+                }
+                default:
+                    throw std::runtime_error("Corrupt checkpoint page");
+            }
+        }
+        image.frames++;
+    }
+
+    if (image.frames == 0) {
+        throw std::runtime_error("No complete checkpoint in " + path);
+    }
+    return image;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "XtensaLX6.h"
+
+
+// Streaming checkpoints for long runs. The emulator thread only copies the
+// CPU state, peripheral state and the RAM pages written since the previous
+// checkpoint into a Frame; a writer thread compresses the pages and appends
+// the frame to the file. Every so often (and always first) a full frame is
+// written to a new file that atomically replaces the old one, so the file
+// never grows without bound. A frame cut off by a crash is ignored on load.
+class Checkpointer {
+public:
+    struct Frame {
+        bool full;
+        XtensaLX6::State cpu;
+        uint64_t cycles;
+        std::vector<std::vector<uint8_t>> peripherals;
+        std::vector<uint32_t> pages;      // RAM page indices
+        std::vector<uint8_t> pageData;    // Memory::PAGE_SIZE bytes per page
+    };
+
+    // Everything needed to rebuild an emulator from a checkpoint file
+    struct Image {
+        XtensaLX6::State cpu;
+        uint64_t cycles;
+        std::vector<std::vector<uint8_t>> peripherals;
+        std::vector<uint8_t> ram;
+        uint64_t frames;
+    };
+
+private:
+    std::string path;
+    uint32_t fullEvery;
+    int fd;
+    uint64_t sequence;
+
+    std::mutex mutex;
+    std::condition_variable wakeWriter;
+    std::condition_variable idle;
+    std::unique_ptr<Frame> pending;
+    bool writing;
+    bool stopping;
+    std::string error;
+    uint64_t written;
+    uint64_t bytesWritten;
+    std::thread writer;
+
+    void writerLoop();
+    void writeFrame(const Frame& frame);
+
+public:
+    explicit Checkpointer(const std::string& path, uint32_t fullEvery = 64);
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    // True while the previous frame is still being written; the caller
+    // should keep its dirty pages and try again later
+    bool busy();
+
+    // Whether the next frame has to carry every page
+    bool needsFull() const { return sequence % fullEvery == 0; }
+
+    // Hands a frame to the writer thread. Throws if an earlier write failed.
+    void submit(std::unique_ptr<Frame> frame);
+
+    // Blocks until everything submitted is on disk
+    void flush();
+
+    uint64_t getWritten();
+    uint64_t getBytesWritten();
+    const std::string& getPath() const { return path; }
+
+    // Replays a checkpoint file up to its last complete frame
+    static Image load(const std::string& path, size_t ramSize);
+};
@@ -0,0 +1,108 @@
+#include "Coverage.h"
+#include "Dwarf.h"
+#include "ElfFile.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+Coverage::Coverage(uint32_t base, uint32_t size) : Coverage(std::vector<Range>{{base, size}}) {
+}
+
+Coverage::Coverage(const std::vector<Range>& ranges) {
+    uint64_t bits = 0;
+    for (const Range& range : ranges) {
+        spans.push_back({range.base, range.size, bits});
+        bits += (static_cast<uint64_t>(range.size) + 63) & ~63ULL;
+    }
+    words.assign(bits / 64, 0);
+}
+
+bool Coverage::isExecuted(uint32_t address) const {
+    const Span* span = spanFor(address);
+    if (!span) return false;
+    uint64_t bit = span->firstBit + (address - span->base);
+    return (words[bit >> 6] >> (bit & 63)) & 1;
+}
+
+bool Coverage::anyExecuted(uint64_t begin, uint64_t end) const {
+    for (const Span& span : spans) {
+        uint64_t first = std::max<uint64_t>(begin, span.base);
+        uint64_t last = std::min<uint64_t>(end, static_cast<uint64_t>(span.base) + span.length);
+        for (uint64_t address = first; address < last; address++) {
+            if (isExecuted(static_cast<uint32_t>(address))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t Coverage::countExecuted() const {
+    size_t count = 0;
+    for (uint64_t word : words) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+void Coverage::clear() {
+    std::fill(words.begin(), words.end(), 0);
+}
+
+void Coverage::merge(const Coverage& other) {
+    bool sameLayout = other.spans.size() == spans.size() &&
+                      std::equal(spans.begin(), spans.end(), other.spans.begin(), [](const Span& a, const Span& b) {
+                          return a.base == b.base && a.length == b.length;
+                      });
+    if (!sameLayout) {
+        throw std::invalid_argument("Coverage bitmaps cover different ranges");
+    }
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] |= other.words[i];
+    }
+}
+
+void Coverage::merge(const uint8_t* bitmap, size_t size) {
+    if (size != this->size()) {
+        throw std::invalid_argument("Coverage bitmap size mismatch");
+    }
+    for (size_t i = 0; i < words.size(); i++) {
+        uint64_t word;
+        std::memcpy(&word, bitmap + i * sizeof(uint64_t), sizeof(word));
+        words[i] |= word;
+    }
+}
+
+void Coverage::writeLcov(const ElfFile& elf, std::ostream& out, const std::string& testName) const {
+    DwarfLineTable lines(elf.sectionData(".debug_line"),
+                         elf.sectionData(".debug_line_str"),
+                         elf.sectionData(".debug_str"));
+    if (lines.empty()) {
+        throw std::runtime_error("ELF has no DWARF line table; build the firmware with -g");
+    }
+
+    // file -> line -> hit
+    std::map<uint32_t, std::map<uint32_t, bool>> hits;
+    for (const auto& range : lines.getRanges()) {
+        if (range.line == 0) continue;
+        bool& hit = hits[range.file][range.line];
+        hit = hit || anyExecuted(range.begin, range.end);
+    }
+
+    const auto& files = lines.getFiles();
+    for (const auto& [file, fileLines] : hits) {
+        out << "TN:" << testName << "\n";
+        out << "SF:" << files[file] << "\n";
+
+        size_t linesHit = 0;
+        for (const auto& [line, hit] : fileLines) {
+            out << "DA:" << line << "," << (hit ? 1 : 0) << "\n";
+            linesHit += hit;
+        }
+
+        out << "LF:" << fileLines.size() << "\n";
+        out << "LH:" << linesHit << "\n";
+        out << "end_of_record\n";
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class ElfFile;
+
+
+// Execution bitmap with one bit per guest byte address. The CPU sets the bits
+// for every instruction of a decoded block as it enters it; bitmaps from
+// separate runs OR together.
+// Each RAM region gets its own stretch of bits, so code running from an
+// alias (an instruction window over data RAM) is seen at its own addresses.
+class Coverage {
+public:
+    struct Range {
+        uint32_t base;
+        uint32_t size;
+    };
+
+private:
+    struct Span {
+        uint32_t base;
+        uint32_t length;
+        uint64_t firstBit;   // Word-aligned start of this range in the bitmap
+    };
+    std::vector<Span> spans;
+    std::vector<uint64_t> words;
+
+    const Span* spanFor(uint32_t address) const {
+        for (const Span& span : spans) {
+            if (address - span.base < span.length) return &span;
+        }
+        return nullptr;
+    }
+
+public:
+    Coverage(uint32_t base, uint32_t size);
+    explicit Coverage(const std::vector<Range>& ranges);
+
+    void mark(uint32_t address) {
+        if (const Span* span = spanFor(address)) {
+            uint64_t bit = span->firstBit + (address - span->base);
+            words[bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+
+    // Marks address + n for every bit n set in offsets, at most two word ORs
+    // unless the 64 bytes run past the end of a range
+    void markEach(uint32_t address, uint64_t offsets) {
+        const Span* span = spanFor(address);
+        if (!span || static_cast<uint64_t>(address - span->base) + 64 > span->length) {
+            for (; offsets; offsets &= offsets - 1) {
+                mark(address + __builtin_ctzll(offsets));
+            }
+            return;
+        }
+        uint64_t bit = span->firstBit + (address - span->base);
+        unsigned shift = bit & 63;
+        words[bit >> 6] |= offsets << shift;
+        if (shift) {
+            words[(bit >> 6) + 1] |= offsets >> (64 - shift);
+        }
+    }
+
+    bool isExecuted(uint32_t address) const;
+    bool anyExecuted(uint64_t begin, uint64_t end) const;
+    size_t countExecuted() const;
+
+    void clear();
+    void merge(const Coverage& other);
+    void merge(const uint8_t* bitmap, size_t size);
+
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(words.data()); }
+    size_t size() const { return words.size() * sizeof(uint64_t); }
+
+    // Maps executed addresses to source lines via the ELF's .debug_line
+    void writeLcov(const ElfFile& elf, std::ostream& out, const std::string& testName = "vesp") const;
+};
@@ -0,0 +1,548 @@
+#include "Dwarf.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+// Line number program opcodes
+constexpr uint8_t DW_LNS_copy = 1;
+constexpr uint8_t DW_LNS_advance_pc = 2;
+constexpr uint8_t DW_LNS_advance_line = 3;
+constexpr uint8_t DW_LNS_set_file = 4;
+constexpr uint8_t DW_LNS_const_add_pc = 8;
+constexpr uint8_t DW_LNS_fixed_advance_pc = 9;
+
+constexpr uint8_t DW_LNE_end_sequence = 1;
+constexpr uint8_t DW_LNE_set_address = 2;
+constexpr uint8_t DW_LNE_define_file = 3;
+
+constexpr uint64_t DW_LNCT_path = 1;
+constexpr uint64_t DW_LNCT_directory_index = 2;
+
+// Attribute forms used by DWARF 5 line table entry formats
+constexpr uint64_t DW_FORM_data2 = 0x05;
+constexpr uint64_t DW_FORM_data4 = 0x06;
+constexpr uint64_t DW_FORM_data8 = 0x07;
+constexpr uint64_t DW_FORM_string = 0x08;
+constexpr uint64_t DW_FORM_block = 0x09;
+constexpr uint64_t DW_FORM_data1 = 0x0b;
+constexpr uint64_t DW_FORM_strp = 0x0e;
+constexpr uint64_t DW_FORM_udata = 0x0f;
+constexpr uint64_t DW_FORM_strx = 0x1a;
+constexpr uint64_t DW_FORM_data16 = 0x1e;
+constexpr uint64_t DW_FORM_line_strp = 0x1f;
+constexpr uint64_t DW_FORM_strx1 = 0x25;
+constexpr uint64_t DW_FORM_strx4 = 0x28;
+
+std::string stringAt(const std::vector<uint8_t>& section, uint64_t offset) {
+    if (offset >= section.size()) return {};
+    const char* start = reinterpret_cast<const char*>(section.data() + offset);
+    return std::string(start, strnlen(start, section.size() - offset));
+}
+
+std::string joinPath(const std::string& directory, const std::string& name) {
+    if (name.empty() || name[0] == '/' || directory.empty()) return name;
+    return directory.back() == '/' ? directory + name : directory + "/" + name;
+}
+
+struct EntryField {
+    std::string string;
+    uint64_t number = 0;
+};
+
+EntryField readForm(DwarfCursor& cursor, uint64_t form, unsigned offsetSize,
+                    const std::vector<uint8_t>& lineStr, const std::vector<uint8_t>& str) {
+    EntryField field;
+    switch (form) {
+        case DW_FORM_string: field.string = cursor.cstr(); break;
+        case DW_FORM_line_strp: field.string = stringAt(lineStr, cursor.sized(offsetSize)); break;
+        case DW_FORM_strp: field.string = stringAt(str, cursor.sized(offsetSize)); break;
+        case DW_FORM_udata: field.number = cursor.uleb(); break;
+        case DW_FORM_data1: field.number = cursor.u8(); break;
+        case DW_FORM_data2: field.number = cursor.u16(); break;
+        case DW_FORM_data4: field.number = cursor.u32(); break;
+        case DW_FORM_data8: field.number = cursor.u64(); break;
+        case DW_FORM_data16: cursor.skip(16); break;
+        case DW_FORM_block: cursor.skip(cursor.uleb()); break;
+        // String offsets tables are not loaded; these paths stay unnamed
+        case DW_FORM_strx: cursor.uleb(); break;
+        default:
+            if (form >= DW_FORM_strx1 && form <= DW_FORM_strx4) {
+                cursor.skip(form - DW_FORM_strx1 + 1);
+                break;
+            }
+            throw std::runtime_error("Unsupported form in DWARF line table header");
+    }
+    return field;
+}
+
+}
+
+DwarfLineTable::DwarfLineTable(const std::vector<uint8_t>& debugLine,
+                               const std::vector<uint8_t>& debugLineStr,
+                               const std::vector<uint8_t>& debugStr) {
+    DwarfCursor cursor(debugLine.data(), debugLine.size());
+    while (cursor.remaining() > 4) {
+        parseUnit(cursor, debugLineStr, debugStr);
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return a.begin < b.begin;
+    });
+}
+
+uint32_t DwarfLineTable::internFile(const std::string& path) {
+    auto it = std::find(files.begin(), files.end(), path);
+    if (it != files.end()) {
+        return static_cast<uint32_t>(it - files.begin());
+    }
+    files.push_back(path);
+    return static_cast<uint32_t>(files.size() - 1);
+}
+
+void DwarfLineTable::parseUnit(DwarfCursor& cursor, const std::vector<uint8_t>& lineStr,
+                               const std::vector<uint8_t>& str) {
+    unsigned offsetSize;
+    uint64_t unitLength = cursor.unitLength(offsetSize);
+    size_t unitEnd = cursor.offset() + unitLength;
+    if (unitLength > cursor.remaining()) {
+        throw std::runtime_error("Truncated DWARF line table unit");
+    }
+
+    uint16_t version = cursor.u16();
+    if (version < 2 || version > 5) {
+        cursor.seek(unitEnd);
+        return;
+    }
+    if (version >= 5) {
+        cursor.u8();  // address_size
+        cursor.u8();  // segment_selector_size
+    }
+
+    uint64_t headerLength = cursor.sized(offsetSize);
+    size_t programStart = cursor.offset() + headerLength;
+
+    uint8_t minInstructionLength = cursor.u8();
+    if (version >= 4) cursor.u8();  // maximum_operations_per_instruction (VLIW only)
+    cursor.u8();  // default_is_stmt
+    int8_t lineBase = static_cast<int8_t>(cursor.u8());
+    uint8_t lineRange = cursor.u8();
+    uint8_t opcodeBase = cursor.u8();
+    if (lineRange == 0) {
+        throw std::runtime_error("Invalid DWARF line_range");
+    }
+
+    std::vector<uint8_t> standardOpcodeLengths(opcodeBase, 0);
+    for (uint8_t i = 1; i < opcodeBase; i++) {
+        standardOpcodeLengths[i] = cursor.u8();
+    }
+
+    // Resolve the unit's file table straight to interned global indices
+    std::vector<std::string> directories;
+    std::vector<uint32_t> fileMap;
+
+    if (version >= 5) {
+        auto readEntries = [&](bool isFile) {
+            uint8_t formatCount = cursor.u8();
+            std::vector<std::pair<uint64_t, uint64_t>> format;
+            for (uint8_t i = 0; i < formatCount; i++) {
+                uint64_t content = cursor.uleb();
+                format.emplace_back(content, cursor.uleb());
+            }
+
+            uint64_t count = cursor.uleb();
+            for (uint64_t i = 0; i < count; i++) {
+                std::string path;
+                uint64_t directory = 0;
+                for (const auto& [content, form] : format) {
+                    EntryField field = readForm(cursor, form, offsetSize, lineStr, str);
+                    if (content == DW_LNCT_path) path = field.string;
+                    if (content == DW_LNCT_directory_index) directory = field.number;
+                }
+
+                if (isFile) {
+                    std::string dir = directory < directories.size() ? directories[directory] : std::string();
+                    fileMap.push_back(internFile(joinPath(dir, path)));
+                } else {
+                    directories.push_back(path);
+                }
+            }
+        };
+        readEntries(false);
+        readEntries(true);
+    } else {
+        directories.emplace_back();  // Index 0 is the compilation directory
+        for (std::string dir = cursor.cstr(); !dir.empty(); dir = cursor.cstr()) {
+            directories.push_back(dir);
+        }
+
+        fileMap.push_back(0);  // File numbers are 1-based before DWARF 5
+        for (std::string name = cursor.cstr(); !name.empty(); name = cursor.cstr()) {
+            uint64_t directory = cursor.uleb();
+            cursor.uleb();  // mtime
+            cursor.uleb();  // length
+            std::string dir = directory < directories.size() ? directories[directory] : std::string();
+            fileMap.push_back(internFile(joinPath(dir, name)));
+        }
+        if (fileMap.size() == 1) fileMap.clear();
+    }
+
+    cursor.seek(programStart);
+
+    uint64_t address = 0;
+    uint64_t file = 1;
+    int64_t line = 1;
+    std::vector<Range> sequence;
+
+    // Each row's range runs up to the next row's address in the same sequence
+    auto emitRow = [&]() {
+        uint32_t globalFile = file < fileMap.size() ? fileMap[file] : internFile("<unknown>");
+        sequence.push_back({address, address, globalFile, static_cast<uint32_t>(std::max<int64_t>(line, 0))});
+    };
+
+    auto endSequence = [&]() {
+        for (size_t i = 0; i < sequence.size(); i++) {
+            Range range = sequence[i];
+            range.end = (i + 1 < sequence.size()) ? sequence[i + 1].begin : address;
+            if (range.end > range.begin) ranges.push_back(range);
+        }
+        sequence.clear();
+        address = 0;
+        file = 1;
+        line = 1;
+    };
+
+    while (cursor.offset() < unitEnd) {
+        uint8_t opcode = cursor.u8();
+
+        if (opcode >= opcodeBase) {
+            uint8_t adjusted = opcode - opcodeBase;
+            address += static_cast<uint64_t>(adjusted / lineRange) * minInstructionLength;
+            line += lineBase + (adjusted % lineRange);
+            emitRow();
+            continue;
+        }
+
+        switch (opcode) {
+            case 0: {
+                uint64_t length = cursor.uleb();
+                size_t end = cursor.offset() + length;
+                uint8_t extended = length ? cursor.u8() : 0;
+                if (extended == DW_LNE_end_sequence) {
+                    endSequence();
+                } else if (extended == DW_LNE_set_address) {
+                    address = cursor.sized(static_cast<unsigned>(length - 1));
+                } else if (extended == DW_LNE_define_file) {
+                    std::string name = cursor.cstr();
+                    uint64_t directory = cursor.uleb();
+                    std::string dir = directory < directories.size() ? directories[directory] : std::string();
+                    fileMap.push_back(internFile(joinPath(dir, name)));
+                }
+                cursor.seek(end);
+                break;
+            }
+            case DW_LNS_copy:
+                emitRow();
+                break;
+            case DW_LNS_advance_pc:
+                address += cursor.uleb() * minInstructionLength;
+                break;
+            case DW_LNS_advance_line:
+                line += cursor.sleb();
+                break;
+            case DW_LNS_set_file:
+                file = cursor.uleb();
+                break;
+            case DW_LNS_const_add_pc:
+                address += static_cast<uint64_t>((255 - opcodeBase) / lineRange) * minInstructionLength;
+                break;
+            case DW_LNS_fixed_advance_pc:
+                address += cursor.u16();
+                break;
+            default:
+                // set_column, negate_stmt, prologue/epilogue markers, set_isa and
+                // anything newer: only the operand count matters here
+                for (uint8_t i = 0; i < standardOpcodeLengths[opcode]; i++) {
+                    cursor.uleb();
+                }
+                break;
+        }
+    }
+
+    cursor.seek(unitEnd);
+}
+
+namespace {
+
+constexpr uint64_t DW_TAG_inlined_subroutine = 0x1d;
+
+constexpr uint64_t DW_AT_name = 0x03;
+constexpr uint64_t DW_AT_low_pc = 0x11;
+constexpr uint64_t DW_AT_high_pc = 0x12;
+constexpr uint64_t DW_AT_abstract_origin = 0x31;
+constexpr uint64_t DW_AT_specification = 0x47;
+
+constexpr uint64_t DW_FORM_addr = 0x01;
+constexpr uint64_t DW_FORM_block2 = 0x03;
+constexpr uint64_t DW_FORM_block4 = 0x04;
+constexpr uint64_t DW_FORM_block1 = 0x0a;
+constexpr uint64_t DW_FORM_flag = 0x0c;
+constexpr uint64_t DW_FORM_sdata = 0x0d;
+constexpr uint64_t DW_FORM_ref_addr = 0x10;
+constexpr uint64_t DW_FORM_ref1 = 0x11;
+constexpr uint64_t DW_FORM_ref2 = 0x12;
+constexpr uint64_t DW_FORM_ref4 = 0x13;
+constexpr uint64_t DW_FORM_ref8 = 0x14;
+constexpr uint64_t DW_FORM_ref_udata = 0x15;
+constexpr uint64_t DW_FORM_indirect = 0x16;
+constexpr uint64_t DW_FORM_sec_offset = 0x17;
+constexpr uint64_t DW_FORM_exprloc = 0x18;
+constexpr uint64_t DW_FORM_flag_present = 0x19;
+constexpr uint64_t DW_FORM_addrx = 0x1b;
+constexpr uint64_t DW_FORM_ref_sup4 = 0x1c;
+constexpr uint64_t DW_FORM_strp_sup = 0x1d;
+constexpr uint64_t DW_FORM_ref_sig8 = 0x20;
+constexpr uint64_t DW_FORM_implicit_const = 0x21;
+constexpr uint64_t DW_FORM_loclistx = 0x22;
+constexpr uint64_t DW_FORM_rnglistx = 0x23;
+constexpr uint64_t DW_FORM_ref_sup8 = 0x24;
+constexpr uint64_t DW_FORM_addrx1 = 0x29;
+constexpr uint64_t DW_FORM_addrx4 = 0x2c;
+constexpr uint64_t DW_FORM_GNU_addr_index = 0x1f01;
+constexpr uint64_t DW_FORM_GNU_str_index = 0x1f02;
+constexpr uint64_t DW_FORM_GNU_ref_alt = 0x1f20;
+constexpr uint64_t DW_FORM_GNU_strp_alt = 0x1f21;
+
+constexpr uint8_t DW_UT_compile = 0x01;
+constexpr uint8_t DW_UT_partial = 0x03;
+
+struct AbbrevAttribute {
+    uint64_t name;
+    uint64_t form;
+    int64_t implicitConst;
+};
+
+struct Abbrev {
+    uint64_t tag;
+    bool hasChildren;
+    std::vector<AbbrevAttribute> attributes;
+};
+
+std::vector<Abbrev> parseAbbrevs(const std::vector<uint8_t>& section, uint64_t offset,
+                                 std::vector<uint64_t>& codes) {
+    std::vector<Abbrev> abbrevs;
+    codes.clear();
+
+    DwarfCursor cursor(section.data(), section.size(), offset);
+    for (uint64_t code = cursor.uleb(); code != 0; code = cursor.uleb()) {
+        Abbrev abbrev;
+        abbrev.tag = cursor.uleb();
+        abbrev.hasChildren = cursor.u8() != 0;
+        for (;;) {
+            uint64_t name = cursor.uleb();
+            uint64_t form = cursor.uleb();
+            if (name == 0 && form == 0) break;
+            int64_t implicitConst = (form == DW_FORM_implicit_const) ? cursor.sleb() : 0;
+            abbrev.attributes.push_back({name, form, implicitConst});
+        }
+        codes.push_back(code);
+        abbrevs.push_back(std::move(abbrev));
+    }
+    return abbrevs;
+}
+
+struct AttributeValue {
+    uint64_t number = 0;
+    std::string string;
+    bool isAddress = false;     // Absolute address (high_pc as address, not offset)
+    bool isReference = false;   // Absolute .debug_info offset
+};
+
+struct UnitInfo {
+    uint16_t version;
+    unsigned offsetSize;
+    unsigned addressSize;
+    size_t unitOffset;
+};
+
+AttributeValue readAttribute(DwarfCursor& cursor, uint64_t form, int64_t implicitConst, const UnitInfo& unit,
+                             const std::vector<uint8_t>& str, const std::vector<uint8_t>& lineStr) {
+    AttributeValue value;
+    switch (form) {
+        case DW_FORM_addr: value.number = cursor.sized(unit.addressSize); value.isAddress = true; break;
+        case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag: value.number = cursor.u8(); break;
+        case DW_FORM_data2: case DW_FORM_ref2: value.number = cursor.u16(); break;
+        case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_ref_sup4: value.number = cursor.u32(); break;
+        case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8: case DW_FORM_ref_sup8:
+            value.number = cursor.u64(); break;
+        case DW_FORM_data16: cursor.skip(16); break;
+        case DW_FORM_sdata: value.number = static_cast<uint64_t>(cursor.sleb()); break;
+        case DW_FORM_udata: case DW_FORM_ref_udata: case DW_FORM_strx: case DW_FORM_addrx:
+        case DW_FORM_loclistx: case DW_FORM_rnglistx:
+        case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+            value.number = cursor.uleb(); break;
+        case DW_FORM_string: value.string = cursor.cstr(); break;
+        case DW_FORM_strp: value.string = stringAt(str, cursor.sized(unit.offsetSize)); break;
+        case DW_FORM_line_strp: value.string = stringAt(lineStr, cursor.sized(unit.offsetSize)); break;
+        case DW_FORM_sec_offset: case DW_FORM_strp_sup:
+        case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+            value.number = cursor.sized(unit.offsetSize); break;
+        case DW_FORM_ref_addr:
+            value.number = cursor.sized(unit.version <= 2 ? unit.addressSize : unit.offsetSize);
+            value.isReference = true;
+            break;
+        case DW_FORM_block1: cursor.skip(cursor.u8()); break;
+        case DW_FORM_block2: cursor.skip(cursor.u16()); break;
+        case DW_FORM_block4: cursor.skip(cursor.u32()); break;
+        case DW_FORM_block: case DW_FORM_exprloc: cursor.skip(cursor.uleb()); break;
+        case DW_FORM_flag_present: value.number = 1; break;
+        case DW_FORM_implicit_const: value.number = static_cast<uint64_t>(implicitConst); break;
+        case DW_FORM_indirect: return readAttribute(cursor, cursor.uleb(), 0, unit, str, lineStr);
+        default:
+            // strx/addrx operands index tables this reader does not load
+            if (form >= DW_FORM_strx1 && form <= DW_FORM_strx4) {
+                cursor.skip(form - DW_FORM_strx1 + 1);
+                break;
+            }
+            if (form >= DW_FORM_addrx1 && form <= DW_FORM_addrx4) {
+                cursor.skip(form - DW_FORM_addrx1 + 1);
+                break;
+            }
+            throw std::runtime_error("Unsupported DWARF attribute form");
+    }
+
+    if (form == DW_FORM_ref1 || form == DW_FORM_ref2 || form == DW_FORM_ref4 ||
+        form == DW_FORM_ref8 || form == DW_FORM_ref_udata) {
+        value.number += unit.unitOffset;
+        value.isReference = true;
+    }
+    return value;
+}
+
+}
+
+DwarfInlineTable::DwarfInlineTable(const std::vector<uint8_t>& debugInfo,
+                                   const std::vector<uint8_t>& debugAbbrev,
+                                   const std::vector<uint8_t>& debugStr,
+                                   const std::vector<uint8_t>& debugLineStr) {
+    struct Pending {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t origin;
+    };
+
+    std::unordered_map<uint64_t, std::string> names;   // DIE offset -> DW_AT_name
+    std::unordered_map<uint64_t, uint64_t> origins;    // DIE offset -> abstract origin / specification
+    std::vector<Pending> pending;
+
+    std::vector<Abbrev> abbrevs;
+    std::vector<uint64_t> codes;
+    uint64_t loadedAbbrevOffset = UINT64_MAX;
+
+    DwarfCursor cursor(debugInfo.data(), debugInfo.size());
+    while (cursor.remaining() > 4) {
+        UnitInfo unit;
+        unit.unitOffset = cursor.offset();
+        uint64_t unitLength = cursor.unitLength(unit.offsetSize);
+        size_t unitEnd = cursor.offset() + unitLength;
+        if (unitLength > cursor.remaining()) break;
+
+        unit.version = cursor.u16();
+        uint8_t unitType = DW_UT_compile;
+        uint64_t abbrevOffset;
+        if (unit.version >= 5) {
+            unitType = cursor.u8();
+            unit.addressSize = cursor.u8();
+            abbrevOffset = cursor.sized(unit.offsetSize);
+        } else {
+            abbrevOffset = cursor.sized(unit.offsetSize);
+            unit.addressSize = cursor.u8();
+        }
+
+        if (unit.version < 2 || unit.version > 5 || (unitType != DW_UT_compile && unitType != DW_UT_partial)) {
+            cursor.seek(unitEnd);
+            continue;
+        }
+
+        if (abbrevOffset != loadedAbbrevOffset) {
+            abbrevs = parseAbbrevs(debugAbbrev, abbrevOffset, codes);
+            loadedAbbrevOffset = abbrevOffset;
+        }
+
+        while (cursor.offset() < unitEnd) {
+            uint64_t dieOffset = cursor.offset();
+            uint64_t code = cursor.uleb();
+            if (code == 0) continue;  // End of a sibling list
+
+            // Abbreviation codes are almost always dense and 1-based
+            const Abbrev* abbrev = nullptr;
+            if (code <= codes.size() && codes[code - 1] == code) {
+                abbrev = &abbrevs[code - 1];
+            } else {
+                auto it = std::find(codes.begin(), codes.end(), code);
+                if (it != codes.end()) abbrev = &abbrevs[it - codes.begin()];
+            }
+            if (!abbrev) break;
+
+            uint64_t lowPc = 0, highPc = 0, origin = 0;
+            bool hasLow = false, hasHigh = false, highIsOffset = false, hasOrigin = false;
+            for (const auto& attribute : abbrev->attributes) {
+                AttributeValue value = readAttribute(cursor, attribute.form, attribute.implicitConst,
+                                                     unit, debugStr, debugLineStr);
+                switch (attribute.name) {
+                    case DW_AT_name:
+                        if (!value.string.empty()) names[dieOffset] = value.string;
+                        break;
+                    case DW_AT_low_pc:
+                        lowPc = value.number;
+                        hasLow = value.isAddress;
+                        break;
+                    case DW_AT_high_pc:
+                        highPc = value.number;
+                        hasHigh = true;
+                        highIsOffset = !value.isAddress;
+                        break;
+                    case DW_AT_abstract_origin:
+                    case DW_AT_specification:
+                        if (value.isReference) {
+                            origin = value.number;
+                            hasOrigin = true;
+                        }
+                        break;
+                }
+            }
+
+            if (hasOrigin) origins[dieOffset] = origin;
+
+            if (abbrev->tag == DW_TAG_inlined_subroutine && hasLow && hasHigh) {
+                uint64_t end = highIsOffset ? lowPc + highPc : highPc;
+                if (end > lowPc) {
+                    pending.push_back({lowPc, end, hasOrigin ? origin : dieOffset});
+                }
+            }
+        }
+
+        cursor.seek(unitEnd);
+    }
+
+    ranges.reserve(pending.size());
+    for (const auto& entry : pending) {
+        std::string name = "<inlined>";
+        uint64_t offset = entry.origin;
+        for (int depth = 0; depth < 8; depth++) {
+            auto named = names.find(offset);
+            if (named != names.end()) {
+                name = named->second;
+                break;
+            }
+            auto next = origins.find(offset);
+            if (next == origins.end()) break;
+            offset = next->second;
+        }
+        ranges.push_back({entry.begin, entry.end, std::move(name)});
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return a.begin < b.begin || (a.begin == b.begin && a.end > b.end);
+    });
+}
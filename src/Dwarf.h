@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// Bounds-checked little-endian reader over a DWARF section
+class DwarfCursor {
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+
+public:
+    DwarfCursor(const uint8_t* bytes, size_t size, size_t offset = 0)
+        : data(bytes), length(size), position(offset) {}
+
+    size_t offset() const { return position; }
+    void seek(size_t offset) { position = offset; }
+    bool atEnd() const { return position >= length; }
+    size_t remaining() const { return position < length ? length - position : 0; }
+
+    void skip(size_t count) {
+        if (remaining() < count) throw std::runtime_error("DWARF read past end of section");
+        position += count;
+    }
+
+    template <typename T>
+    T read() {
+        if (remaining() < sizeof(T)) throw std::runtime_error("DWARF read past end of section");
+        T value;
+        std::memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    uint8_t u8() { return read<uint8_t>(); }
+    uint16_t u16() { return read<uint16_t>(); }
+    uint32_t u32() { return read<uint32_t>(); }
+    uint64_t u64() { return read<uint64_t>(); }
+
+    uint64_t uleb() {
+        uint64_t value = 0;
+        unsigned shift = 0;
+        uint8_t byte;
+        do {
+            byte = u8();
+            if (shift < 64) value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    int64_t sleb() {
+        int64_t value = 0;
+        unsigned shift = 0;
+        uint8_t byte;
+        do {
+            byte = u8();
+            if (shift < 64) value |= static_cast<int64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        if (shift < 64 && (byte & 0x40)) value |= -(static_cast<int64_t>(1) << shift);
+        return value;
+    }
+
+    uint64_t sized(unsigned size) {
+        switch (size) {
+            case 1: return u8();
+            case 2: return u16();
+            case 4: return u32();
+            case 8: return u64();
+            default: throw std::runtime_error("Unsupported DWARF operand size");
+        }
+    }
+
+    std::string cstr() {
+        const char* start = reinterpret_cast<const char*>(data + position);
+        size_t count = strnlen(start, remaining());
+        std::string value(start, count);
+        skip(count < remaining() ? count + 1 : count);
+        return value;
+    }
+
+    // Reads a unit length; sets offsetSize to 4 or 8 for the 32/64-bit format
+    uint64_t unitLength(unsigned& offsetSize) {
+        uint32_t value = u32();
+        if (value == 0xFFFFFFFF) {
+            offsetSize = 8;
+            return u64();
+        }
+        offsetSize = 4;
+        return value;
+    }
+};
+
+// Address -> source line ranges decoded from .debug_line
+class DwarfLineTable {
+public:
+    struct Range {
+        uint64_t begin;
+        uint64_t end;
+        uint32_t file;   // Index into getFiles()
+        uint32_t line;
+    };
+
+private:
+    std::vector<std::string> files;
+    std::vector<Range> ranges;
+
+    void parseUnit(DwarfCursor& cursor, const std::vector<uint8_t>& lineStr, const std::vector<uint8_t>& str);
+    uint32_t internFile(const std::string& path);
+
+public:
+    DwarfLineTable() = default;
+    DwarfLineTable(const std::vector<uint8_t>& debugLine,
+                   const std::vector<uint8_t>& debugLineStr,
+                   const std::vector<uint8_t>& debugStr);
+
+    const std::vector<std::string>& getFiles() const { return files; }
+    const std::vector<Range>& getRanges() const { return ranges; }
+    bool empty() const { return ranges.empty(); }
+};
+
+// Inlined subroutine address ranges decoded from .debug_info, for showing
+// the inline call chain at an address
+class DwarfInlineTable {
+public:
+    struct Range {
+        uint64_t begin;
+        uint64_t end;
+        std::string name;
+    };
+
+private:
+    std::vector<Range> ranges;
+
+public:
+    DwarfInlineTable() = default;
+    DwarfInlineTable(const std::vector<uint8_t>& debugInfo,
+                     const std::vector<uint8_t>& debugAbbrev,
+                     const std::vector<uint8_t>& debugStr,
+                     const std::vector<uint8_t>& debugLineStr);
+
+    // Sorted by begin address
+    const std::vector<Range>& getRanges() const { return ranges; }
+};
@@ -0,0 +1,152 @@
+#include "ElfFile.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint8_t ELFCLASS32 = 1;
+constexpr uint8_t ELFCLASS64 = 2;
+constexpr uint8_t ELFDATA2LSB = 1;
+
+}
+
+ElfFile::ElfFile(std::vector<uint8_t> data) : image(std::move(data)), is64(false), entry(0) {
+    parse();
+}
+
+ElfFile ElfFile::fromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open ELF file: " + path);
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return ElfFile(std::move(data));
+}
+
+bool ElfFile::isElf(const std::vector<uint8_t>& data) {
+    return data.size() >= 4 && data[0] == 0x7F && data[1] == 'E' && data[2] == 'L' && data[3] == 'F';
+}
+
+template <typename T>
+T ElfFile::readAt(uint64_t offset) const {
+    if (offset > image.size() || image.size() - offset < sizeof(T)) {
+        throw std::runtime_error("ELF read past end of file");
+    }
+    T value;
+    std::memcpy(&value, &image[offset], sizeof(T));
+    return value;
+}
+
+void ElfFile::parse() {
+    if (!isElf(image) || image.size() < 52) {
+        throw std::runtime_error("Not an ELF file");
+    }
+    if (image[5] != ELFDATA2LSB) {
+        throw std::runtime_error("Only little-endian ELF files are supported");
+    }
+    if (image[4] != ELFCLASS32 && image[4] != ELFCLASS64) {
+        throw std::runtime_error("Unknown ELF class");
+    }
+    is64 = image[4] == ELFCLASS64;
+
+    uint64_t phoff, shoff;
+    uint16_t phentsize, phnum, shentsize, shnum, shstrndx;
+    if (is64) {
+        entry = readAt<uint64_t>(24);
+        phoff = readAt<uint64_t>(32);
+        shoff = readAt<uint64_t>(40);
+        phentsize = readAt<uint16_t>(54);
+        phnum = readAt<uint16_t>(56);
+        shentsize = readAt<uint16_t>(58);
+        shnum = readAt<uint16_t>(60);
+        shstrndx = readAt<uint16_t>(62);
+    } else {
+        entry = readAt<uint32_t>(24);
+        phoff = readAt<uint32_t>(28);
+        shoff = readAt<uint32_t>(32);
+        phentsize = readAt<uint16_t>(42);
+        phnum = readAt<uint16_t>(44);
+        shentsize = readAt<uint16_t>(46);
+        shnum = readAt<uint16_t>(48);
+        shstrndx = readAt<uint16_t>(50);
+    }
+
+    for (uint16_t i = 0; i < phnum; i++) {
+        uint64_t base = phoff + static_cast<uint64_t>(i) * phentsize;
+        if (readAt<uint32_t>(base) != PT_LOAD) continue;
+
+        Segment segment;
+        if (is64) {
+            segment.offset = readAt<uint64_t>(base + 8);
+            segment.address = readAt<uint64_t>(base + 16);
+            segment.fileSize = readAt<uint64_t>(base + 32);
+            segment.memorySize = readAt<uint64_t>(base + 40);
+        } else {
+            segment.offset = readAt<uint32_t>(base + 4);
+            segment.address = readAt<uint32_t>(base + 8);
+            segment.fileSize = readAt<uint32_t>(base + 16);
+            segment.memorySize = readAt<uint32_t>(base + 20);
+        }
+        segments.push_back(segment);
+    }
+
+    std::vector<uint32_t> nameOffsets;
+    for (uint16_t i = 0; i < shnum; i++) {
+        uint64_t base = shoff + static_cast<uint64_t>(i) * shentsize;
+
+        Section section;
+        nameOffsets.push_back(readAt<uint32_t>(base));
+        section.type = readAt<uint32_t>(base + 4);
+        if (is64) {
+            section.address = readAt<uint64_t>(base + 16);
+            section.offset = readAt<uint64_t>(base + 24);
+            section.size = readAt<uint64_t>(base + 32);
+            section.link = readAt<uint32_t>(base + 40);
+            section.entrySize = readAt<uint64_t>(base + 56);
+        } else {
+            section.address = readAt<uint32_t>(base + 12);
+            section.offset = readAt<uint32_t>(base + 16);
+            section.size = readAt<uint32_t>(base + 20);
+            section.link = readAt<uint32_t>(base + 24);
+            section.entrySize = readAt<uint32_t>(base + 36);
+        }
+        sections.push_back(section);
+    }
+
+    if (shstrndx < sections.size()) {
+        const Section& names = sections[shstrndx];
+        for (size_t i = 0; i < sections.size(); i++) {
+            uint64_t offset = names.offset + nameOffsets[i];
+            if (offset >= image.size()) continue;
+            const char* name = reinterpret_cast<const char*>(&image[offset]);
+            sections[i].name.assign(name, strnlen(name, image.size() - offset));
+        }
+    }
+}
+
+const ElfFile::Section* ElfFile::findSection(const std::string& name) const {
+    for (const auto& section : sections) {
+        if (section.name == name) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<uint8_t> ElfFile::sectionData(const std::string& name) const {
+    const Section* section = findSection(name);
+    return section ? sectionData(*section) : std::vector<uint8_t>();
+}
+
+std::vector<uint8_t> ElfFile::sectionData(const Section& section) const {
+    if (section.type == SHT_NOBITS) {
+        return {};
+    }
+    if (section.offset > image.size() || image.size() - section.offset < section.size) {
+        throw std::runtime_error("ELF section " + section.name + " extends past end of file");
+    }
+    return std::vector<uint8_t>(image.begin() + section.offset, image.begin() + section.offset + section.size);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Minimal little-endian ELF reader: enough to load firmware segments and to
+// hand debug sections to the DWARF parsers. Both ELF32 (xtensa-esp32-elf)
+// and ELF64 images are accepted.
+class ElfFile {
+public:
+    struct Section {
+        std::string name;
+        uint32_t type;
+        uint64_t address;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t link;
+        uint64_t entrySize;
+    };
+
+    struct Segment {
+        uint64_t address;
+        uint64_t offset;
+        uint64_t fileSize;
+        uint64_t memorySize;
+    };
+
+    static constexpr uint32_t SHT_SYMTAB = 2;
+    static constexpr uint32_t SHT_NOBITS = 8;
+    static constexpr uint32_t PT_LOAD = 1;
+
+private:
+    std::vector<uint8_t> image;
+    bool is64;
+    uint64_t entry;
+    std::vector<Section> sections;
+    std::vector<Segment> segments;
+
+    template <typename T>
+    T readAt(uint64_t offset) const;
+    void parse();
+
+public:
+    explicit ElfFile(std::vector<uint8_t> data);
+
+    static ElfFile fromFile(const std::string& path);
+    static bool isElf(const std::vector<uint8_t>& data);
+
+    bool is64Bit() const { return is64; }
+    uint64_t getEntry() const { return entry; }
+    const std::vector<Section>& getSections() const { return sections; }
+    const std::vector<Segment>& getSegments() const { return segments; }
+
+    const Section* findSection(const std::string& name) const;
+    // Raw bytes of a section, empty for missing or NOBITS sections
+    std::vector<uint8_t> sectionData(const std::string& name) const;
+    std::vector<uint8_t> sectionData(const Section& section) const;
+    const uint8_t* data() const { return image.data(); }
+    size_t size() const { return image.size(); }
+};
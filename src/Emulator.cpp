@@ -1,10 +1,47 @@
 #include "Emulator.h"
+#include "ElfFile.h"
+#include "peripherals/UART.h"
+#include "peripherals/GPIO.h"
+#include "peripherals/WiFi.h"
+#include "peripherals/SharedMemoryPeripheral.h"
+#include "VirtualNetwork.h"
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
 
-Emulator::Emulator() : running(false), cycles(0) {
-    memory = std::make_unique<Memory>();
-    cpu = std::make_unique<XtensaLX6>(memory.get());
+namespace {
+
+// Peripheral types a SoC description can name
+std::unique_ptr<Peripheral> createPeripheral(const SocDescription::PeripheralEntry& entry, bool quiet) {
+    if (entry.type == "uart") return std::make_unique<UART>(entry.base, quiet);
+    if (entry.type == "gpio") return std::make_unique<GPIO>(entry.base, quiet);
+    if (entry.type == "wifi") return std::make_unique<WiFi>(entry.base, quiet);
+    throw std::invalid_argument("Unknown peripheral type in SoC description: " + entry.type);
+}
+
+std::string hexAddress(uint32_t address) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "0x%08x", address);
+    return text;
+}
+
+}
+
+Emulator::Emulator() : Emulator(SocDescription::esp32()) {
+}
+
+Emulator::Emulator(const SocDescription& description, bool quietOutput)
+    : soc(description), quiet(quietOutput), uart(nullptr), gpio(nullptr), wifi(nullptr), checkpointInterval(0), nextCheckpoint(UINT64_MAX),
+      running(false), faulted(false), faultReporting(true), cycles(0), mmioAccesses(0), stallCycles(0), dirtySinceReset(false), commands(0), paused(false),
+      runState(RunState::Idle), peekRequest(nullptr),
+      clockHz(description.clockHz), pacing(false), idleSleep(false) {
+    memory = std::make_unique<Memory>(soc, quiet);
+    cpu = std::make_unique<XtensaLX6>(memory.get(), quiet);
+    peripheralSlots.assign(memory->getMmioSlotCount(), nullptr);
     
     memory->setPeripheralCallbacks(
         [this](uint32_t addr) { return readPeripheral8(addr); },
@@ -15,13 +52,19 @@ Emulator::Emulator() : running(false), cycles(0) {
         [this](uint32_t addr, uint32_t val) { writePeripheral32(addr, val); }
     );
     
-    cpu->setPeripheralReadCallback([this](uint32_t addr) { return readPeripheral32(addr); });
-    cpu->setPeripheralWriteCallback([this](uint32_t addr, uint32_t val) { writePeripheral32(addr, val); });
-    
-    auto uart = std::make_unique<UART>();
-    addPeripheral(std::move(uart));
+    for (const auto& entry : soc.peripherals) {
+        if (entry.lazy) continue;
+        auto peripheral = createPeripheral(entry, quiet);
+        if (entry.type == "uart" && !uart) uart = static_cast<UART*>(peripheral.get());
+        if (entry.type == "gpio" && !gpio) {
+            gpio = static_cast<GPIO*>(peripheral.get());
+            gpio->setClock(&cycles);
+        }
+        if (entry.type == "wifi" && !wifi) wifi = static_cast<WiFi*>(peripheral.get());
+        addPeripheral(std::move(peripheral));
+    }
     
-    std::cout << "ESP32 Emulator initialized" << std::endl;
+    if (!quiet) std::cout << "ESP32 Emulator initialized (" << soc.name << ")" << std::endl;
 }
 
 void Emulator::loadFirmware(const std::vector<uint8_t>& firmware) {
@@ -29,59 +72,638 @@ void Emulator::loadFirmware(const std::vector<uint8_t>& firmware) {
         throw std::runtime_error("Firmware is empty");
     }
     
-    const uint32_t firmwareBase = 0x40080000;
+    if (ElfFile::isElf(firmware)) {
+        loadElf(ElfFile(firmware));
+        return;
+    }
+    
+    const uint32_t firmwareBase = soc.firmwareBase;
     memory->writeBytes(firmwareBase, firmware);
     
     cpu->setPC(firmwareBase);
     
-    std::cout << "Firmware loaded at 0x" << std::hex << firmwareBase << std::dec << std::endl;
+    if (!quiet) std::cout << "Firmware loaded at 0x" << std::hex << firmwareBase << std::dec << std::endl;
+}
+
+void Emulator::loadElf(const ElfFile& elf) {
+    for (const auto& segment : elf.getSegments()) {
+        if (segment.memorySize == 0) continue;
+        if (segment.fileSize > segment.memorySize || segment.offset + segment.fileSize > elf.size()) {
+            throw std::runtime_error("Malformed ELF program header");
+        }
+        
+        uint32_t address = static_cast<uint32_t>(segment.address);
+        memory->writeBytes(address, elf.data() + segment.offset, segment.fileSize);
+        
+        std::vector<uint8_t> zeros(segment.memorySize - segment.fileSize, 0);
+        memory->writeBytes(address + static_cast<uint32_t>(segment.fileSize), zeros);
+    }
+    
+    if (!symbols) {
+        setSymbols(SymbolIndex::fromElf(elf));
+    }
+    
+    uint32_t entry = static_cast<uint32_t>(elf.getEntry());
+    cpu->setPC(entry);
+    
+    if (!quiet) std::cout << "ELF firmware loaded, entry at 0x" << std::hex << entry << std::dec << std::endl;
+}
+
+void Emulator::setSymbols(std::shared_ptr<const SymbolIndex> index) {
+    symbols = std::move(index);
+    cpu->setSymbols(symbols.get());
+    if (timing) {
+        timing->setSymbols(symbols.get());
+    }
+}
+
+Coverage* Emulator::enableCoverage() {
+    if (!coverage) {
+        // Every RAM region, aliases included: firmware often runs from an
+        // instruction window onto the same bytes as the first (data) region
+        std::vector<Coverage::Range> ranges;
+        for (const auto& region : soc.regions) {
+            if (region.kind == SocDescription::Region::Kind::Ram) {
+                ranges.push_back({region.base, region.size});
+            }
+        }
+        coverage = std::make_unique<Coverage>(ranges);
+        cpu->setCoverage(coverage.get());
+    }
+    return coverage.get();
 }
 
 void Emulator::run() {
+    if (!quiet) std::cout << "Starting emulation..." << std::endl;
+    runLoop(UINT64_MAX);
+}
+
+uint64_t Emulator::runFor(uint64_t maxCycles) {
+    return runLoop(maxCycles);
+}
+
+uint64_t Emulator::runLoop(uint64_t maxCycles) {
+    beginRun();
+    uint64_t startCycles = cycles;
+    
+    if (!pacing && !idleSleep) {
+        runFree(maxCycles);
+    } else {
+        runPaced(maxCycles);
+    }
+    
+    finishRun();
+    return cycles - startCycles;
+}
+
+void Emulator::runFree(uint64_t maxCycles) {
+    uint64_t startCycles = cycles;
+    
+    // Run in slices that end at control-quantum and checkpoint boundaries
+    // so the per-step loop stays as tight as it was
+    while (running && cycles - startCycles < maxCycles) {
+        uint64_t slice = std::min({maxCycles - (cycles - startCycles), cyclesToCheckpoint(), CONTROL_QUANTUM});
+        uint64_t sliceStart = cycles;
+        while (running && cycles - sliceStart < slice) {
+            step();
+        }
+        checkpointIfDue();
+        pollCommands();
+    }
+}
+
+void Emulator::runPaced(uint64_t maxCycles) {
+    using Clock = std::chrono::steady_clock;
+    
+    uint64_t startCycles = cycles;
+    const uint64_t quantum = std::max<uint64_t>(clockHz / QUANTA_PER_SECOND, 1);
+    const auto quantumTime = std::chrono::nanoseconds(1000000000 / QUANTA_PER_SECOND);
+    // Falling further behind than this (host overloaded, debugger attached)
+    // re-anchors instead of bursting to catch up
+    const auto maxLag = quantumTime * 100;
+    
+    Clock::time_point anchorTime = Clock::now();
+    uint64_t anchorCycles = cycles;
+    
+    while (running && cycles - startCycles < maxCycles) {
+        uint64_t remaining = maxCycles - (cycles - startCycles);
+        uint64_t quantumEnd = cycles + std::min(quantum, remaining);
+        bool idled = false;
+        
+        while (running && cycles < quantumEnd) {
+            if (cpu->isWaiting() && idleSleep) {
+                // One step still runs the peripherals' update(), which is
+                // where HTTP replies and network frames from other threads
+                // become something the guest can be woken by
+                step();
+                if (running && cpu->isWaiting()) {
+                    // Nothing can wake the core before the next check, so let
+                    // the rest of the quantum pass without spinning
+                    cycles = std::max(cycles, quantumEnd);
+                    idled = true;
+                    break;
+                }
+                continue;
+            }
+            step();
+        }
+        
+        if (pacing) {
+            // Targets are absolute from the anchor, so sleep overshoot in one
+            // quantum is paid back in the next instead of accumulating
+            uint64_t elapsed = cycles - anchorCycles;
+            auto target = anchorTime + std::chrono::seconds(elapsed / clockHz)
+                        + std::chrono::nanoseconds((elapsed % clockHz) * 1000000000 / clockHz);
+            auto now = Clock::now();
+            if (target > now) {
+                std::this_thread::sleep_until(target);
+            } else if (now - target > maxLag) {
+                anchorTime = now;
+                anchorCycles = cycles;
+            }
+        } else if (idled) {
+            std::this_thread::sleep_for(quantumTime);
+        }
+        checkpointIfDue();
+        
+        if (commands.load(std::memory_order_relaxed)) {
+            serviceCommands();
+            // Time spent paused shouldn't be made up afterwards
+            anchorTime = Clock::now();
+            anchorCycles = cycles;
+        }
+    }
+}
+
+void Emulator::beginRun() {
     running = true;
-    std::cout << "Starting emulation..." << std::endl;
+    RunState idle = RunState::Idle;
+    while (!runState.compare_exchange_weak(idle, RunState::Running)) {
+        // A peek from another thread is looking at the machine; let it finish
+        runState.wait(RunState::Inspecting);
+        idle = RunState::Idle;
+    }
+    // Commands posted while idle (a stop, a pause) apply before the first step
+    pollCommands();
+}
+
+void Emulator::finishRun() {
+    runState = RunState::Idle;
+    // A peek that raced with the end of the run is answered here, since
+    // nobody else will pick it up
+    servicePeek();
     
-    while (running) {
-        step();
+    if (!running && !quiet) {
+        std::cout << "Emulation stopped after " << cycles << " cycles" << std::endl;
+    }
+}
+
+void Emulator::post(Command command) {
+    uint32_t bit = static_cast<uint32_t>(command);
+    // Pause and resume cancel each other, so the latest one wins
+    uint32_t cancels = (command == Command::Pause) ? static_cast<uint32_t>(Command::Resume)
+                     : (command == Command::Resume) ? static_cast<uint32_t>(Command::Pause) : 0;
+    
+    uint32_t current = commands.load();
+    while (!commands.compare_exchange_weak(current, (current & ~cancels) | bit)) {
+    }
+    commands.notify_all();
+}
+
+void Emulator::peek(const std::function<void(const Emulator&)>& inspect) {
+    PeekRequest request{&inspect, {false}};
+    
+    PeekRequest* expected = nullptr;
+    while (!peekRequest.compare_exchange_weak(expected, &request)) {
+        expected = nullptr;
+        std::this_thread::yield();
+    }
+    
+    for (;;) {
+        RunState state = RunState::Idle;
+        if (runState.compare_exchange_strong(state, RunState::Inspecting)) {
+            // Nothing is running and no run can start until we're done, so
+            // take the request back and answer it here. If it's already gone,
+            // a run that just ended is answering it.
+            PeekRequest* mine = &request;
+            bool ours = peekRequest.compare_exchange_strong(mine, nullptr);
+            if (ours) {
+                inspect(*this);
+            }
+            runState = RunState::Idle;
+            runState.notify_all();
+            if (ours) return;
+            break;
+        }
+        if (state == RunState::Running) {
+            post(Command::Peek);
+            break;
+        }
+        // Another thread's peek is still inspecting
+        runState.wait(RunState::Inspecting);
+    }
+    request.done.wait(false);
+}
+
+void Emulator::serviceCommands() {
+    uint32_t pending = commands.exchange(0, std::memory_order_acquire);
+    
+    for (;;) {
+        if (pending & static_cast<uint32_t>(Command::Stop)) {
+            running = false;
+            paused = false;
+        }
+        if (pending & static_cast<uint32_t>(Command::Peek)) {
+            servicePeek();
+        }
+        if (pending & static_cast<uint32_t>(Command::Pause)) {
+            paused = running.load();
+        }
+        if (pending & static_cast<uint32_t>(Command::Resume)) {
+            paused = false;
+        }
+        
+        if (!paused) {
+            return;
+        }
+        // Parked: sleep until the next command arrives
+        commands.wait(0, std::memory_order_acquire);
+        pending = commands.exchange(0, std::memory_order_acquire);
+    }
+}
+
+void Emulator::servicePeek() {
+    PeekRequest* request = peekRequest.exchange(nullptr);
+    if (!request) return;
+    
+    (*request->inspect)(*this);
+    request->done = true;
+    request->done.notify_all();
+}
+
+bool Emulator::wakePending() const {
+    for (const auto& peripheral : peripherals) {
+        if (peripheral->interruptPending()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Emulator::setClockFrequency(uint64_t hz) {
+    if (hz == 0) {
+        throw std::invalid_argument("Clock frequency must be non-zero");
+    }
+    clockHz = hz;
+}
+
+uint64_t Emulator::runUntil(uint32_t breakAddress, uint64_t maxCycles) {
+    beginRun();
+    
+    uint64_t startCycles = cycles;
+    while (running && cycles - startCycles < maxCycles && cpu->getPC() != breakAddress) {
+        uint64_t slice = std::min(maxCycles - (cycles - startCycles), CONTROL_QUANTUM);
+        uint64_t sliceStart = cycles;
+        while (running && cycles - sliceStart < slice && cpu->getPC() != breakAddress) {
+            step();
+        }
+        pollCommands();
     }
+    
+    finishRun();
+    return cycles - startCycles;
 }
 
 void Emulator::step() {
     if (!running) return;
     
     try {
-        cpu->execute();
-        cycles++;
+        if (taskProfiler && cpu->getPC() == taskProfiler->getSwitchAddress() && !cpu->isWaiting()) {
+            taskProfiler->sample(*memory, taskCounters());
+        }
+        uint64_t cost = (intercepts && !cpu->isWaiting()) ? intercepts->invoke(cpu->getPC(), *this) : 0;
+        if (cost == 0) {
+            cpu->execute();
+            if (cpu->hasFault()) {
+                fault(XtensaLX6::describe(cpu->getFault().kind));
+                return;
+            }
+            uint64_t stall = timing ? timing->takeStall() : 0;
+            stallCycles += stall;
+            cost = 1 + stall;
+        }
+        cycles += cost;
         
         for (auto& peripheral : peripherals) {
             peripheral->update();
         }
         
+        if (cpu->isWaiting() && wakePending()) {
+            cpu->wake();
+        }
+        
     } catch (const std::exception& e) {
-        std::cerr << "Emulation error at cycle " << cycles << ": " << e.what() << std::endl;
-        stop();
+        fault(e.what());
     }
 }
 
+// Stops the run. Guest faults come from the CPU's preallocated Fault, so
+// with reporting off nothing here allocates.
+void Emulator::fault(const char* reason) {
+    faulted = true;
+    stop();
+    if (!faultReporting) return;
+    
+    uint32_t pc = cpu->getPC();
+    std::cerr << "Emulation error at cycle " << cycles << ", PC ";
+    if (symbols) {
+        std::cerr << symbols->describe(pc);
+    } else {
+        std::cerr << "0x" << std::hex << pc << std::dec;
+    }
+    std::cerr << ": " << reason;
+    if (cpu->hasFault()) {
+        std::cerr << " (0x" << std::hex << cpu->getFault().detail << std::dec << ")";
+    }
+    std::cerr << std::endl;
+}
+
 void Emulator::stop() {
+    // The run loop reports the stop once it has actually returned
     running = false;
-    std::cout << "Emulation stopped after " << cycles << " cycles" << std::endl;
+}
+
+void Emulator::saveSnapshot(Snapshot& snapshot) {
+    snapshot.cpu = cpu->getState();
+    snapshot.cycles = cycles;
+    snapshot.ram = memory->getRAM();
+    
+    snapshot.peripherals.resize(peripherals.size());
+    for (size_t i = 0; i < peripherals.size(); i++) {
+        snapshot.peripherals[i].clear();
+        peripherals[i]->saveState(snapshot.peripherals[i]);
+    }
+    
+    memory->clearDirtyPages();
+    dirtySinceReset = false;
+}
+
+void Emulator::restoreSnapshot(const Snapshot& snapshot) {
+    if (snapshot.peripherals.size() != peripherals.size()) {
+        throw std::runtime_error("Snapshot does not match peripheral configuration");
+    }
+    
+    memory->restoreDirtyPages(snapshot.ram);
+    cpu->setState(snapshot.cpu);
+    cycles = snapshot.cycles;
+    
+    for (size_t i = 0; i < peripherals.size(); i++) {
+        const auto& state = snapshot.peripherals[i];
+        peripherals[i]->loadState(state.data(), state.size());
+    }
+    
+    faulted = false;
+}
+
+void Emulator::reset(const std::vector<uint8_t>& image, uint32_t entry) {
+    if (dirtySinceReset) {
+        memory->restoreDirtyPages(image);
+    } else {
+        memory->loadRAM(image);
+        memory->clearDirtyPages();
+        dirtySinceReset = true;
+    }
+    
+    cpu->reset();
+    cpu->setPC(entry);
+    for (auto& peripheral : peripherals) {
+        peripheral->reset();
+    }
+    if (timing) {
+        timing->flushCache();
+    }
+    
+    for (SharedMemoryPeripheral* shared : sharedMemory) {
+        removePeripheral(shared);
+    }
+    sharedMemory.clear();
+    checkpointer.reset();
+    checkpointInterval = 0;
+    nextCheckpoint = UINT64_MAX;
+    taskProfiler.reset();
+    clockHz = soc.clockHz;
+    pacing = false;
+    idleSleep = false;
+    
+    cycles = 0;
+    mmioAccesses = 0;
+    stallCycles = 0;
+    faulted = false;
+    running = false;
+    commands = 0;
+    paused = false;
+}
+
+Checkpointer* Emulator::enableCheckpoints(const std::string& path, uint64_t intervalCycles) {
+    if (intervalCycles == 0) {
+        throw std::invalid_argument("Checkpoint interval must be non-zero");
+    }
+    checkpointer = std::make_unique<Checkpointer>(path);
+    checkpointInterval = intervalCycles;
+    nextCheckpoint = cycles + intervalCycles;
+    return checkpointer.get();
+}
+
+uint64_t Emulator::cyclesToCheckpoint() const {
+    if (!checkpointer) return UINT64_MAX;
+    return nextCheckpoint > cycles ? nextCheckpoint - cycles : 1;
+}
+
+void Emulator::checkpointIfDue() {
+    if (!checkpointer || cycles < nextCheckpoint) return;
+    
+    // A slow disk never blocks the guest: while the last frame is still
+    // being written the dirty pages just keep accumulating
+    if (checkpointer->busy()) {
+        nextCheckpoint = cycles + std::max<uint64_t>(checkpointInterval / 16, 1);
+        return;
+    }
+    try {
+        checkpoint();
+    } catch (const std::exception& e) {
+        std::cerr << "Checkpointing disabled: " << e.what() << std::endl;
+        checkpointer.reset();
+    }
+}
+
+void Emulator::checkpoint() {
+    if (!checkpointer) {
+        throw std::logic_error("Checkpoints are not enabled");
+    }
+    
+    auto frame = std::make_unique<Checkpointer::Frame>();
+    frame->full = checkpointer->needsFull();
+    frame->cpu = cpu->getState();
+    frame->cycles = cycles;
+    
+    frame->peripherals.resize(peripherals.size());
+    for (size_t i = 0; i < peripherals.size(); i++) {
+        peripherals[i]->saveState(frame->peripherals[i]);
+    }
+    
+    memory->takeCheckpointPages(frame->pages, frame->full);
+    frame->pageData.resize(frame->pages.size() * Memory::PAGE_SIZE);
+    const uint8_t* ram = memory->getRAM().data();
+    for (size_t i = 0; i < frame->pages.size(); i++) {
+        std::memcpy(&frame->pageData[i * Memory::PAGE_SIZE],
+                    ram + static_cast<size_t>(frame->pages[i]) * Memory::PAGE_SIZE, Memory::PAGE_SIZE);
+    }
+    
+    checkpointer->submit(std::move(frame));
+    nextCheckpoint = cycles + checkpointInterval;
+}
+
+void Emulator::resume(const std::string& path) {
+    Checkpointer::Image image = Checkpointer::load(path, memory->getRAMSize());
+    if (image.peripherals.size() != peripherals.size()) {
+        throw std::runtime_error("Checkpoint does not match peripheral configuration");
+    }
+    
+    memory->loadRAM(image.ram);
+    cpu->setState(image.cpu);
+    cycles = image.cycles;
+    for (size_t i = 0; i < peripherals.size(); i++) {
+        const auto& state = image.peripherals[i];
+        peripherals[i]->loadState(state.data(), state.size());
+    }
+    faulted = false;
+    if (checkpointer) {
+        nextCheckpoint = cycles + checkpointInterval;
+    }
+    
+    if (!quiet) std::cout << "Resumed from " << path << " at cycle " << cycles << " (" << image.frames << " frames)" << std::endl;
+}
+
+Intercepts* Emulator::enableIntercepts() {
+    if (!symbols) {
+        throw std::runtime_error("Intercepts need firmware symbols");
+    }
+    if (!intercepts) {
+        intercepts = std::make_unique<Intercepts>();
+        size_t bound = intercepts->addDefaults(*symbols);
+        if (!quiet) std::cout << "Intercepting " << bound << " library routines" << std::endl;
+    }
+    return intercepts.get();
+}
+
+TaskProfiler* Emulator::enableTaskProfiling(uint32_t nameOffset) {
+    if (!symbols) {
+        throw std::runtime_error("Task profiling needs firmware symbols");
+    }
+    if (!taskProfiler) {
+        taskProfiler = std::make_unique<TaskProfiler>(TaskProfiler::fromSymbols(*symbols, nameOffset));
+        taskProfiler->begin(taskCounters());
+    }
+    return taskProfiler.get();
+}
+
+void Emulator::writeTaskProfile(std::ostream& out) {
+    if (!taskProfiler) {
+        throw std::runtime_error("Task profiling is not enabled");
+    }
+    taskProfiler->sample(*memory, taskCounters());
+    taskProfiler->writeReport(out, clockHz);
+}
+
+TimingModel* Emulator::enableTiming(const TimingModel::Costs& costs) {
+    if (!timing) {
+        timing = std::make_unique<TimingModel>(soc, costs);
+        timing->setSymbols(symbols.get());
+        cpu->setTimingModel(timing.get());
+    }
+    return timing.get();
+}
+
+WiFi* Emulator::enableWiFi() {
+    if (!wifi) {
+        const SocDescription::PeripheralEntry* entry = soc.findPeripheral("wifi");
+        if (!entry) {
+            throw std::runtime_error(soc.name + " has no WiFi peripheral");
+        }
+        auto wifiPeripheral = std::make_unique<WiFi>(entry->base, quiet);
+        wifi = wifiPeripheral.get();
+        addPeripheral(std::move(wifiPeripheral));
+    }
+    return wifi;
+}
+
+uint16_t Emulator::attachNetwork(VirtualNetwork& network) {
+    VirtualNetwork::Port* port = network.createPort();
+    port->setClock(&cycles);
+    enableWiFi()->attachNetwork(port);
+    return port->getId();
+}
+
+void Emulator::detachNetwork() {
+    if (wifi) {
+        wifi->detachNetwork();
+    }
+}
+
+SharedMemoryPeripheral* Emulator::attachSharedMemory(const std::string& name, uint32_t dataSize, uint32_t baseAddress) {
+    auto peripheral = std::make_unique<SharedMemoryPeripheral>(name, dataSize, baseAddress, quiet);
+    uint32_t last = baseAddress + peripheral->getSize() - 1;
+    if (!memory->isPeripheralAddress(baseAddress) || !memory->isPeripheralAddress(last) ||
+        getPeripheral(baseAddress) || getPeripheral(last)) {
+        throw std::invalid_argument("Shared memory window overlaps RAM or another peripheral");
+    }
+    
+    SharedMemoryPeripheral* shared = peripheral.get();
+    addPeripheral(std::move(peripheral));
+    sharedMemory.push_back(shared);
+    return shared;
 }
 
 void Emulator::addPeripheral(std::unique_ptr<Peripheral> peripheral) {
+    uint32_t base = peripheral->getBaseAddress();
+    uint32_t last = base + peripheral->getSize() - 1;
+    int32_t firstSlot = memory->mmioSlot(base);
+    int32_t lastSlot = memory->mmioSlot(last);
+    if (last < base || firstSlot < 0 || lastSlot < 0 ||
+        lastSlot - firstSlot != static_cast<int32_t>((last >> Memory::MMIO_SLOT_SHIFT) - (base >> Memory::MMIO_SLOT_SHIFT))) {
+        throw std::invalid_argument("Peripheral at " + hexAddress(base) + " is outside the MMIO regions");
+    }
+    for (int32_t slot = firstSlot; slot <= lastSlot; slot++) {
+        if (peripheralSlots[slot]) {
+            throw std::invalid_argument("Peripheral at " + hexAddress(base) + " shares a 4KB slot with another");
+        }
+    }
+    
+    for (int32_t slot = firstSlot; slot <= lastSlot; slot++) {
+        peripheralSlots[slot] = peripheral.get();
+    }
+    peripheral->attachMemory(memory.get());
     peripherals.push_back(std::move(peripheral));
 }
 
-Peripheral* Emulator::getPeripheral(uint32_t address) const {
-    for (const auto& peripheral : peripherals) {
-        if (peripheral->isInRange(address)) {
-            return peripheral.get();
-        }
+void Emulator::removePeripheral(Peripheral* peripheral) {
+    for (Peripheral*& slot : peripheralSlots) {
+        if (slot == peripheral) slot = nullptr;
     }
-    return nullptr;
+    peripherals.erase(std::remove_if(peripherals.begin(), peripherals.end(),
+                                     [&](const std::unique_ptr<Peripheral>& owned) { return owned.get() == peripheral; }),
+                      peripherals.end());
+}
+
+Peripheral* Emulator::getPeripheral(uint32_t address) const {
+    int32_t slot = memory->mmioSlot(address);
+    if (slot < 0) return nullptr;
+    Peripheral* peripheral = peripheralSlots[slot];
+    return (peripheral && peripheral->isInRange(address)) ? peripheral : nullptr;
 } 
 
 uint8_t Emulator::readPeripheral8(uint32_t address) const {
+    mmioAccesses++;
     Peripheral* peripheral = getPeripheral(address);
     if (peripheral) {
         uint32_t offset = address - peripheral->getBaseAddress();
@@ -91,6 +713,7 @@ uint8_t Emulator::readPeripheral8(uint32_t address) const {
 }
 
 uint16_t Emulator::readPeripheral16(uint32_t address) const {
+    mmioAccesses++;
     Peripheral* peripheral = getPeripheral(address);
     if (peripheral) {
         uint32_t offset = address - peripheral->getBaseAddress();
@@ -100,6 +723,7 @@ uint16_t Emulator::readPeripheral16(uint32_t address) const {
 }
 
 uint32_t Emulator::readPeripheral32(uint32_t address) const {
+    mmioAccesses++;
     Peripheral* peripheral = getPeripheral(address);
     if (peripheral) {
         uint32_t offset = address - peripheral->getBaseAddress();
@@ -109,6 +733,7 @@ uint32_t Emulator::readPeripheral32(uint32_t address) const {
 }
 
 void Emulator::writePeripheral8(uint32_t address, uint8_t value) {
+    mmioAccesses++;
     Peripheral* peripheral = getPeripheral(address);
     if (peripheral) {
         uint32_t offset = address - peripheral->getBaseAddress();
@@ -117,6 +742,7 @@ void Emulator::writePeripheral8(uint32_t address, uint8_t value) {
 }
 
 void Emulator::writePeripheral16(uint32_t address, uint16_t value) {
+    mmioAccesses++;
     Peripheral* peripheral = getPeripheral(address);
     if (peripheral) {
         uint32_t offset = address - peripheral->getBaseAddress();
@@ -125,6 +751,7 @@ void Emulator::writePeripheral16(uint32_t address, uint16_t value) {
 }
 
 void Emulator::writePeripheral32(uint32_t address, uint32_t value) {
+    mmioAccesses++;
     Peripheral* peripheral = getPeripheral(address);
     if (peripheral) {
         uint32_t offset = address - peripheral->getBaseAddress();
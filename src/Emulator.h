@@ -2,38 +2,226 @@
 
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <functional>
 #include <cstdint>
+#include <string>
 #include "XtensaLX6.h"
 #include "Memory.h"
+#include "SocDescription.h"
+#include "Coverage.h"
+#include "SymbolIndex.h"
+#include "Intercepts.h"
+#include "TaskProfiler.h"
+#include "TimingModel.h"
+#include "Checkpointer.h"
 #include "peripherals/Peripheral.h"
 
+class UART;
+class GPIO;
+class WiFi;
+class SharedMemoryPeripheral;
+class ElfFile;
+class VirtualNetwork;
+
 
 class Emulator {
+public:
+    // Full machine state. Restoring only copies RAM pages dirtied since the
+    // snapshot was taken, so repeated restores stay cheap.
+    struct Snapshot {
+        XtensaLX6::State cpu;
+        uint64_t cycles;
+        std::vector<uint8_t> ram;
+        std::vector<std::vector<uint8_t>> peripherals;
+    };
+
 private:
+    SocDescription soc;
+    bool quiet;
     std::unique_ptr<XtensaLX6> cpu;
     std::unique_ptr<Memory> memory;
     std::vector<std::unique_ptr<Peripheral>> peripherals;
+    // Peripheral behind each 4KB MMIO slot, so dispatch is one index
+    std::vector<Peripheral*> peripheralSlots;
+    UART* uart;
+    GPIO* gpio;
+    WiFi* wifi;
+    std::vector<SharedMemoryPeripheral*> sharedMemory;
+    std::unique_ptr<Coverage> coverage;
+    std::shared_ptr<const SymbolIndex> symbols;
+    std::unique_ptr<Intercepts> intercepts;
+    std::unique_ptr<TaskProfiler> taskProfiler;
+    std::unique_ptr<TimingModel> timing;
+    std::unique_ptr<Checkpointer> checkpointer;
+    uint64_t checkpointInterval;
+    uint64_t nextCheckpoint;
     
-    bool running;
+    std::atomic<bool> running;
+    bool faulted;
+    bool faultReporting;     // Print faults to stderr as they happen
     uint64_t cycles;
+    mutable uint64_t mmioAccesses;
+    uint64_t stallCycles;    // The part of cycles the timing model charged as stalls
+    // True while the dirty-page set covers every RAM write since the last
+    // reset(); a snapshot clears the set, after which reset copies all of RAM
+    bool dirtySinceReset;
+    
+    // Control mailbox. Other threads set command bits; the emulator thread
+    // only does a relaxed load per quantum and handles them off the hot path.
+    static constexpr uint64_t CONTROL_QUANTUM = 10000;
+    struct PeekRequest {
+        const std::function<void(const Emulator&)>* inspect;
+        std::atomic<bool> done;
+    };
+    std::atomic<uint32_t> commands;
+    std::atomic<bool> paused;
+    // Who may touch the machine right now. peek() only inspects from
+    // another thread after moving Idle to Inspecting, and beginRun() waits
+    // for Idle before stepping, so the two can't overlap.
+    enum class RunState : uint8_t { Idle, Running, Inspecting };
+    std::atomic<RunState> runState;
+    std::atomic<PeekRequest*> peekRequest;
+    
+    void pollCommands() {
+        if (commands.load(std::memory_order_relaxed)) serviceCommands();
+    }
+    void serviceCommands();
+    void servicePeek();
+    void beginRun();
+    void finishRun();
+    
+    // Real-time pacing: virtual cycles are checked against the host clock
+    // once per quantum and the thread sleeps whenever it is ahead
+    static constexpr uint64_t QUANTA_PER_SECOND = 1000;
+    uint64_t clockHz;
+    bool pacing;
+    bool idleSleep;
+    
+    uint64_t runLoop(uint64_t maxCycles);
+    void runFree(uint64_t maxCycles);
+    void runPaced(uint64_t maxCycles);
+    uint64_t cyclesToCheckpoint() const;
+    void checkpointIfDue();
+    bool wakePending() const;
+    void fault(const char* reason);
+    TaskProfiler::Counters taskCounters() const {
+        return {cpu->getRetiredInstructions(), cycles, stallCycles, mmioAccesses};
+    }
 
 public:
+    enum class Command : uint32_t {
+        Pause = 1,
+        Resume = 2,
+        Stop = 4,
+        Peek = 8,
+    };
+    
     Emulator();
+    // Builds the memory map, peripherals and clock from a SoC description.
+    // A quiet emulator prints nothing to stdout on its own (banners, load
+    // and run messages), for embedding in a library or a pool.
+    explicit Emulator(const SocDescription& description, bool quiet = false);
     ~Emulator() = default;
 
     void loadFirmware(const std::vector<uint8_t>& firmware);
+    void loadElf(const ElfFile& elf);
     void run();
+    uint64_t runFor(uint64_t maxCycles);
+    uint64_t runUntil(uint32_t breakAddress, uint64_t maxCycles);
     void step();
     void stop();
+    
+    // Safe from any thread while run()/runFor()/runUntil() is going. The
+    // command takes effect at the next quantum boundary; a stop or pause
+    // posted while idle applies to the next run.
+    void post(Command command);
+    // Runs inspect on the emulator thread at the next boundary (or right
+    // here if nothing is running) and waits for it. Works while paused.
+    void peek(const std::function<void(const Emulator&)>& inspect);
+    bool isPaused() const { return paused; }
+    
+    void saveSnapshot(Snapshot& snapshot);
+    void restoreSnapshot(const Snapshot& snapshot);
+    
+    // Power-on reset without rebuilding anything: CPU and peripherals reset,
+    // RAM put back to image (only the pages written since the last reset),
+    // cycles back to zero and the PC at entry. image is normally the RAM
+    // right after loading firmware, shared by every instance that runs it.
+    // Run settings go back to defaults too: checkpoints, task profiling and
+    // shared-memory windows are detached, and the clock, pacing and idle
+    // sleep are as the SoC description has them.
+    void reset(const std::vector<uint8_t>& image, uint32_t entry);
+    
+    // Streams a checkpoint to path every intervalCycles while running
+    Checkpointer* enableCheckpoints(const std::string& path, uint64_t intervalCycles);
+    Checkpointer* getCheckpointer() const { return checkpointer.get(); }
+    void checkpoint();
+    // Restores RAM, CPU and peripherals from the last complete checkpoint.
+    // The peripheral set (WiFi enabled or not) must match the saved run.
+    void resume(const std::string& path);
 
+    const SocDescription& getSoc() const { return soc; }
     XtensaLX6* getCPU() const { return cpu.get(); }
     Memory* getMemory() const { return memory.get(); }
+    // Null when the SoC description has no UART
+    UART* getUART() const { return uart; }
+    GPIO* getGPIO() const { return gpio; }
+    WiFi* getWiFi() const { return wifi; }
+    
+    // WiFi is not mapped by default; attaching to a network maps it and
+    // gives this instance a node on the switch. Returns the node id.
+    WiFi* enableWiFi();
+    uint16_t attachNetwork(VirtualNetwork& network);
+    // Drops the node's port; call before destroying the network if this
+    // instance outlives it
+    void detachNetwork();
+    
+    // Maps a POSIX shared-memory segment (created if missing) as a
+    // peripheral window that a host process can write into directly
+    SharedMemoryPeripheral* attachSharedMemory(const std::string& name, uint32_t dataSize, uint32_t baseAddress);
+    
+    // Symbols are read-only and may be shared by any number of emulators
+    void setSymbols(std::shared_ptr<const SymbolIndex> index);
+    const SymbolIndex* getSymbols() const { return symbols.get(); }
+    
+    Coverage* enableCoverage();
+    Coverage* getCoverage() const { return coverage.get(); }
+    
+    // Runs memcpy/memset/strlen/... natively at their symbol addresses.
+    // Needs symbols, so load an ELF (or call setSymbols) first.
+    Intercepts* enableIntercepts();
+    Intercepts* getIntercepts() const { return intercepts.get(); }
+    
+    // Charges instructions, cycles and MMIO accesses to FreeRTOS tasks at
+    // each context switch. Needs symbols (pxCurrentTCB, vTaskSwitchContext).
+    TaskProfiler* enableTaskProfiling(uint32_t nameOffset = TaskProfiler::DEFAULT_NAME_OFFSET);
+    TaskProfiler* getTaskProfiler() const { return taskProfiler.get(); }
+    // Charges the time since the last switch, then prints the table
+    void writeTaskProfile(std::ostream& out);
+    
+    // Predicts on-device cycles (flash cache, memory and MMIO latency,
+    // branch penalties) and advances the cycle count by them. Slower, so
+    // off unless asked for. Uses the SoC's timing ranges.
+    TimingModel* enableTiming(const TimingModel::Costs& costs = TimingModel::Costs::esp32());
+    TimingModel* getTimingModel() const { return timing.get(); }
     
     void addPeripheral(std::unique_ptr<Peripheral> peripheral);
+    void removePeripheral(Peripheral* peripheral);
     Peripheral* getPeripheral(uint32_t address) const;
 
+    void setClockFrequency(uint64_t hz);
+    uint64_t getClockFrequency() const { return clockHz; }
+    void setPacing(bool enabled) { pacing = enabled; }
+    void setIdleSleep(bool enabled) { idleSleep = enabled; }
+    
     uint64_t getCycles() const { return cycles; }
+    uint64_t getMmioAccesses() const { return mmioAccesses; }
     bool isRunning() const { return running; }
+    bool hasFaulted() const { return faulted; }
+    // Off for callers that treat a crash as an expected result (the fuzzer)
+    // and read the details from the CPU's Fault instead
+    void setFaultReporting(bool enabled) { faultReporting = enabled; }
 
     uint8_t readPeripheral8(uint32_t address) const;
     uint16_t readPeripheral16(uint32_t address) const;
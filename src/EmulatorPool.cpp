@@ -0,0 +1,91 @@
+#include "EmulatorPool.h"
+#include "ElfFile.h"
+#include "peripherals/GPIO.h"
+#include "peripherals/UART.h"
+
+EmulatorPool::Lease& EmulatorPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool = other.pool;
+        emulator = std::move(other.emulator);
+    }
+    return *this;
+}
+
+void EmulatorPool::Lease::release() {
+    if (emulator) {
+        pool->giveBack(std::move(emulator));
+    }
+}
+
+EmulatorPool::EmulatorPool(const SocDescription& description, const std::vector<uint8_t>& firmware, size_t prewarm)
+    : soc(description), entry(0), created(0) {
+    // Parsed once and shared, rather than once per instance in loadElf
+    if (ElfFile::isElf(firmware)) {
+        symbols = SymbolIndex::fromElf(ElfFile(firmware));
+    }
+
+    // Instances are quiet, or every one would print its own banners
+    auto first = std::make_unique<Emulator>(soc, true);
+    if (symbols) {
+        first->setSymbols(symbols);
+    }
+    first->loadFirmware(firmware);
+    bootImage = first->getMemory()->getRAM();
+    entry = first->getCPU()->getPC();
+    first->reset(bootImage, entry);
+    idle.push_back(std::move(first));
+    created = 1;
+
+    while (created < prewarm) {
+        idle.push_back(createInstance());
+        created++;
+    }
+}
+
+std::unique_ptr<Emulator> EmulatorPool::createInstance() {
+    auto emulator = std::make_unique<Emulator>(soc, true);
+    if (symbols) {
+        emulator->setSymbols(symbols);
+    }
+    emulator->reset(bootImage, entry);
+    return emulator;
+}
+
+EmulatorPool::Lease EmulatorPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            std::unique_ptr<Emulator> emulator = std::move(idle.back());
+            idle.pop_back();
+            return Lease(this, std::move(emulator));
+        }
+        created++;
+    }
+    // Building is the slow part, so it happens outside the lock
+    return Lease(this, createInstance());
+}
+
+void EmulatorPool::giveBack(std::unique_ptr<Emulator> emulator) {
+    if (GPIO* gpio = emulator->getGPIO()) {
+        gpio->release(~0u);
+        gpio->stopCapture();
+    }
+    if (UART* uart = emulator->getUART()) {
+        uart->setOutputCallback(nullptr);
+    }
+    emulator->reset(bootImage, entry);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.push_back(std::move(emulator));
+}
+
+size_t EmulatorPool::available() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return idle.size();
+}
+
+size_t EmulatorPool::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return created;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Emulator.h"
+#include "SocDescription.h"
+#include "SymbolIndex.h"
+
+
+// Emulators that have already booted one firmware image, handed out to
+// tests and returned when they finish. Building an Emulator allocates and
+// zeroes the whole RAM, parses the ELF and sets up every peripheral;
+// acquire() skips all of that and release() only puts back the RAM pages
+// the test wrote, so a test pays microseconds instead of milliseconds.
+//
+// Returning an instance resets it (see Emulator::reset), which also drops
+// checkpoints, task profiling, shared-memory windows and pacing settings,
+// plus host-side GPIO drives, VCD captures and the UART output callback.
+// Coverage, timing and intercepts stay on for the next lease, and their
+// accumulated data is not cleared.
+// The pool must outlive every lease it hands out.
+class EmulatorPool {
+public:
+    // Returns its emulator to the pool when it goes out of scope
+    class Lease {
+        EmulatorPool* pool;
+        std::unique_ptr<Emulator> emulator;
+
+        friend class EmulatorPool;
+        Lease(EmulatorPool* owner, std::unique_ptr<Emulator> instance)
+            : pool(owner), emulator(std::move(instance)) {}
+
+    public:
+        Lease() : pool(nullptr) {}
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { release(); }
+
+        Emulator* get() const { return emulator.get(); }
+        Emulator* operator->() const { return emulator.get(); }
+        Emulator& operator*() const { return *emulator; }
+        explicit operator bool() const { return emulator != nullptr; }
+
+        // Resets the emulator and gives it back early
+        void release();
+    };
+
+private:
+    SocDescription soc;
+    std::shared_ptr<const SymbolIndex> symbols;
+    // RAM and PC right after loading the firmware; every reset returns here
+    std::vector<uint8_t> bootImage;
+    uint32_t entry;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Emulator>> idle;
+    size_t created;
+
+    std::unique_ptr<Emulator> createInstance();
+    void giveBack(std::unique_ptr<Emulator> emulator);
+
+public:
+    // Loads firmware once and builds prewarm instances up front. Throws if
+    // the firmware doesn't load.
+    EmulatorPool(const SocDescription& soc, const std::vector<uint8_t>& firmware, size_t prewarm);
+
+    // An idle instance, or a new one when all of them are leased out.
+    // Safe from any thread.
+    Lease acquire();
+
+    size_t available();
+    size_t size();
+};
@@ -0,0 +1,103 @@
+#include "Fuzzer.h"
+#include "peripherals/UART.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <sys/shm.h>
+
+Fuzzer::Fuzzer(Emulator& emu, const Config& cfg)
+    : emulator(emu), config(cfg), booted(false),
+      localMap(MAP_SIZE, 0), coverageMap(localMap.data()), coverageSize(MAP_SIZE),
+      aflSharedMemory(nullptr), executions(0) {
+    if (config.inputMode == InputMode::Memory && config.inputCapacity == 0) {
+        throw std::invalid_argument("Memory input mode needs a non-zero input capacity");
+    }
+    if (config.inputMode == InputMode::UART && !emulator.getUART()) {
+        throw std::invalid_argument("UART input mode needs a UART in the SoC description");
+    }
+
+    emulator.getCPU()->setEdgeCoverageMap(coverageMap, coverageSize);
+    // Crashes are results here, not news
+    emulator.setFaultReporting(false);
+}
+
+Fuzzer::~Fuzzer() {
+    emulator.getCPU()->setEdgeCoverageMap(nullptr, 0);
+    emulator.setFaultReporting(true);
+
+    if (aflSharedMemory) {
+        shmdt(aflSharedMemory);
+    }
+}
+
+bool Fuzzer::boot(uint64_t maxBootCycles) {
+    emulator.runUntil(config.entryAddress, maxBootCycles);
+
+    if (emulator.getCPU()->getPC() != config.entryAddress || emulator.hasFaulted()) {
+        return false;
+    }
+
+    emulator.saveSnapshot(snapshot);
+    booted = true;
+    return true;
+}
+
+Fuzzer::Result Fuzzer::runOne(const uint8_t* data, size_t size) {
+    if (!booted) {
+        throw std::logic_error("Fuzzer::runOne called before a successful boot");
+    }
+
+    emulator.restoreSnapshot(snapshot);
+
+    XtensaLX6* cpu = emulator.getCPU();
+    std::memset(coverageMap, 0, coverageSize);
+    cpu->resetEdgeState();
+
+    if (config.inputMode == InputMode::UART) {
+        emulator.getUART()->injectRx(data, size);
+    } else {
+        size_t length = std::min<size_t>(size, config.inputCapacity);
+        emulator.getMemory()->writeBytes(config.inputAddress, data, length);
+        cpu->setRegister(2, config.inputAddress);
+        cpu->setRegister(3, static_cast<uint32_t>(length));
+    }
+
+    emulator.runUntil(config.exitAddress, config.maxCycles);
+    executions++;
+
+    if (emulator.hasFaulted()) {
+        return Result::Crashed;
+    }
+    if (!emulator.isRunning() || cpu->getPC() == config.exitAddress) {
+        return Result::Completed;
+    }
+    return Result::Timeout;
+}
+
+void Fuzzer::setCoverageMap(uint8_t* map, size_t size) {
+    if (!map) {
+        map = localMap.data();
+        size = localMap.size();
+    }
+
+    emulator.getCPU()->setEdgeCoverageMap(map, size);
+    coverageMap = map;
+    coverageSize = size;
+}
+
+bool Fuzzer::attachAflSharedMemory() {
+    const char* shmId = std::getenv("__AFL_SHM_ID");
+    if (!shmId || aflSharedMemory) {
+        return false;
+    }
+
+    void* map = shmat(std::atoi(shmId), nullptr, 0);
+    if (map == reinterpret_cast<void*>(-1)) {
+        return false;
+    }
+
+    aflSharedMemory = map;
+    setCoverageMap(static_cast<uint8_t*>(map), MAP_SIZE);
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Emulator.h"
+
+
+// Persistent-mode fuzzing: boot the firmware once up to an entry point,
+// snapshot, then restore/inject/run for every input. Branch edges are
+// recorded into an AFL/libFuzzer-style 8-bit counter map.
+class Fuzzer {
+public:
+    enum class InputMode {
+        UART,    // Input bytes are queued on the UART RX FIFO
+        Memory   // Input bytes are copied to inputAddress; a2/a3 = (buffer, length)
+    };
+
+    enum class Result {
+        Completed,  // Reached exitAddress or the firmware stopped on its own
+        Timeout,    // Hit maxCycles
+        Crashed     // The emulator faulted
+    };
+
+    struct Config {
+        uint32_t entryAddress = 0;
+        uint32_t exitAddress = 0;
+        uint64_t maxCycles = 1000000;
+        InputMode inputMode = InputMode::UART;
+        uint32_t inputAddress = 0;
+        uint32_t inputCapacity = 0;
+    };
+
+    static constexpr size_t MAP_SIZE = 1 << 16;  // AFL's default MAP_SIZE
+
+private:
+    Emulator& emulator;
+    Config config;
+    Emulator::Snapshot snapshot;
+    bool booted;
+
+    std::vector<uint8_t> localMap;
+    uint8_t* coverageMap;
+    size_t coverageSize;
+    void* aflSharedMemory;
+
+    uint64_t executions;
+
+public:
+    Fuzzer(Emulator& emu, const Config& cfg);
+    ~Fuzzer();
+
+    Fuzzer(const Fuzzer&) = delete;
+    Fuzzer& operator=(const Fuzzer&) = delete;
+
+    bool boot(uint64_t maxBootCycles);
+    Result runOne(const uint8_t* data, size_t size);
+
+    void setCoverageMap(uint8_t* map, size_t size);
+    bool attachAflSharedMemory();
+
+    const uint8_t* getCoverageMap() const { return coverageMap; }
+    size_t getCoverageSize() const { return coverageSize; }
+    uint64_t getExecutions() const { return executions; }
+    bool isBooted() const { return booted; }
+};
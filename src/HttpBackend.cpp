@@ -0,0 +1,251 @@
+#include "HttpBackend.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int MAX_EVENTS = 64;
+constexpr int POLL_INTERVAL_MS = 100;  // Bounds how late a timeout can fire
+
+}
+
+HttpBackend::HttpBackend() : stopping(false), timeout(std::chrono::milliseconds(5000)) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        throw std::runtime_error(std::string("epoll_create1 failed: ") + std::strerror(errno));
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        close(epollFd);
+        throw std::runtime_error(std::string("eventfd failed: ") + std::strerror(errno));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    ioThread = std::thread([this]() { ioLoop(); });
+}
+
+HttpBackend::~HttpBackend() {
+    stopping = true;
+    uint64_t one = 1;
+    (void)write(wakeFd, &one, sizeof(one));
+    ioThread.join();
+
+    close(wakeFd);
+    close(epollFd);
+}
+
+void HttpBackend::addEndpoint(const std::string& host, const std::string& address, uint16_t port) {
+    in_addr parsed{};
+    const std::string numeric = (address == "localhost") ? "127.0.0.1" : address;
+    if (inet_pton(AF_INET, numeric.c_str(), &parsed) != 1) {
+        throw std::invalid_argument("Endpoint address must be numeric IPv4: " + address);
+    }
+
+    std::lock_guard<std::mutex> lock(endpointMutex);
+    endpoints[host] = {parsed.s_addr, htons(port)};
+}
+
+void HttpBackend::get(const std::string& url, Completion completion) {
+    std::string rest = url;
+    const std::string scheme = "http://";
+    if (rest.compare(0, scheme.size(), scheme) == 0) {
+        rest = rest.substr(scheme.size());
+    } else if (rest.find("://") != std::string::npos) {
+        completion({false, "Unsupported URL scheme: " + url});
+        return;
+    }
+
+    size_t slash = rest.find('/');
+    std::string host = rest.substr(0, slash);
+    std::string path = (slash == std::string::npos) ? "/" : rest.substr(slash);
+
+    Endpoint endpoint;
+    {
+        std::lock_guard<std::mutex> lock(endpointMutex);
+        auto it = endpoints.find(host);
+        if (it == endpoints.end()) {
+            it = endpoints.find(host.substr(0, host.find(':')));
+        }
+        if (it == endpoints.end()) {
+            completion({false, "No endpoint configured for " + host});
+            return;
+        }
+        endpoint = it->second;
+    }
+
+    std::string payload = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queued.push_back({endpoint, std::move(payload), std::move(completion),
+                          std::chrono::steady_clock::now() + timeout.load(std::memory_order_relaxed)});
+    }
+
+    uint64_t one = 1;
+    (void)write(wakeFd, &one, sizeof(one));
+}
+
+void HttpBackend::ioLoop() {
+    epoll_event events[MAX_EVENTS];
+
+    while (!stopping) {
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, POLL_INTERVAL_MS);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t value;
+                (void)read(wakeFd, &value, sizeof(value));
+                startQueued();
+            } else {
+                handleEvent(events[i].data.fd, events[i].events);
+            }
+        }
+        expire();
+    }
+
+    // Nobody should wait forever on a backend that is going away
+    startQueued();
+    while (!connections.empty()) {
+        finish(connections.begin()->first, false, "HTTP backend shut down");
+    }
+}
+
+void HttpBackend::startQueued() {
+    std::deque<Request> batch;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        batch.swap(queued);
+    }
+
+    for (auto& request : batch) {
+        if (stopping) {
+            request.completion({false, "HTTP backend shut down"});
+            continue;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            request.completion({false, std::string("socket failed: ") + std::strerror(errno)});
+            continue;
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = request.endpoint.address;
+        address.sin_port = request.endpoint.port;
+
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS) {
+            std::string error = std::string("connect failed: ") + std::strerror(errno);
+            close(fd);
+            request.completion({false, error});
+            continue;
+        }
+
+        connections[fd] = {std::move(request.payload), 0, {}, std::move(request.completion),
+                           request.deadline, false};
+
+        epoll_event event{};
+        event.events = EPOLLOUT;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void HttpBackend::handleEvent(int fd, uint32_t events) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+    Connection& connection = it->second;
+
+    if (!connection.connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error) {
+            finish(fd, false, std::string("connect failed: ") + std::strerror(error));
+            return;
+        }
+        connection.connected = true;
+    }
+
+    if (connection.sent < connection.payload.size() && (events & EPOLLOUT)) {
+        ssize_t written = send(fd, connection.payload.data() + connection.sent,
+                               connection.payload.size() - connection.sent, MSG_NOSIGNAL);
+        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            finish(fd, false, std::string("send failed: ") + std::strerror(errno));
+            return;
+        }
+        if (written > 0) {
+            connection.sent += static_cast<size_t>(written);
+        }
+        if (connection.sent == connection.payload.size()) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+        }
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char buffer[4096];
+        for (;;) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                connection.response.append(buffer, static_cast<size_t>(received));
+                if (connection.response.size() > MAX_RESPONSE) {
+                    finish(fd, false, "HTTP response too large");
+                    return;
+                }
+            } else if (received == 0) {
+                // Connection: close, so EOF ends the response
+                finish(fd, true);
+                return;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            } else {
+                finish(fd, false, std::string("recv failed: ") + std::strerror(errno));
+                return;
+            }
+        }
+    }
+}
+
+void HttpBackend::finish(int fd, bool ok, const std::string& error) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+
+    Completion completion = std::move(it->second.completion);
+    std::string response = ok ? std::move(it->second.response) : error;
+    connections.erase(it);
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+
+    completion({ok, std::move(response)});
+}
+
+void HttpBackend::expire() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = connections.begin(); it != connections.end();) {
+        int fd = it->first;
+        bool late = it->second.deadline <= now;
+        ++it;
+        if (late) {
+            finish(fd, false, "HTTP request timed out");
+        }
+    }
+}
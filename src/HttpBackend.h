@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+
+// Host side of the WiFi HTTP client. Requests are handed to a single I/O
+// thread that drives non-blocking sockets through epoll, so the emulator
+// thread only queues work and later picks up finished responses. Guest
+// hostnames are mapped onto local endpoints (mock servers); anything
+// unmapped fails instead of reaching the real network.
+class HttpBackend {
+public:
+    struct Response {
+        bool ok;
+        std::string data;  // Raw HTTP response, or an error message
+    };
+    using Completion = std::function<void(Response)>;
+
+private:
+    struct Endpoint {
+        uint32_t address;  // IPv4, network byte order
+        uint16_t port;
+    };
+
+    struct Request {
+        Endpoint endpoint;
+        std::string payload;
+        Completion completion;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    struct Connection {
+        std::string payload;
+        size_t sent;
+        std::string response;
+        Completion completion;
+        std::chrono::steady_clock::time_point deadline;
+        bool connected;
+    };
+
+    std::map<std::string, Endpoint> endpoints;
+    mutable std::mutex endpointMutex;
+
+    std::mutex queueMutex;
+    std::deque<Request> queued;
+
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> stopping;
+    std::thread ioThread;
+    std::unordered_map<int, Connection> connections;
+    // Set from any thread, read by every emulator thread issuing requests
+    std::atomic<std::chrono::milliseconds> timeout;
+
+    void ioLoop();
+    void startQueued();
+    void handleEvent(int fd, uint32_t events);
+    void finish(int fd, bool ok, const std::string& error = {});
+    void expire();
+
+public:
+    static constexpr size_t MAX_RESPONSE = 1 << 20;
+
+    HttpBackend();
+    ~HttpBackend();
+
+    HttpBackend(const HttpBackend&) = delete;
+    HttpBackend& operator=(const HttpBackend&) = delete;
+
+    // host is the name the firmware uses ("api.example.com" or
+    // "api.example.com:8080"); address must be a numeric IPv4 or localhost
+    void addEndpoint(const std::string& host, const std::string& address, uint16_t port);
+    void setTimeout(std::chrono::milliseconds value) { timeout.store(value, std::memory_order_relaxed); }
+
+    // Issues GET <url>. The completion normally runs on the I/O thread; a URL
+    // with no endpoint fails straight away on the caller's thread.
+    void get(const std::string& url, Completion completion);
+};
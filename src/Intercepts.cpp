@@ -0,0 +1,257 @@
+#include "Intercepts.h"
+#include "Emulator.h"
+#include "SymbolIndex.h"
+#include "peripherals/UART.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Rough costs of the ROM/newlib versions on an LX6: a fixed call and setup
+// overhead plus word-at-a-time copies or byte-at-a-time scans
+constexpr uint64_t CALL_COST = 10;
+constexpr uint64_t PRINTF_COST = 200;
+constexpr uint64_t PRINTF_COST_PER_CHAR = 10;
+constexpr size_t MAX_STRING = 4096;
+
+// call0 argument n: a2..a7, then 4-byte slots on the stack
+uint32_t argument(Emulator& emulator, unsigned index) {
+    XtensaLX6* cpu = emulator.getCPU();
+    if (index < 6) {
+        return cpu->getRegister(static_cast<uint8_t>(2 + index));
+    }
+    return emulator.getMemory()->read32(cpu->getRegister(1) + 4 * (index - 6));
+}
+
+size_t guestStrlen(const Memory& memory, uint32_t address, size_t limit) {
+    if (const uint8_t* span = memory.ramSpan(address, 1)) {
+        size_t available = memory.ramAvailable(address);
+        const void* nul = std::memchr(span, 0, std::min(available, limit));
+        if (nul) {
+            return static_cast<const uint8_t*>(nul) - span;
+        }
+        if (available >= limit) {
+            return limit;
+        }
+    }
+    // Strings outside RAM or running off its end go through the bus
+    size_t length = 0;
+    while (length < limit && memory.read8(address + static_cast<uint32_t>(length))) {
+        length++;
+    }
+    return length;
+}
+
+std::string guestString(const Memory& memory, uint32_t address) {
+    std::string text(guestStrlen(memory, address, MAX_STRING), '\0');
+    memory.readBytes(address, reinterpret_cast<uint8_t*>(text.data()), text.size());
+    return text;
+}
+
+uint64_t hleMemcpy(Emulator& emulator) {
+    uint32_t length = argument(emulator, 2);
+    emulator.getMemory()->copy(argument(emulator, 0), argument(emulator, 1), length);
+    // a2 already holds the destination, which is the return value
+    return CALL_COST + length / 4;
+}
+
+uint64_t hleMemset(Emulator& emulator) {
+    uint32_t length = argument(emulator, 2);
+    emulator.getMemory()->fill(argument(emulator, 0), static_cast<uint8_t>(argument(emulator, 1)), length);
+    return CALL_COST + length / 4;
+}
+
+uint64_t hleMemcmp(Emulator& emulator) {
+    const Memory& memory = *emulator.getMemory();
+    uint32_t left = argument(emulator, 0);
+    uint32_t right = argument(emulator, 1);
+    uint32_t length = argument(emulator, 2);
+
+    int result = 0;
+    size_t compared = length;
+    const uint8_t* a = memory.ramSpan(left, length);
+    const uint8_t* b = memory.ramSpan(right, length);
+    if (a && b) {
+        result = std::memcmp(a, b, length);
+        if (result != 0) {
+            // Only the cost needs to know where the bytes first differ
+            compared = std::mismatch(a, a + length, b).first - a + 1;
+        }
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            uint8_t x = memory.read8(left + static_cast<uint32_t>(i));
+            uint8_t y = memory.read8(right + static_cast<uint32_t>(i));
+            if (x != y) {
+                result = x - y;
+                compared = i + 1;
+                break;
+            }
+        }
+    }
+
+    emulator.getCPU()->setRegister(2, static_cast<uint32_t>(result));
+    return CALL_COST + compared;
+}
+
+uint64_t hleStrlen(Emulator& emulator) {
+    const Memory& memory = *emulator.getMemory();
+    uint32_t address = argument(emulator, 0);
+    size_t length = guestStrlen(memory, address, memory.getRAMSize());
+    emulator.getCPU()->setRegister(2, static_cast<uint32_t>(length));
+    return CALL_COST + length;
+}
+
+// ets_printf: the usual integer, char, string and pointer conversions,
+// formatted by the host printf one conversion at a time
+uint64_t hleEtsPrintf(Emulator& emulator) {
+    const Memory& memory = *emulator.getMemory();
+    std::string format = guestString(memory, argument(emulator, 0));
+    std::string output;
+    unsigned next = 1;
+
+    for (size_t i = 0; i < format.size(); i++) {
+        if (format[i] != '%') {
+            output += format[i];
+            continue;
+        }
+
+        std::string spec = "%";
+        size_t j = i + 1;
+        while (j < format.size() && std::strchr("-+ #0", format[j])) spec += format[j++];
+        while (j < format.size() && (std::isdigit(static_cast<unsigned char>(format[j])) || format[j] == '.')) {
+            spec += format[j++];
+        }
+        bool wide = false;
+        while (j < format.size() && (format[j] == 'l' || format[j] == 'h' || format[j] == 'z')) {
+            wide = wide || (j + 1 < format.size() && format[j] == 'l' && format[j + 1] == 'l');
+            j++;
+        }
+        if (j >= format.size()) {
+            break;
+        }
+
+        char conversion = format[j];
+        char buffer[64];
+        switch (conversion) {
+            case 'd': case 'i': {
+                int64_t value = static_cast<int32_t>(argument(emulator, next++));
+                if (wide) {
+                    uint32_t high = argument(emulator, next++);
+                    value = static_cast<int64_t>((static_cast<uint64_t>(high) << 32) | static_cast<uint32_t>(value));
+                }
+                std::snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), static_cast<long long>(value));
+                output += buffer;
+                break;
+            }
+            case 'u': case 'x': case 'X': case 'o': {
+                uint64_t value = argument(emulator, next++);
+                if (wide) {
+                    value |= static_cast<uint64_t>(argument(emulator, next++)) << 32;
+                }
+                std::snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(),
+                              static_cast<unsigned long long>(value));
+                output += buffer;
+                break;
+            }
+            case 'p':
+                std::snprintf(buffer, sizeof(buffer), "0x%08x", argument(emulator, next++));
+                output += buffer;
+                break;
+            case 'c':
+                output += static_cast<char>(argument(emulator, next++));
+                break;
+            case 's': {
+                // Padding is added here rather than by snprintf, so a width
+                // past any scratch buffer still comes out whole
+                std::string text = guestString(memory, argument(emulator, next++));
+                size_t dot = spec.find('.');
+                if (dot != std::string::npos) {
+                    text.resize(std::min<size_t>(text.size(), std::strtoul(spec.c_str() + dot + 1, nullptr, 10)));
+                }
+                size_t digits = spec.find_first_of("123456789");
+                size_t width = digits < dot ? std::strtoul(spec.c_str() + digits, nullptr, 10) : 0;
+                size_t padding = width > text.size() ? width - text.size() : 0;
+                if (spec.find('-') == std::string::npos) {
+                    output.append(padding, ' ');
+                    output += text;
+                } else {
+                    output += text;
+                    output.append(padding, ' ');
+                }
+                break;
+            }
+            case '%':
+                output += '%';
+                break;
+            default:
+                // Unknown conversions are printed as written
+                output += format.substr(i, j - i + 1);
+                break;
+        }
+        i = j;
+    }
+
+    if (UART* uart = emulator.getUART()) {
+        for (char c : output) {
+            uart->sendByte(static_cast<uint8_t>(c));
+        }
+    }
+    emulator.getCPU()->setRegister(2, static_cast<uint32_t>(output.size()));
+    return PRINTF_COST + PRINTF_COST_PER_CHAR * output.size();
+}
+
+}
+
+Intercepts::Intercepts() : filter(FILTER_BITS / 64, 0), calls(0) {
+}
+
+void Intercepts::add(uint32_t address, Handler handler) {
+    if (!handler) {
+        throw std::invalid_argument("Intercept needs a handler");
+    }
+    handlers[address] = std::move(handler);
+
+    uint32_t slot = (address >> 1) & (FILTER_BITS - 1);
+    filter[slot >> 6] |= 1ULL << (slot & 63);
+}
+
+bool Intercepts::addByName(const SymbolIndex& symbols, std::string_view name, Handler handler) {
+    SymbolIndex::Symbol symbol;
+    if (!symbols.findByName(name, symbol)) {
+        return false;
+    }
+    add(symbol.address, std::move(handler));
+    return true;
+}
+
+size_t Intercepts::addDefaults(const SymbolIndex& symbols) {
+    size_t bound = 0;
+    bound += addByName(symbols, "memcpy", hleMemcpy);
+    bound += addByName(symbols, "memmove", hleMemcpy);
+    bound += addByName(symbols, "memset", hleMemset);
+    bound += addByName(symbols, "memcmp", hleMemcmp);
+    bound += addByName(symbols, "strlen", hleStrlen);
+    bound += addByName(symbols, "ets_printf", hleEtsPrintf);
+    return bound;
+}
+
+uint64_t Intercepts::invoke(uint32_t pc, Emulator& emulator) {
+    if (!mayHandle(pc)) {
+        return 0;
+    }
+    auto it = handlers.find(pc);
+    if (it == handlers.end()) {
+        return 0;
+    }
+
+    uint64_t cost = it->second(emulator);
+    XtensaLX6* cpu = emulator.getCPU();
+    cpu->setPC(cpu->getRegister(0));
+    calls++;
+    return cost ? cost : 1;
+}
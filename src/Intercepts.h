@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class Emulator;
+class SymbolIndex;
+
+
+// High-level emulation of hot library routines. When the PC reaches a
+// registered entry point the routine runs natively on host memory and
+// returns straight to the caller, following the call0 ABI: arguments in
+// a2..a7 (then the stack at a1), result in a2, return address in a0.
+class Intercepts {
+public:
+    // Does the work and returns the guest cycles it stands in for
+    using Handler = std::function<uint64_t(Emulator&)>;
+
+private:
+    // Cheap pre-check on every step: one bit per halfword-aligned PC slot
+    static constexpr uint32_t FILTER_BITS = 1u << 16;
+    std::vector<uint64_t> filter;
+    std::unordered_map<uint32_t, Handler> handlers;
+    uint64_t calls;
+
+public:
+    Intercepts();
+
+    void add(uint32_t address, Handler handler);
+    bool addByName(const SymbolIndex& symbols, std::string_view name, Handler handler);
+
+    // Binds memcpy, memmove, memset, memcmp, strlen and ets_printf where the
+    // symbols define them; returns how many were found
+    size_t addDefaults(const SymbolIndex& symbols);
+
+    bool mayHandle(uint32_t pc) const {
+        uint32_t slot = (pc >> 1) & (FILTER_BITS - 1);
+        return filter[slot >> 6] & (1ULL << (slot & 63));
+    }
+
+    // Runs the routine at pc if there is one and returns its cycle cost,
+    // or 0 when the CPU should execute normally
+    uint64_t invoke(uint32_t pc, Emulator& emulator);
+
+    size_t size() const { return handlers.size(); }
+    uint64_t getCalls() const { return calls; }
+};
@@ -3,10 +3,50 @@
 #include <iomanip>
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
 
-Memory::Memory() : ram(RAM_SIZE, 0) {
-    std::cout << "Memory initialized: " << (RAM_SIZE / 1024 / 1024) << "MB RAM" << std::endl;
-    std::cout << "RAM range: 0x" << std::hex << RAM_BASE << " - 0x" << RAM_END << std::dec << std::endl;
+Memory::Memory() : Memory(SocDescription::esp32()) {
+}
+
+Memory::Memory(const SocDescription& soc, bool quiet)
+    : granules(1u << (32 - SocDescription::GRANULE_SHIFT), 0), mmioSlots(0), primaryBase(0), primarySize(0) {
+    soc.validate();
+    if (soc.regions.size() > 255) {
+        throw std::invalid_argument("Too many memory regions");
+    }
+    
+    for (const auto& description : soc.regions) {
+        bool isRam = description.kind == SocDescription::Region::Kind::Ram;
+        Region region{description.base, description.size, isRam, description.storageOffset};
+        if (!isRam) {
+            region.offset = mmioSlots;
+            mmioSlots += description.size >> MMIO_SLOT_SHIFT;
+        } else if (primarySize == 0) {
+            primaryBase = description.base;
+            primarySize = description.size;
+        }
+        regions.push_back(region);
+    
+        uint8_t index = static_cast<uint8_t>(regions.size());
+        for (uint64_t granule = description.base >> SocDescription::GRANULE_SHIFT;
+             granule < description.end() >> SocDescription::GRANULE_SHIFT; granule++) {
+            granules[granule] = index;
+        }
+    }
+    
+    ram.assign(soc.storageSize(), 0);
+    size_t pages = ram.size() / PAGE_SIZE;
+    dirtyPages.assign((pages + 63) / 64, 0);
+    checkpointPages.assign((pages + 63) / 64, 0);
+    codePages.assign((pages + 63) / 64, 0);
+    pageGenerations.assign(pages, 0);
+    
+    if (quiet) return;
+    std::cout << "Memory initialized: " << (ram.size() / 1024) << "KB RAM" << std::endl;
+    for (const auto& region : regions) {
+        std::cout << (region.isRam ? "RAM" : "MMIO") << " range: 0x" << std::hex << region.base
+                  << " - 0x" << (region.base + region.size - 1) << std::dec << std::endl;
+    }
 }
 
 void Memory::setPeripheralCallbacks(
@@ -26,20 +66,15 @@ void Memory::setPeripheralCallbacks(
 }
 
 uint8_t Memory::read8(uint32_t address) const {
-    if (!isValidAddress(address)) {
+    const Region* region = regionFor(address);
+    if (!region) {
         throw std::out_of_range("Invalid memory address: 0x" + std::to_string(address));
     }
     
-    if (isRAMAddress(address)) {
-        uint32_t offset = address - RAM_BASE;
-        return ram[offset];
+    if (region->isRam) {
+        return ram[region->offset + (address - region->base)];
     }
-    
-    if (isPeripheralAddress(address) && peripheralRead8Callback) {
-        return peripheralRead8Callback(address);
-    }
-    
-    return 0;
+    return peripheralRead8Callback ? peripheralRead8Callback(address) : 0;
 }
 
 uint16_t Memory::read16(uint32_t address) const {
@@ -47,18 +82,16 @@ uint16_t Memory::read16(uint32_t address) const {
         throw std::runtime_error("Unaligned 16-bit read at address: 0x" + std::to_string(address));
     }
     
-    if (isRAMAddress(address)) {
-        uint16_t value = 0;
-        value |= static_cast<uint16_t>(read8(address));
-        value |= static_cast<uint16_t>(read8(address + 1)) << 8;
-        return value;
-    }
+    const Region* region = regionFor(address);
+    if (!region) return 0;
     
-    if (isPeripheralAddress(address) && peripheralRead16Callback) {
-        return peripheralRead16Callback(address);
+    // Aligned accesses never straddle a region, since regions are 64KB aligned
+    if (region->isRam) {
+        uint16_t value;
+        std::memcpy(&value, &ram[region->offset + (address - region->base)], sizeof(value));
+        return value;
     }
-    
-    return 0;
+    return peripheralRead16Callback ? peripheralRead16Callback(address) : 0;
 }
 
 uint32_t Memory::read32(uint32_t address) const {
@@ -66,31 +99,28 @@ uint32_t Memory::read32(uint32_t address) const {
         throw std::runtime_error("Unaligned 32-bit read at address: 0x" + std::to_string(address));
     }
     
-    if (isRAMAddress(address)) {
-        uint32_t value = 0;
-        value |= static_cast<uint32_t>(read8(address));
-        value |= static_cast<uint32_t>(read8(address + 1)) << 8;
-        value |= static_cast<uint32_t>(read8(address + 2)) << 16;
-        value |= static_cast<uint32_t>(read8(address + 3)) << 24;
-        return value;
-    }
+    const Region* region = regionFor(address);
+    if (!region) return 0;
     
-    if (isPeripheralAddress(address) && peripheralRead32Callback) {
-        return peripheralRead32Callback(address);
+    if (region->isRam) {
+        uint32_t value;
+        std::memcpy(&value, &ram[region->offset + (address - region->base)], sizeof(value));
+        return value;
     }
-    
-    return 0;
+    return peripheralRead32Callback ? peripheralRead32Callback(address) : 0;
 }
 
 void Memory::write8(uint32_t address, uint8_t value) {
-    if (!isValidAddress(address)) {
+    const Region* region = regionFor(address);
+    if (!region) {
         throw std::out_of_range("Invalid memory address: 0x" + std::to_string(address));
     }
     
-    if (isRAMAddress(address)) {
-        uint32_t offset = address - RAM_BASE;
+    if (region->isRam) {
+        uint32_t offset = region->offset + (address - region->base);
         ram[offset] = value;
-    } else if (isPeripheralAddress(address) && peripheralWrite8Callback) {
+        markDirty(offset);
+    } else if (peripheralWrite8Callback) {
         peripheralWrite8Callback(address, value);
     }
 }
@@ -100,10 +130,14 @@ void Memory::write16(uint32_t address, uint16_t value) {
         throw std::runtime_error("Unaligned 16-bit write at address: 0x" + std::to_string(address));
     }
     
-    if (isRAMAddress(address)) {
-        write8(address, value & 0xFF);
-        write8(address + 1, (value >> 8) & 0xFF);
-    } else if (isPeripheralAddress(address) && peripheralWrite16Callback) {
+    const Region* region = regionFor(address);
+    if (!region) return;
+    
+    if (region->isRam) {
+        uint32_t offset = region->offset + (address - region->base);
+        std::memcpy(&ram[offset], &value, sizeof(value));
+        markDirty(offset);
+    } else if (peripheralWrite16Callback) {
         peripheralWrite16Callback(address, value);
     }
 }
@@ -113,62 +147,182 @@ void Memory::write32(uint32_t address, uint32_t value) {
         throw std::runtime_error("Unaligned 32-bit write at address: 0x" + std::to_string(address));
     }
     
-    if (isRAMAddress(address)) {
-        write8(address, value & 0xFF);
-        write8(address + 1, (value >> 8) & 0xFF);
-        write8(address + 2, (value >> 16) & 0xFF);
-        write8(address + 3, (value >> 24) & 0xFF);
-    } else if (isPeripheralAddress(address) && peripheralWrite32Callback) {
+    const Region* region = regionFor(address);
+    if (!region) return;
+    
+    if (region->isRam) {
+        uint32_t offset = region->offset + (address - region->base);
+        std::memcpy(&ram[offset], &value, sizeof(value));
+        markDirty(offset);
+    } else if (peripheralWrite32Callback) {
         peripheralWrite32Callback(address, value);
     }
 }
 
 void Memory::writeBytes(uint32_t address, const std::vector<uint8_t>& data) {
-    if (!isValidAddress(address) || !isValidAddress(address + data.size() - 1)) {
+    writeBytes(address, data.data(), data.size());
+}
+
+void Memory::writeBytes(uint32_t address, const uint8_t* data, size_t length) {
+    if (length == 0) return;
+    if (length - 1 > 0xFFFFFFFFull - address ||
+        !isValidAddress(address) || !isValidAddress(static_cast<uint32_t>(address + length - 1))) {
         throw std::out_of_range("Invalid memory range for bulk write");
     }
     
-    if (isRAMAddress(address)) {
-        uint32_t offset = address - RAM_BASE;
-        std::memcpy(&ram[offset], data.data(), data.size());
+    if (uint8_t* span = ramSpanMutable(address, length)) {
+        std::memcpy(span, data, length);
+        markDirtyRange(static_cast<uint32_t>(span - ram.data()), length);
+        return;
+    }
+    
+    for (size_t i = 0; i < length; i++) {
+        write8(address + i, data[i]);
     }
 }
 
 std::vector<uint8_t> Memory::readBytes(uint32_t address, size_t length) const {
-    if (!isValidAddress(address) || !isValidAddress(address + length - 1)) {
+    std::vector<uint8_t> data(length);
+    readBytes(address, data.data(), length);
+    return data;
+}
+
+void Memory::readBytes(uint32_t address, uint8_t* data, size_t length) const {
+    if (length == 0) return;
+    if (length - 1 > 0xFFFFFFFFull - address ||
+        !isValidAddress(address) || !isValidAddress(static_cast<uint32_t>(address + length - 1))) {
         throw std::out_of_range("Invalid memory range for bulk read");
     }
     
-    std::vector<uint8_t> data(length);
+    if (const uint8_t* span = ramSpan(address, length)) {
+        std::memcpy(data, span, length);
+        return;
+    }
+    
     for (size_t i = 0; i < length; i++) {
         data[i] = read8(address + i);
     }
-    return data;
 }
 
-bool Memory::isValidAddress(uint32_t address) const {
-    return isRAMAddress(address) || isPeripheralAddress(address);
+void Memory::codeWritten(size_t word, uint64_t bits) {
+    codePages[word] &= ~bits;
+    while (bits) {
+        pageGenerations[(word << 6) + __builtin_ctzll(bits)]++;
+        bits &= bits - 1;
+    }
+    if (codeWriteCallback) {
+        codeWriteCallback();
+    }
+}
+
+void Memory::markDirtyRange(uint32_t offset, size_t length) {
+    for (uint32_t page = offset >> PAGE_SHIFT; page <= (offset + length - 1) >> PAGE_SHIFT; page++) {
+        markDirty(page << PAGE_SHIFT);
+    }
+}
+
+const uint8_t* Memory::ramSpan(uint32_t address, size_t length) const {
+    const Region* region = regionFor(address);
+    if (!region || !region->isRam || length > static_cast<size_t>(region->size - (address - region->base))) {
+        return nullptr;
+    }
+    return &ram[region->offset + (address - region->base)];
+}
+
+uint8_t* Memory::ramSpanMutable(uint32_t address, size_t length) {
+    return const_cast<uint8_t*>(ramSpan(address, length));
+}
+
+size_t Memory::ramAvailable(uint32_t address) const {
+    const Region* region = regionFor(address);
+    if (!region || !region->isRam) return 0;
+    return region->size - (address - region->base);
+}
+
+void Memory::copy(uint32_t destination, uint32_t source, size_t length) {
+    if (length == 0) return;
+    
+    uint8_t* target = ramSpanMutable(destination, length);
+    const uint8_t* origin = ramSpan(source, length);
+    if (target && origin) {
+        std::memmove(target, origin, length);
+        markDirtyRange(static_cast<uint32_t>(target - ram.data()), length);
+        return;
+    }
+    
+    // Copy backwards when the destination overlaps the tail of the source
+    if (destination > source && destination - source < length) {
+        for (size_t i = length; i-- > 0;) {
+            write8(destination + i, read8(source + i));
+        }
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            write8(destination + i, read8(source + i));
+        }
+    }
 }
 
-bool Memory::isRAMAddress(uint32_t address) const {
-    return address >= RAM_BASE && address <= RAM_END;
+void Memory::fill(uint32_t address, uint8_t value, size_t length) {
+    if (length == 0) return;
+    
+    if (uint8_t* span = ramSpanMutable(address, length)) {
+        std::memset(span, value, length);
+        markDirtyRange(static_cast<uint32_t>(span - ram.data()), length);
+        return;
+    }
+    
+    for (size_t i = 0; i < length; i++) {
+        write8(address + i, value);
+    }
 }
 
-bool Memory::isPeripheralAddress(uint32_t address) const {
-    return address >= 0x3FF00000 && address < RAM_BASE;
+void Memory::loadRAM(const std::vector<uint8_t>& image) {
+    if (image.size() != ram.size()) {
+        throw std::invalid_argument("RAM image size mismatch");
+    }
+    ram = image;
+    markDirtyRange(0, ram.size());
 }
 
-void Memory::mapPeripheral(uint32_t address, uint32_t peripheralId) {
-    peripheralMappings[address] = peripheralId;
+void Memory::clearDirtyPages() {
+    std::fill(dirtyPages.begin(), dirtyPages.end(), 0);
 }
 
-void Memory::unmapPeripheral(uint32_t address) {
-    peripheralMappings.erase(address);
+void Memory::restoreDirtyPages(const std::vector<uint8_t>& image) {
+    if (image.size() != ram.size()) {
+        throw std::invalid_argument("RAM image size mismatch");
+    }
+    
+    for (size_t word = 0; word < dirtyPages.size(); word++) {
+        uint64_t bits = dirtyPages[word];
+        while (bits) {
+            size_t offset = ((word << 6) + __builtin_ctzll(bits)) << PAGE_SHIFT;
+            std::memcpy(&ram[offset], &image[offset], PAGE_SIZE);
+            bits &= bits - 1;
+        }
+        // Rolled-back pages differ from whatever the last checkpoint saw,
+        // and from any code decoded since they were written
+        checkpointPages[word] |= dirtyPages[word];
+        if (codePages[word] & dirtyPages[word]) {
+            codeWritten(word, codePages[word] & dirtyPages[word]);
+        }
+        dirtyPages[word] = 0;
+    }
 }
 
-uint32_t Memory::getPeripheralId(uint32_t address) const {
-    auto it = peripheralMappings.find(address);
-    return (it != peripheralMappings.end()) ? it->second : 0;
+void Memory::takeCheckpointPages(std::vector<uint32_t>& pages, bool all) {
+    const uint32_t pageCount = static_cast<uint32_t>(ram.size() / PAGE_SIZE);
+    pages.clear();
+    for (size_t word = 0; word < checkpointPages.size(); word++) {
+        uint64_t bits = all ? ~0ULL : checkpointPages[word];
+        while (bits) {
+            uint32_t page = static_cast<uint32_t>((word << 6) + __builtin_ctzll(bits));
+            if (page >= pageCount) break;
+            pages.push_back(page);
+            bits &= bits - 1;
+        }
+        checkpointPages[word] = 0;
+    }
 }
 
 void Memory::dumpMemory(uint32_t address, size_t length) const {
@@ -176,11 +330,11 @@ void Memory::dumpMemory(uint32_t address, size_t length) const {
     
     for (size_t i = 0; i < length; i += 16) {
         std::cout << std::hex << std::setw(8) << std::setfill('0') << (address + i) << ": ";
-        
+    
         for (size_t j = 0; j < 16 && (i + j) < length; j++) {
-            std::cout << std::hex << std::setw(2) << std::setfill('0') 
+            std::cout << std::hex << std::setw(2) << std::setfill('0')
                       << static_cast<int>(read8(address + i + j)) << " ";
         }
         std::cout << std::dec << std::endl;
     }
-} 
\ No newline at end of file
+}
@@ -4,16 +4,72 @@
 #include <cstdint>
 #include <map>
 #include <functional>
+#include "SocDescription.h"
 
 
 class Memory {
+public:
+    static constexpr uint32_t PAGE_SHIFT = 12;
+    static constexpr uint32_t PAGE_SIZE = 1u << PAGE_SHIFT;
+    
+    // MMIO regions are split into 4KB slots, which is how Emulator finds
+    // the peripheral behind an address with one array lookup
+    static constexpr uint32_t MMIO_SLOT_SHIFT = 12;
+
 private:
-    static constexpr size_t RAM_SIZE = 4 * 1024 * 1024; // 4MB
-    static constexpr uint32_t RAM_BASE = 0x3FF80000;
-    static constexpr uint32_t RAM_END = 0x3FFFFFFF;
+    // Compiled from the SocDescription. Every 64KB granule of the address
+    // space points at the region covering it (index + 1, 0 = unmapped), so
+    // classifying an address is one table load.
+    struct Region {
+        uint32_t base;
+        uint32_t size;
+        bool isRam;
+        uint32_t offset;    // RAM: byte offset into ram. MMIO: first slot index.
+    };
+    std::vector<Region> regions;
+    std::vector<uint8_t> granules;
+    uint32_t mmioSlots;
+    uint32_t primaryBase;   // First RAM region, for getRAMBase/getRAMEnd
+    uint32_t primarySize;
     
     std::vector<uint8_t> ram;
     
+    // One bit per RAM page written since the last clearDirtyPages(), and a
+    // second set, independent of snapshots, since the last checkpoint
+    std::vector<uint64_t> dirtyPages;
+    std::vector<uint64_t> checkpointPages;
+    
+    // Pages the CPU has decoded instructions from. The first write to one
+    // bumps its generation, drops the mark and tells the CPU; blocks carry
+    // the generation they were decoded at, so only blocks from that page go
+    // stale. Writes to pages with no decoded code only pay the bit test.
+    std::vector<uint64_t> codePages;
+    std::vector<uint32_t> pageGenerations;
+    std::function<void()> codeWriteCallback;
+    
+    const Region* regionFor(uint32_t address) const {
+        uint8_t slot = granules[address >> SocDescription::GRANULE_SHIFT];
+        return slot ? &regions[slot - 1] : nullptr;
+    }
+    
+    // Backing-store offset of a RAM address, or -1
+    int64_t ramOffset(uint32_t address) const {
+        const Region* region = regionFor(address);
+        return (region && region->isRam) ? static_cast<int64_t>(region->offset) + (address - region->base) : -1;
+    }
+    
+    void markDirty(uint32_t offset) {
+        uint64_t bit = 1ULL << ((offset >> PAGE_SHIFT) & 63);
+        dirtyPages[offset >> (PAGE_SHIFT + 6)] |= bit;
+        checkpointPages[offset >> (PAGE_SHIFT + 6)] |= bit;
+        if (codePages[offset >> (PAGE_SHIFT + 6)] & bit) {
+            codeWritten(offset >> (PAGE_SHIFT + 6), bit);
+        }
+    }
+    void codeWritten(size_t word, uint64_t bits);
+    void markDirtyRange(uint32_t offset, size_t length);
+    uint8_t* ramSpanMutable(uint32_t address, size_t length);
+    
     std::function<uint8_t(uint32_t)> peripheralRead8Callback;
     std::function<uint16_t(uint32_t)> peripheralRead16Callback;
     std::function<uint32_t(uint32_t)> peripheralRead32Callback;
@@ -23,6 +79,7 @@ private:
 
 public:
     Memory();
+    explicit Memory(const SocDescription& soc, bool quiet = false);
     ~Memory() = default;
 
     uint8_t read8(uint32_t address) const;
@@ -34,11 +91,34 @@ public:
     void write32(uint32_t address, uint32_t value);
     
     void writeBytes(uint32_t address, const std::vector<uint8_t>& data);
+    void writeBytes(uint32_t address, const uint8_t* data, size_t length);
     std::vector<uint8_t> readBytes(uint32_t address, size_t length) const;
+    void readBytes(uint32_t address, uint8_t* data, size_t length) const;
+    
+    // memmove/memset on guest memory; a single host call when the range is RAM
+    void copy(uint32_t destination, uint32_t source, size_t length);
+    void fill(uint32_t address, uint8_t value, size_t length);
+    
+    // Host pointer to [address, address + length) if it is all inside one
+    // RAM region, else nullptr
+    const uint8_t* ramSpan(uint32_t address, size_t length) const;
+    // Contiguous RAM bytes from address to the end of its region (0 if not RAM)
+    size_t ramAvailable(uint32_t address) const;
+    
+    bool isValidAddress(uint32_t address) const { return regionFor(address) != nullptr; }
+    bool isRAMAddress(uint32_t address) const { return ramOffset(address) >= 0; }
+    bool isPeripheralAddress(uint32_t address) const {
+        const Region* region = regionFor(address);
+        return region && !region->isRam;
+    }
     
-    bool isValidAddress(uint32_t address) const;
-    bool isRAMAddress(uint32_t address) const;
-    bool isPeripheralAddress(uint32_t address) const;
+    // Global MMIO slot for an address, or -1 outside MMIO regions
+    int32_t mmioSlot(uint32_t address) const {
+        const Region* region = regionFor(address);
+        if (!region || region->isRam) return -1;
+        return static_cast<int32_t>(region->offset + ((address - region->base) >> MMIO_SLOT_SHIFT));
+    }
+    uint32_t getMmioSlotCount() const { return mmioSlots; }
     
     void setPeripheralCallbacks(
         std::function<uint8_t(uint32_t)> read8,
@@ -49,8 +129,36 @@ public:
         std::function<void(uint32_t, uint32_t)> write32
     );
     
+    // The backing store of every RAM region (aliased regions share bytes)
+    const std::vector<uint8_t>& getRAM() const { return ram; }
+    void loadRAM(const std::vector<uint8_t>& image);
+    const std::vector<uint64_t>& getDirtyPages() const { return dirtyPages; }
+    void clearDirtyPages();
+    void restoreDirtyPages(const std::vector<uint8_t>& image);
+    
+    // RAM page (backing-store offset >> PAGE_SHIFT) of an address, or -1
+    int64_t ramPage(uint32_t address) const {
+        int64_t offset = ramOffset(address);
+        return offset < 0 ? -1 : offset >> PAGE_SHIFT;
+    }
+    // Marks a page as holding decoded code and returns its generation,
+    // which changes the next time anything writes to the page
+    uint32_t watchCodePage(uint32_t page) {
+        codePages[page >> 6] |= 1ULL << (page & 63);
+        return pageGenerations[page];
+    }
+    uint32_t getPageGeneration(uint32_t page) const { return pageGenerations[page]; }
+    // One per RAM page; the table never moves once the Memory exists
+    const uint32_t* getPageGenerations() const { return pageGenerations.data(); }
+    // Called when a write lands on a watched page, so the CPU can drop a
+    // block it is partway through
+    void setCodeWriteCallback(std::function<void()> callback) { codeWriteCallback = std::move(callback); }
+    
+    // Page indices written since the last call (every page if all is set)
+    void takeCheckpointPages(std::vector<uint32_t>& pages, bool all);
+    
     void dumpMemory(uint32_t address, size_t length) const;
-    size_t getRAMSize() const { return RAM_SIZE; }
-    uint32_t getRAMBase() const { return RAM_BASE; }
-    uint32_t getRAMEnd() const { return RAM_END; }
-}; 
\ No newline at end of file
+    size_t getRAMSize() const { return ram.size(); }
+    uint32_t getRAMBase() const { return primaryBase; }
+    uint32_t getRAMEnd() const { return primaryBase + primarySize - 1; }
+};
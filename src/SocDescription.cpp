@@ -0,0 +1,222 @@
+#include "SocDescription.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+uint64_t parseNumber(const std::string& text, const std::string& where) {
+    try {
+        size_t used = 0;
+        uint64_t value = std::stoull(text, &used, 0);
+        if (used != text.size()) throw std::invalid_argument(text);
+        return value;
+    } catch (const std::exception&) {
+        throw std::invalid_argument(where + ": expected a number, got '" + text + "'");
+    }
+}
+
+uint32_t parseAddress(const std::string& text, const std::string& where) {
+    uint64_t value = parseNumber(text, where);
+    if (value > 0xFFFFFFFFull) {
+        throw std::invalid_argument(where + ": " + text + " does not fit in 32 bits");
+    }
+    return static_cast<uint32_t>(value);
+}
+
+}
+
+SocDescription::SocDescription() : clockHz(240000000), cores(1), firmwareBase(0x40080000) {
+}
+
+SocDescription SocDescription::esp32() {
+    SocDescription soc;
+    soc.name = "esp32";
+    soc.cores = 2;
+    soc.regions = {
+        {"mmio", Region::Kind::Mmio, 0x3FF00000, 0x80000, 0},
+        {"ram", Region::Kind::Ram, 0x3FF80000, 0x400000, 0},
+    };
+    soc.peripherals = {
+        {"uart", 0x3FF40000, false},
+        {"gpio", 0x3FF44000, false},
+        {"wifi", 0x3FF50000, true},
+    };
+    soc.timing = {
+        {TimingRange::Kind::Flash, 0x3F400000, 0x400000},   // DROM
+        {TimingRange::Kind::Dram, 0x3FF80000, 0x80000},
+        {TimingRange::Kind::Iram, 0x40070000, 0x50000},
+        {TimingRange::Kind::Flash, 0x400C2000, 0xB3E000},   // IROM
+    };
+    return soc;
+}
+
+// One directive per line, '#' starts a comment:
+//   name <text>
+//   clock <hz>
+//   cores <n>
+//   firmware <address>
+//   ram <name> <base> <size> [at <storage offset>]
+//   mmio <name> <base> <size>
+//   peripheral <type> <base> [lazy]
+//   timing <flash|iram|dram> <base> <size>
+SocDescription SocDescription::parse(std::istream& input, const std::string& sourceName) {
+    SocDescription soc;
+    uint32_t nextStorage = 0;
+    std::string line;
+    unsigned lineNumber = 0;
+
+    while (std::getline(input, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream words(line);
+        std::vector<std::string> fields;
+        for (std::string word; words >> word;) {
+            fields.push_back(word);
+        }
+        if (fields.empty()) continue;
+
+        const std::string where = sourceName + ":" + std::to_string(lineNumber);
+        const std::string& directive = fields[0];
+        auto expect = [&](size_t minimum, size_t maximum) {
+            if (fields.size() < minimum || fields.size() > maximum) {
+                throw std::invalid_argument(where + ": wrong number of fields for '" + directive + "'");
+            }
+        };
+
+        if (directive == "name") {
+            expect(2, 2);
+            soc.name = fields[1];
+        } else if (directive == "clock") {
+            expect(2, 2);
+            soc.clockHz = parseNumber(fields[1], where);
+        } else if (directive == "cores") {
+            expect(2, 2);
+            soc.cores = static_cast<unsigned>(parseNumber(fields[1], where));
+        } else if (directive == "firmware") {
+            expect(2, 2);
+            soc.firmwareBase = parseAddress(fields[1], where);
+        } else if (directive == "ram") {
+            expect(4, 6);
+            Region region{fields[1], Region::Kind::Ram, parseAddress(fields[2], where),
+                          parseAddress(fields[3], where), nextStorage};
+            if (fields.size() == 6 && fields[4] == "at") {
+                region.storageOffset = parseAddress(fields[5], where);
+            } else if (fields.size() != 4) {
+                throw std::invalid_argument(where + ": expected 'at <offset>' after the RAM size");
+            }
+            nextStorage = std::max<uint64_t>(nextStorage, static_cast<uint64_t>(region.storageOffset) + region.size);
+            soc.regions.push_back(region);
+        } else if (directive == "mmio") {
+            expect(4, 4);
+            soc.regions.push_back({fields[1], Region::Kind::Mmio, parseAddress(fields[2], where),
+                                   parseAddress(fields[3], where), 0});
+        } else if (directive == "peripheral") {
+            expect(3, 4);
+            bool lazy = fields.size() == 4;
+            if (lazy && fields[3] != "lazy") {
+                throw std::invalid_argument(where + ": unknown peripheral flag '" + fields[3] + "'");
+            }
+            soc.peripherals.push_back({fields[1], parseAddress(fields[2], where), lazy});
+        } else if (directive == "timing") {
+            expect(4, 4);
+            TimingRange range{TimingRange::Kind::Flash, parseAddress(fields[2], where), parseAddress(fields[3], where)};
+            if (fields[1] == "iram") {
+                range.kind = TimingRange::Kind::Iram;
+            } else if (fields[1] == "dram") {
+                range.kind = TimingRange::Kind::Dram;
+            } else if (fields[1] != "flash") {
+                throw std::invalid_argument(where + ": unknown timing class '" + fields[1] + "'");
+            }
+            soc.timing.push_back(range);
+        } else {
+            throw std::invalid_argument(where + ": unknown directive '" + directive + "'");
+        }
+    }
+
+    if (soc.name.empty()) {
+        soc.name = sourceName;
+    }
+    soc.validate();
+    return soc;
+}
+
+SocDescription SocDescription::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open SoC description: " + path);
+    }
+    return parse(file, path);
+}
+
+const SocDescription::PeripheralEntry* SocDescription::findPeripheral(const std::string& type) const {
+    for (const auto& entry : peripherals) {
+        if (entry.type == type) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t SocDescription::storageSize() const {
+    uint64_t size = 0;
+    for (const auto& region : regions) {
+        if (region.kind == Region::Kind::Ram) {
+            size = std::max<uint64_t>(size, static_cast<uint64_t>(region.storageOffset) + region.size);
+        }
+    }
+    return static_cast<uint32_t>(size);
+}
+
+void SocDescription::validate() const {
+    if (clockHz == 0) {
+        throw std::invalid_argument(name + ": clock must be non-zero");
+    }
+    if (cores == 0) {
+        throw std::invalid_argument(name + ": needs at least one core");
+    }
+
+    bool hasRam = false;
+    for (size_t i = 0; i < regions.size(); i++) {
+        const Region& region = regions[i];
+        if (region.size == 0 || region.base % GRANULE_SIZE || region.size % GRANULE_SIZE ||
+            region.end() > 0x100000000ull) {
+            throw std::invalid_argument(name + ": region " + region.name +
+                                        " must be a non-empty, 64KB-aligned range below 4GB");
+        }
+        if (region.kind == Region::Kind::Ram) {
+            hasRam = true;
+            if (region.storageOffset % GRANULE_SIZE ||
+                static_cast<uint64_t>(region.storageOffset) + region.size > 0x40000000ull) {
+                throw std::invalid_argument(name + ": RAM region " + region.name + " has a bad storage offset");
+            }
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (region.base < regions[j].end() && regions[j].base < region.end()) {
+                throw std::invalid_argument(name + ": regions " + regions[j].name + " and " +
+                                            region.name + " overlap");
+            }
+        }
+    }
+    if (!hasRam) {
+        throw std::invalid_argument(name + ": needs at least one RAM region");
+    }
+
+    for (const auto& entry : peripherals) {
+        bool mapped = std::any_of(regions.begin(), regions.end(), [&](const Region& region) {
+            return region.kind == Region::Kind::Mmio && entry.base >= region.base && entry.base < region.end();
+        });
+        if (!mapped) {
+            throw std::invalid_argument(name + ": peripheral " + entry.type + " is outside every MMIO region");
+        }
+    }
+
+    const uint32_t timingPage = 1u << TIMING_PAGE_SHIFT;
+    for (const auto& range : timing) {
+        if (range.size == 0 || range.base % timingPage || range.size % timingPage || range.end() > 0x100000000ull) {
+            throw std::invalid_argument(name + ": timing ranges must be non-empty, 4KB-aligned and below 4GB");
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+// What an SoC looks like: memory regions, which peripherals sit where, the
+// clock and the core count. Parsed once from a small text file (see
+// soc/esp32.soc) and compiled by Memory and Emulator into flat lookup
+// tables, so nothing here is consulted on the hot path.
+class SocDescription {
+public:
+    // Regions are mapped in 64KB granules, so bases and sizes must be
+    // multiples of this
+    static constexpr uint32_t GRANULE_SHIFT = 16;
+    static constexpr uint32_t GRANULE_SIZE = 1u << GRANULE_SHIFT;
+
+    struct Region {
+        enum class Kind { Ram, Mmio };
+        std::string name;
+        Kind kind;
+        uint32_t base;
+        uint32_t size;
+        // RAM only: where the bytes live in the backing store. Two regions
+        // with the same offset alias each other (IRAM/DRAM views of one SRAM).
+        uint32_t storageOffset;
+
+        uint64_t end() const { return static_cast<uint64_t>(base) + size; }
+    };
+
+    // How the real chip reaches an address range, for the optional timing
+    // model only: flash seen through the cache (IROM/DROM), or internal
+    // IRAM/DRAM. MMIO regions count as peripheral accesses on their own.
+    struct TimingRange {
+        enum class Kind { Flash, Iram, Dram };
+        Kind kind;
+        uint32_t base;
+        uint32_t size;
+
+        uint64_t end() const { return static_cast<uint64_t>(base) + size; }
+    };
+
+    // Timing ranges only need page alignment
+    static constexpr uint32_t TIMING_PAGE_SHIFT = 12;
+
+    struct PeripheralEntry {
+        std::string type;    // "uart", "gpio", "wifi", ...
+        uint32_t base;
+        bool lazy;           // Created on first use (e.g. WiFi) rather than at startup
+    };
+
+    std::string name;
+    uint64_t clockHz;
+    unsigned cores;
+    uint32_t firmwareBase;   // Where raw .bin images load and start
+    std::vector<Region> regions;
+    std::vector<PeripheralEntry> peripherals;
+    std::vector<TimingRange> timing;
+
+    SocDescription();
+
+    // The layout vesp has always used: 4MB of RAM at 0x3FF80000, peripherals
+    // from 0x3FF00000, UART at 0x3FF40000, GPIO at 0x3FF44000, WiFi on
+    // demand at 0x3FF50000. Timing ranges follow the real ESP32 map.
+    static SocDescription esp32();
+
+    static SocDescription parse(std::istream& input, const std::string& sourceName);
+    static SocDescription load(const std::string& path);
+
+    const PeripheralEntry* findPeripheral(const std::string& type) const;
+    // Bytes of backing store the RAM regions need
+    uint32_t storageSize() const;
+
+    // Throws std::invalid_argument describing the first problem found
+    void validate() const;
+};
@@ -0,0 +1,248 @@
+#include "SymbolIndex.h"
+#include "Dwarf.h"
+#include "ElfFile.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint8_t STT_OBJECT = 1;
+constexpr uint8_t STT_FUNC = 2;
+constexpr uint8_t STB_GLOBAL = 1;
+constexpr uint16_t SHN_UNDEF = 0;
+
+struct RawSymbol {
+    uint32_t address;
+    uint32_t size;
+    uint8_t type;
+    uint8_t binding;
+    std::string name;
+};
+
+std::vector<RawSymbol> readSymbols(const ElfFile& elf) {
+    std::vector<RawSymbol> symbols;
+
+    const auto& sections = elf.getSections();
+    for (const auto& section : sections) {
+        if (section.type != ElfFile::SHT_SYMTAB || section.link >= sections.size()) continue;
+
+        std::vector<uint8_t> table = elf.sectionData(section);
+        std::vector<uint8_t> strings = elf.sectionData(sections[section.link]);
+        size_t entrySize = elf.is64Bit() ? 24 : 16;
+
+        for (size_t offset = entrySize; offset + entrySize <= table.size(); offset += entrySize) {
+            const uint8_t* entry = &table[offset];
+            uint32_t nameOffset;
+            uint8_t info;
+            uint16_t sectionIndex;
+            uint64_t value, size;
+            std::memcpy(&nameOffset, entry, 4);
+            if (elf.is64Bit()) {
+                info = entry[4];
+                std::memcpy(&sectionIndex, entry + 6, 2);
+                std::memcpy(&value, entry + 8, 8);
+                std::memcpy(&size, entry + 16, 8);
+            } else {
+                uint32_t value32, size32;
+                std::memcpy(&value32, entry + 4, 4);
+                std::memcpy(&size32, entry + 8, 4);
+                info = entry[12];
+                std::memcpy(&sectionIndex, entry + 14, 2);
+                value = value32;
+                size = size32;
+            }
+
+            uint8_t type = info & 0x0F;
+            if ((type != STT_FUNC && type != STT_OBJECT) || sectionIndex == SHN_UNDEF) continue;
+            if (nameOffset >= strings.size()) continue;
+
+            const char* name = reinterpret_cast<const char*>(&strings[nameOffset]);
+            size_t nameLength = strnlen(name, strings.size() - nameOffset);
+            if (nameLength == 0) continue;
+
+            symbols.push_back({static_cast<uint32_t>(value), static_cast<uint32_t>(size),
+                               type, static_cast<uint8_t>(info >> 4), std::string(name, nameLength)});
+        }
+    }
+    return symbols;
+}
+
+}
+
+uint32_t SymbolIndex::addName(std::string_view name) {
+    uint32_t offset = static_cast<uint32_t>(names.size());
+    names.append(name);
+    names.push_back('\0');
+    return offset;
+}
+
+std::string_view SymbolIndex::nameAt(uint32_t offset) const {
+    return std::string_view(names.data() + offset);
+}
+
+std::shared_ptr<const SymbolIndex> SymbolIndex::fromElf(const ElfFile& elf, bool loadInlineFrames) {
+    auto index = std::make_shared<SymbolIndex>();
+    std::vector<RawSymbol> symbols = readSymbols(elf);
+
+    // Aliases share an address: keep one function per start, preferring
+    // globals and then the larger size
+    std::vector<RawSymbol> functions;
+    for (const auto& symbol : symbols) {
+        if (symbol.type == STT_FUNC) functions.push_back(symbol);
+    }
+    std::sort(functions.begin(), functions.end(), [](const RawSymbol& a, const RawSymbol& b) {
+        if (a.address != b.address) return a.address < b.address;
+        if ((a.binding == STB_GLOBAL) != (b.binding == STB_GLOBAL)) return a.binding == STB_GLOBAL;
+        return a.size > b.size;
+    });
+    functions.erase(std::unique(functions.begin(), functions.end(), [](const RawSymbol& a, const RawSymbol& b) {
+        return a.address == b.address;
+    }), functions.end());
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        const RawSymbol& function = functions[i];
+        uint32_t end = function.address + function.size;
+        // Unsized symbols (hand-written assembly) run up to the next function
+        if (function.size == 0) {
+            end = (i + 1 < functions.size()) ? functions[i + 1].address : function.address + 1;
+        }
+        index->starts.push_back(function.address);
+        index->ends.push_back(end);
+        index->nameOffsets.push_back(index->addName(function.name));
+    }
+
+    for (const auto& symbol : symbols) {
+        index->allAddresses.push_back(symbol.address);
+        index->allSizes.push_back(symbol.size);
+        index->allNameOffsets.push_back(index->addName(symbol.name));
+    }
+    index->byName.resize(index->allAddresses.size());
+    std::iota(index->byName.begin(), index->byName.end(), 0);
+    std::sort(index->byName.begin(), index->byName.end(), [&](uint32_t a, uint32_t b) {
+        return index->nameAt(index->allNameOffsets[a]) < index->nameAt(index->allNameOffsets[b]);
+    });
+
+    if (loadInlineFrames && elf.findSection(".debug_info")) {
+        DwarfInlineTable inlines(elf.sectionData(".debug_info"), elf.sectionData(".debug_abbrev"),
+                                 elf.sectionData(".debug_str"), elf.sectionData(".debug_line_str"));
+        uint32_t maxEnd = 0;
+        for (const auto& range : inlines.getRanges()) {
+            uint32_t end = static_cast<uint32_t>(range.end);
+            maxEnd = std::max(maxEnd, end);
+            index->inlineStarts.push_back(static_cast<uint32_t>(range.begin));
+            index->inlineEnds.push_back(end);
+            index->inlineMaxEnds.push_back(maxEnd);
+            index->inlineNameOffsets.push_back(index->addName(range.name));
+        }
+    }
+
+    index->buildBuckets();
+    return index;
+}
+
+void SymbolIndex::buildBuckets() {
+    buckets.clear();
+    if (starts.empty()) return;
+
+    bucketBase = starts.front() & ~((1u << BUCKET_SHIFT) - 1);
+    size_t count = ((static_cast<uint64_t>(ends.back() > starts.back() ? ends.back() : starts.back()) - bucketBase)
+                    >> BUCKET_SHIFT) + 2;
+    if (count > MAX_BUCKETS) {
+        // Sparse images fall back to a plain binary search
+        return;
+    }
+
+    buckets.resize(count);
+    size_t index = 0;
+    for (size_t bucket = 0; bucket < count; bucket++) {
+        uint64_t pageStart = bucketBase + (static_cast<uint64_t>(bucket) << BUCKET_SHIFT);
+        while (index < starts.size() && starts[index] < pageStart) index++;
+        buckets[bucket] = static_cast<uint32_t>(index);
+    }
+}
+
+bool SymbolIndex::lookup(uint32_t address, Symbol& symbol) const {
+    if (starts.empty() || address < starts.front()) return false;
+
+    auto first = starts.begin();
+    auto last = starts.end();
+    if (!buckets.empty()) {
+        size_t bucket = (address - bucketBase) >> BUCKET_SHIFT;
+        if (bucket + 1 < buckets.size()) {
+            // The answer is the last start <= address, which lies in this
+            // page's run or is the final entry before it
+            first = starts.begin() + (buckets[bucket] ? buckets[bucket] - 1 : 0);
+            last = starts.begin() + buckets[bucket + 1];
+        }
+    }
+
+    auto it = std::upper_bound(first, last, address);
+    if (it == starts.begin()) return false;
+    size_t index = static_cast<size_t>(it - starts.begin()) - 1;
+    if (address >= ends[index]) return false;
+
+    symbol.address = starts[index];
+    symbol.size = ends[index] - starts[index];
+    symbol.name = nameAt(nameOffsets[index]);
+    return true;
+}
+
+std::vector<std::string_view> SymbolIndex::inlineFrames(uint32_t address) const {
+    std::vector<std::string_view> frames;
+
+    auto it = std::upper_bound(inlineStarts.begin(), inlineStarts.end(), address);
+    for (size_t i = static_cast<size_t>(it - inlineStarts.begin()); i-- > 0;) {
+        if (inlineMaxEnds[i] <= address) break;
+        if (address < inlineEnds[i]) {
+            frames.push_back(nameAt(inlineNameOffsets[i]));
+        }
+    }
+    return frames;
+}
+
+bool SymbolIndex::findByName(std::string_view name, Symbol& symbol) const {
+    auto it = std::lower_bound(byName.begin(), byName.end(), name, [&](uint32_t index, std::string_view key) {
+        return nameAt(allNameOffsets[index]) < key;
+    });
+    if (it == byName.end() || nameAt(allNameOffsets[*it]) != name) return false;
+
+    symbol.address = allAddresses[*it];
+    symbol.size = allSizes[*it];
+    symbol.name = nameAt(allNameOffsets[*it]);
+    return true;
+}
+
+std::string SymbolIndex::format(uint32_t address) const {
+    Symbol symbol;
+    if (!lookup(address, symbol)) return {};
+
+    std::ostringstream out;
+    out << symbol.name;
+    if (address != symbol.address) {
+        out << "+0x" << std::hex << (address - symbol.address) << std::dec;
+    }
+
+    auto frames = inlineFrames(address);
+    if (!frames.empty()) {
+        out << " [inlined: ";
+        for (size_t i = 0; i < frames.size(); i++) {
+            out << (i ? " <- " : "") << frames[i];
+        }
+        out << "]";
+    }
+    return out.str();
+}
+
+std::string SymbolIndex::describe(uint32_t address) const {
+    std::ostringstream out;
+    out << "0x" << std::hex << address << std::dec;
+
+    std::string symbol = format(address);
+    if (!symbol.empty()) {
+        out << " <" << symbol << ">";
+    }
+    return out.str();
+}
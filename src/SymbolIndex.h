@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ElfFile;
+
+
+// Read-only address -> symbol index built once from an ELF's .symtab (and
+// optionally DWARF inline info), then shared between emulator instances.
+// Lookups are a page bucket probe plus a short binary search over flat
+// arrays, so symbolizing millions of addresses stays cheap.
+class SymbolIndex {
+public:
+    struct Symbol {
+        uint32_t address;
+        uint32_t size;
+        std::string_view name;
+    };
+
+private:
+    static constexpr uint32_t BUCKET_SHIFT = 12;
+    static constexpr size_t MAX_BUCKETS = 1 << 20;
+
+    // Function intervals, sorted by start; parallel arrays keep the search hot
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> ends;
+    std::vector<uint32_t> nameOffsets;
+
+    // First interval index per 4KB page of [bucketBase, ...)
+    uint32_t bucketBase;
+    std::vector<uint32_t> buckets;
+
+    // Every named symbol (functions and data), sorted by name
+    std::vector<uint32_t> byName;
+    std::vector<uint32_t> allAddresses;
+    std::vector<uint32_t> allSizes;
+    std::vector<uint32_t> allNameOffsets;
+
+    // Inlined call ranges sorted by start, with a running max of end so a
+    // lookup can stop scanning backwards early
+    std::vector<uint32_t> inlineStarts;
+    std::vector<uint32_t> inlineEnds;
+    std::vector<uint32_t> inlineMaxEnds;
+    std::vector<uint32_t> inlineNameOffsets;
+
+    std::string names;
+
+    uint32_t addName(std::string_view name);
+    std::string_view nameAt(uint32_t offset) const;
+    void buildBuckets();
+
+public:
+    SymbolIndex() : bucketBase(0) {}
+
+    static std::shared_ptr<const SymbolIndex> fromElf(const ElfFile& elf, bool loadInlineFrames = true);
+
+    // Innermost function containing address, or nullptr
+    bool lookup(uint32_t address, Symbol& symbol) const;
+    // Inlined frames at address, innermost first
+    std::vector<std::string_view> inlineFrames(uint32_t address) const;
+    bool findByName(std::string_view name, Symbol& symbol) const;
+
+    // "func+0x1c" (plus " [inlined: a <- b]"), or "" when unknown
+    std::string format(uint32_t address) const;
+    // "0x400800a4 <func+0x1c>" or just the hex address
+    std::string describe(uint32_t address) const;
+
+    size_t functionCount() const { return starts.size(); }
+    size_t symbolCount() const { return allAddresses.size(); }
+};
@@ -0,0 +1,138 @@
+#include "TaskProfiler.h"
+#include "Memory.h"
+#include "SymbolIndex.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+TaskProfiler::TaskProfiler(uint32_t currentTcb, uint32_t switchContext, uint32_t nameAt)
+    : currentTcbAddress(currentTcb), switchAddress(switchContext), nameOffset(nameAt),
+      lastTask(0), haveLastTask(false), last{0, 0, 0, 0}, startCycles(0), switches(0) {
+}
+
+TaskProfiler TaskProfiler::fromSymbols(const SymbolIndex& symbols, uint32_t nameOffset) {
+    SymbolIndex::Symbol currentTcb;
+    SymbolIndex::Symbol switchContext;
+    if (!symbols.findByName("pxCurrentTCB", currentTcb)) {
+        throw std::runtime_error("Task profiling needs FreeRTOS firmware (no pxCurrentTCB symbol)");
+    }
+    if (!symbols.findByName("vTaskSwitchContext", switchContext)) {
+        throw std::runtime_error("Task profiling needs FreeRTOS firmware (no vTaskSwitchContext symbol)");
+    }
+    return TaskProfiler(currentTcb.address, switchContext.address, nameOffset);
+}
+
+std::string TaskProfiler::readName(const Memory& memory, uint32_t tcb) const {
+    if (tcb == 0) {
+        return "(no task)";
+    }
+
+    std::string name;
+    try {
+        for (uint32_t i = 0; i < MAX_NAME_LENGTH; i++) {
+            char c = static_cast<char>(memory.read8(tcb + nameOffset + i));
+            if (c == '\0') break;
+            name += (c >= 0x20 && c < 0x7F) ? c : '?';
+        }
+    } catch (const std::exception&) {
+        name.clear();
+    }
+    return name.empty() ? "?" : name;
+}
+
+TaskProfiler::Task& TaskProfiler::taskFor(const Memory& memory, uint32_t tcb, bool switchedIn) {
+    auto found = taskIndex.find(tcb);
+    if (found != taskIndex.end()) {
+        Task& known = tasks[found->second];
+        if (!switchedIn) {
+            return known;
+        }
+        std::string name = readName(memory, tcb);
+        if (name == known.name) {
+            return known;
+        }
+        // Same TCB, different task: the old row keeps what it ran
+        found->second = tasks.size();
+        tasks.push_back({tcb, std::move(name), 0, 0, 0, 0, 0});
+        return tasks.back();
+    }
+    taskIndex.emplace(tcb, tasks.size());
+    tasks.push_back({tcb, readName(memory, tcb), 0, 0, 0, 0, 0});
+    return tasks.back();
+}
+
+void TaskProfiler::begin(const Counters& now) {
+    last = now;
+    startCycles = now.cycles;
+    haveLastTask = false;
+}
+
+void TaskProfiler::sample(const Memory& memory, const Counters& now) {
+    // A snapshot restore rewinds the counters; start over from there
+    if (now.cycles < last.cycles || now.instructions < last.instructions || now.stallCycles < last.stallCycles ||
+        now.mmioAccesses < last.mmioAccesses) {
+        last = now;
+        return;
+    }
+
+    uint32_t tcb = 0;
+    try {
+        tcb = memory.read32(currentTcbAddress);
+    } catch (const std::exception&) {
+    }
+
+    bool switchedIn = !haveLastTask || tasks[lastTask].tcb != tcb;
+    Task& task = taskFor(memory, tcb, switchedIn);
+    size_t index = static_cast<size_t>(&task - tasks.data());
+    task.instructions += now.instructions - last.instructions;
+    task.cycles += now.cycles - last.cycles;
+    task.stallCycles += now.stallCycles - last.stallCycles;
+    task.mmioAccesses += now.mmioAccesses - last.mmioAccesses;
+    if (!haveLastTask || index != lastTask) {
+        task.switchesIn++;
+        if (haveLastTask) switches++;
+    }
+    lastTask = index;
+    haveLastTask = true;
+    last = now;
+}
+
+void TaskProfiler::writeReport(std::ostream& out, uint64_t clockHz) const {
+    uint64_t total = 0;
+    for (const auto& task : tasks) {
+        total += task.cycles;
+    }
+    double seconds = clockHz ? static_cast<double>(last.cycles - startCycles) / static_cast<double>(clockHz) : 0.0;
+
+    std::vector<const Task*> byCycles;
+    for (const auto& task : tasks) {
+        byCycles.push_back(&task);
+    }
+    std::sort(byCycles.begin(), byCycles.end(), [](const Task* a, const Task* b) { return a->cycles > b->cycles; });
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "Task profile: " << tasks.size() << " tasks, " << switches << " context switches";
+    if (seconds > 0) {
+        out << " (" << std::fixed << std::setprecision(1) << static_cast<double>(switches) / seconds
+            << "/s over " << std::setprecision(3) << seconds << "s guest time)";
+    }
+    out << std::endl;
+
+    out << "  " << std::left << std::setw(18) << "Task" << std::setw(12) << "TCB" << std::right
+        << std::setw(7) << "CPU%" << std::setw(15) << "Instructions" << std::setw(14) << "Stall cycles"
+        << std::setw(13) << "Idle cycles" << std::setw(10) << "MMIO" << std::setw(10) << "Switches" << std::endl;
+    for (const Task* task : byCycles) {
+        double share = total ? 100.0 * static_cast<double>(task->cycles) / static_cast<double>(total) : 0.0;
+        // Cycles that retired nothing and weren't stalls: waiting in WAITI,
+        // or charged for an intercepted library call
+        uint64_t busy = task->instructions + task->stallCycles;
+        uint64_t idle = task->cycles > busy ? task->cycles - busy : 0;
+        out << "  " << std::left << std::setw(18) << task->name << "0x" << std::hex << std::setw(10)
+            << task->tcb << std::dec << std::right << std::fixed << std::setprecision(1) << std::setw(7) << share
+            << std::setw(15) << task->instructions << std::setw(14) << task->stallCycles << std::setw(13) << idle << std::setw(10) << task->mmioAccesses
+            << std::setw(10) << task->switchesIn << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Memory;
+class SymbolIndex;
+
+
+// Per-task accounting for FreeRTOS firmware. The emulator calls sample()
+// whenever the PC reaches vTaskSwitchContext; at that point pxCurrentTCB
+// still names the task that has been running since the previous switch,
+// so everything counted in between is charged to it. Nothing is recorded
+// per instruction.
+class TaskProfiler {
+public:
+    // Running totals the emulator already keeps; the profiler only diffs them
+    struct Counters {
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t stallCycles;   // --timing pipeline and memory stalls, part of cycles
+        uint64_t mmioAccesses;
+    };
+
+    struct Task {
+        uint32_t tcb;
+        std::string name;
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t stallCycles;
+        uint64_t mmioAccesses;
+        uint64_t switchesIn;
+    };
+
+    // Offset of pcTaskName in the TCB with the stock FreeRTOS layout
+    // (no MPU, no list integrity check bytes), as ESP-IDF builds it
+    static constexpr uint32_t DEFAULT_NAME_OFFSET = 0x34;
+    static constexpr uint32_t MAX_NAME_LENGTH = 16;
+
+private:
+    uint32_t currentTcbAddress;
+    uint32_t switchAddress;
+    uint32_t nameOffset;
+
+    std::vector<Task> tasks;
+    std::unordered_map<uint32_t, size_t> taskIndex;
+    size_t lastTask;
+    bool haveLastTask;
+    Counters last;
+    uint64_t startCycles;
+    uint64_t switches;
+
+    // A task's name is read again whenever it's switched in, since FreeRTOS
+    // can hand a deleted task's TCB to a new one
+    Task& taskFor(const Memory& memory, uint32_t tcb, bool switchedIn);
+    std::string readName(const Memory& memory, uint32_t tcb) const;
+
+public:
+    TaskProfiler(uint32_t currentTcbAddress, uint32_t switchAddress, uint32_t nameOffset = DEFAULT_NAME_OFFSET);
+
+    // Finds pxCurrentTCB and vTaskSwitchContext; throws when the firmware
+    // isn't FreeRTOS
+    static TaskProfiler fromSymbols(const SymbolIndex& symbols, uint32_t nameOffset = DEFAULT_NAME_OFFSET);
+
+    uint32_t getSwitchAddress() const { return switchAddress; }
+
+    // Starts (or restarts) the accounting from now
+    void begin(const Counters& now);
+    // Charges everything since the last sample to the current task
+    void sample(const Memory& memory, const Counters& now);
+
+    const std::vector<Task>& getTasks() const { return tasks; }
+    uint64_t getSwitches() const { return switches; }
+
+    // Table of tasks by CPU share, with context-switch rate over guest time
+    void writeReport(std::ostream& out, uint64_t clockHz) const;
+};
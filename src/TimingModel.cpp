@@ -0,0 +1,217 @@
+#include "TimingModel.h"
+#include "SymbolIndex.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+TimingModel::Costs TimingModel::Costs::esp32() {
+    Costs costs;
+    costs.cacheSize = 32 * 1024;
+    costs.cacheWays = 2;
+    costs.cacheLineSize = 32;
+    costs.cacheMissPenalty = 100;
+    costs.iramDataAccess = 1;
+    costs.mmioRead = 6;
+    costs.mmioWrite = 3;
+    costs.takenBranch = 2;
+    return costs;
+}
+
+TimingModel::TimingModel(const SocDescription& soc, const Costs& modelCosts)
+    : costs(modelCosts), pages(size_t(1) << (32 - SocDescription::TIMING_PAGE_SHIFT), AccessClass::Other),
+      setMask(0), lineShift(0), useClock(0), instructionStall(0), instructionAccesses(0), instructionMisses(0),
+      pendingStall(0), symbols(nullptr), currentFunction(nullptr), currentStart(0), currentEnd(0),
+      instructions(0), cycles(0), cacheAccesses(0), cacheMisses(0), branchStalls(0), memoryStalls(0), mmioStalls(0) {
+    const uint32_t line = costs.cacheLineSize;
+    if (line == 0 || (line & (line - 1)) != 0 || costs.cacheWays == 0 ||
+        costs.cacheSize % (line * costs.cacheWays) != 0) {
+        throw std::invalid_argument("Cache geometry must use power-of-two lines that divide evenly into ways");
+    }
+    uint32_t sets = costs.cacheSize / (line * costs.cacheWays);
+    if ((sets & (sets - 1)) != 0) {
+        throw std::invalid_argument("Cache must have a power-of-two number of sets");
+    }
+    setMask = sets - 1;
+    lineShift = static_cast<uint32_t>(__builtin_ctz(line));
+    tags.resize(static_cast<size_t>(sets) * costs.cacheWays);
+    lastUse.resize(tags.size());
+    flushCache();
+
+    auto mark = [&](uint64_t base, uint64_t end, AccessClass kind) {
+        for (uint64_t page = base >> SocDescription::TIMING_PAGE_SHIFT;
+             page < (end + (1u << SocDescription::TIMING_PAGE_SHIFT) - 1) >> SocDescription::TIMING_PAGE_SHIFT; page++) {
+            pages[page] = kind;
+        }
+    };
+    for (const auto& range : soc.timing) {
+        AccessClass kind = range.kind == SocDescription::TimingRange::Kind::Flash ? AccessClass::Flash
+                         : range.kind == SocDescription::TimingRange::Kind::Iram ? AccessClass::Iram
+                         : AccessClass::Dram;
+        mark(range.base, range.end(), kind);
+    }
+    for (const auto& region : soc.regions) {
+        if (region.kind == SocDescription::Region::Kind::Mmio) {
+            mark(region.base, region.end(), AccessClass::Mmio);
+        }
+    }
+}
+
+void TimingModel::setSymbols(const SymbolIndex* index) {
+    symbols = index;
+    currentFunction = nullptr;
+    currentStart = currentEnd = 0;
+}
+
+void TimingModel::flushCache() {
+    // A line address can never be all ones, so that marks an empty way
+    std::fill(tags.begin(), tags.end(), UINT32_MAX);
+    std::fill(lastUse.begin(), lastUse.end(), 0);
+}
+
+uint32_t TimingModel::cacheAccess(uint32_t address) {
+    uint32_t lineAddress = address >> lineShift;
+    size_t set = static_cast<size_t>(lineAddress & setMask) * costs.cacheWays;
+    useClock++;
+    instructionAccesses++;
+
+    size_t victim = set;
+    for (size_t way = set; way < set + costs.cacheWays; way++) {
+        if (tags[way] == lineAddress) {
+            lastUse[way] = useClock;
+            return 0;
+        }
+        if (lastUse[way] < lastUse[victim]) {
+            victim = way;
+        }
+    }
+
+    tags[victim] = lineAddress;
+    lastUse[victim] = useClock;
+    instructionMisses++;
+    return costs.cacheMissPenalty;
+}
+
+void TimingModel::dataAccess(uint32_t address, bool write) {
+    uint32_t stall = 0;
+    switch (classify(address)) {
+        case AccessClass::Flash:
+            // Flash is read-only through the cache
+            if (!write) stall = cacheAccess(address);
+            memoryStalls += stall;
+            break;
+        case AccessClass::Iram:
+            stall = costs.iramDataAccess;
+            memoryStalls += stall;
+            break;
+        case AccessClass::Mmio:
+            stall = write ? costs.mmioWrite : costs.mmioRead;
+            mmioStalls += stall;
+            break;
+        default:
+            break;
+    }
+    instructionStall += stall;
+}
+
+TimingModel::FunctionStats& TimingModel::functionAt(uint32_t address) {
+    if (currentFunction && address >= currentStart && address < currentEnd) {
+        return *currentFunction;
+    }
+
+    SymbolIndex::Symbol symbol;
+    uint32_t key = 0;
+    if (symbols->lookup(address, symbol)) {
+        key = symbol.address;
+        currentStart = symbol.address;
+        currentEnd = symbol.address + std::max<uint32_t>(symbol.size, 1);
+    } else {
+        currentStart = currentEnd = 0;
+    }
+
+    auto [entry, inserted] = functions.try_emplace(key);
+    if (inserted) {
+        entry->second = {key ? std::string(symbol.name) : "(no symbol)", 0, 0, 0, 0};
+    }
+    currentFunction = &entry->second;
+    return entry->second;
+}
+
+void TimingModel::retire(uint32_t address, uint32_t length, uint32_t next) {
+    if (classify(address) == AccessClass::Flash) {
+        uint32_t stall = cacheAccess(address);
+        // An instruction that straddles two lines needs both
+        if (((address + length - 1) >> lineShift) != (address >> lineShift)) {
+            stall += cacheAccess(address + length - 1);
+        }
+        memoryStalls += stall;
+        instructionStall += stall;
+    }
+    if (next != address + length) {
+        branchStalls += costs.takenBranch;
+        instructionStall += costs.takenBranch;
+    }
+
+    uint64_t cost = 1 + instructionStall;
+    instructions++;
+    cycles += cost;
+    cacheAccesses += instructionAccesses;
+    cacheMisses += instructionMisses;
+    if (symbols) {
+        FunctionStats& function = functionAt(address);
+        function.instructions++;
+        function.cycles += cost;
+        function.cacheAccesses += instructionAccesses;
+        function.cacheMisses += instructionMisses;
+    }
+
+    pendingStall += instructionStall;
+    instructionStall = instructionAccesses = instructionMisses = 0;
+}
+
+void TimingModel::writeReport(std::ostream& out, size_t topFunctions) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    auto percent = [](uint64_t part, uint64_t whole) {
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    };
+
+    out << std::fixed << std::setprecision(2);
+    out << "Timing model: " << instructions << " instructions, " << cycles << " predicted cycles (CPI "
+        << (instructions ? static_cast<double>(cycles) / static_cast<double>(instructions) : 0.0) << ")" << std::endl;
+    out << "  Flash cache: " << cacheAccesses << " accesses, " << cacheMisses << " misses ("
+        << percent(cacheMisses, cacheAccesses) << "%)" << std::endl;
+    out << "  Stalls: memory " << memoryStalls << ", MMIO " << mmioStalls << ", branches " << branchStalls << std::endl;
+
+    if (functions.empty()) {
+        out.flags(flags);
+        out.precision(precision);
+        return;
+    }
+
+    std::vector<const FunctionStats*> sorted;
+    for (const auto& [start, function] : functions) {
+        sorted.push_back(&function);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const FunctionStats* a, const FunctionStats* b) {
+        return a->cycles > b->cycles;
+    });
+
+    out << "  " << std::left << std::setw(32) << "Function" << std::right << std::setw(14) << "Cycles"
+        << std::setw(8) << "Share" << std::setw(14) << "Instructions" << std::setw(7) << "CPI"
+        << std::setw(11) << "Misses" << std::setw(8) << "Miss%" << std::endl;
+    for (size_t i = 0; i < sorted.size() && i < topFunctions; i++) {
+        const FunctionStats& function = *sorted[i];
+        out << "  " << std::left << std::setw(32) << function.name.substr(0, 31) << std::right
+            << std::setw(14) << function.cycles << std::setprecision(1) << std::setw(7)
+            << percent(function.cycles, cycles) << "%" << std::setw(14) << function.instructions
+            << std::setprecision(2) << std::setw(7)
+            << (function.instructions ? static_cast<double>(function.cycles) / static_cast<double>(function.instructions) : 0.0)
+            << std::setw(11) << function.cacheMisses << std::setprecision(1) << std::setw(7)
+            << percent(function.cacheMisses, function.cacheAccesses) << "%" << std::endl;
+    }
+    if (sorted.size() > topFunctions) {
+        out << "  ... " << sorted.size() - topFunctions << " more functions" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SocDescription.h"
+
+class SymbolIndex;
+
+
+// Optional cycle model that predicts what firmware would take on the chip
+// rather than the emulator's one cycle per instruction. The CPU reports
+// every retired instruction and data access; the model charges stalls for
+// flash-cache misses (IROM/DROM go through a set-associative cache),
+// IRAM data accesses, MMIO wait states and taken branches, and keeps the
+// totals per function. With no model attached none of this runs.
+class TimingModel {
+public:
+    // Stall cycles on top of the one cycle every instruction costs
+    struct Costs {
+        uint32_t cacheSize;          // Flash cache, bytes
+        uint32_t cacheWays;
+        uint32_t cacheLineSize;
+        uint32_t cacheMissPenalty;   // Line fill from SPI flash
+        uint32_t iramDataAccess;     // Loads and stores to IRAM
+        uint32_t mmioRead;           // Peripheral bus wait states
+        uint32_t mmioWrite;
+        uint32_t takenBranch;        // Pipeline refill; zero-overhead loops are free
+
+        // ESP32 at 240MHz: 32KB two-way cache with 32-byte lines filled
+        // from 80MHz quad SPI flash, APB peripherals at 80MHz
+        static Costs esp32();
+    };
+
+    struct FunctionStats {
+        std::string name;
+        uint64_t instructions;
+        uint64_t cycles;
+        uint64_t cacheAccesses;
+        uint64_t cacheMisses;
+    };
+
+private:
+    enum class AccessClass : uint8_t { Other, Flash, Iram, Dram, Mmio };
+
+    Costs costs;
+    // One class per 4KB page of the address space
+    std::vector<AccessClass> pages;
+
+    // Cache tags, way-major within each set, with a last-use stamp per way for LRU
+    uint32_t setMask;
+    uint32_t lineShift;
+    std::vector<uint32_t> tags;
+    std::vector<uint64_t> lastUse;
+    uint64_t useClock;
+
+    // Costs of the instruction in flight, folded into its function on retire
+    uint32_t instructionStall;
+    uint32_t instructionAccesses;
+    uint32_t instructionMisses;
+    // Stall cycles the emulator hasn't added to its cycle count yet
+    uint64_t pendingStall;
+
+    const SymbolIndex* symbols;
+    std::unordered_map<uint32_t, FunctionStats> functions;
+    FunctionStats* currentFunction;
+    uint32_t currentStart;
+    uint32_t currentEnd;
+
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t cacheAccesses;
+    uint64_t cacheMisses;
+    uint64_t branchStalls;
+    uint64_t memoryStalls;
+    uint64_t mmioStalls;
+
+    AccessClass classify(uint32_t address) const {
+        return pages[address >> SocDescription::TIMING_PAGE_SHIFT];
+    }
+    // Looks the line up, fills it on a miss; returns the stall
+    uint32_t cacheAccess(uint32_t address);
+    FunctionStats& functionAt(uint32_t address);
+
+public:
+    explicit TimingModel(const SocDescription& soc, const Costs& costs = Costs::esp32());
+
+    // Per-function totals need symbols; without them only the totals are kept
+    void setSymbols(const SymbolIndex* index);
+
+    void load(uint32_t address) { dataAccess(address, false); }
+    void store(uint32_t address) { dataAccess(address, true); }
+    void dataAccess(uint32_t address, bool write);
+
+    // An instruction of length bytes at address finished and the PC is now next
+    void retire(uint32_t address, uint32_t length, uint32_t next);
+
+    uint64_t takeStall() {
+        uint64_t stall = pendingStall;
+        pendingStall = 0;
+        return stall;
+    }
+
+    uint64_t getInstructions() const { return instructions; }
+    uint64_t getCycles() const { return cycles; }
+    uint64_t getCacheAccesses() const { return cacheAccesses; }
+    uint64_t getCacheMisses() const { return cacheMisses; }
+
+    // Empties the cache, as after a reset
+    void flushCache();
+
+    // Totals, then the top functions by predicted cycles
+    void writeReport(std::ostream& out, size_t topFunctions = 20) const;
+};
@@ -0,0 +1,145 @@
+#include "VcdTrace.h"
+#include <charconv>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+constexpr uint64_t PICOSECONDS_PER_SECOND = 1000000000000ULL;
+
+char signalId(unsigned index) {
+    return static_cast<char>('!' + index);
+}
+
+}
+
+VcdTrace::VcdTrace(const std::string& tracePath, const std::string& scope, const std::string& prefix,
+                   unsigned signals, uint64_t clock, uint32_t initialLevels)
+    : path(tracePath), signalCount(signals), clockHz(clock), currentLevels(initialLevels),
+      lastTime(0), failed(false), recorded(0), stalls(0), stopping(false) {
+    if (signalCount == 0 || signalCount > 32 || clockHz == 0) {
+        throw std::invalid_argument("VCD trace needs 1-32 signals and a non-zero clock");
+    }
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not create VCD file: " + path);
+    }
+
+    buffer.reserve(FLUSH_THRESHOLD * 2);
+    buffer += "$version vesp $end\n";
+    buffer += "$timescale 1ps $end\n";
+    buffer += "$scope module " + scope + " $end\n";
+    for (unsigned i = 0; i < signalCount; i++) {
+        buffer += "$var wire 1 ";
+        buffer += signalId(i);
+        buffer += " " + prefix + std::to_string(i) + " $end\n";
+    }
+    buffer += "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n";
+    for (unsigned i = 0; i < signalCount; i++) {
+        buffer += (initialLevels >> i) & 1 ? '1' : '0';
+        buffer += signalId(i);
+        buffer += '\n';
+    }
+    buffer += "$end\n";
+    flushBuffer();
+
+    writer = std::thread([this]() { writerLoop(); });
+}
+
+VcdTrace::~VcdTrace() {
+    if (writer.joinable()) {
+        try {
+            close(0);
+        } catch (const std::exception&) {
+        }
+    }
+}
+
+void VcdTrace::waitForSpace(const Change& change) {
+    stalls++;
+    while (!changes.push(change)) {
+        std::this_thread::yield();
+    }
+}
+
+void VcdTrace::writerLoop() {
+    while (!stopping.load(std::memory_order_acquire)) {
+        Change change;
+        bool any = false;
+        while (changes.pop(change)) {
+            writeChange(change);
+            any = true;
+        }
+        if (any) {
+            flushBuffer();
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void VcdTrace::writeChange(const Change& change) {
+    // Worst case: a timestamp plus a line for every signal
+    char line[24 + 3 * 32];
+    char* out = line;
+
+    uint64_t time = static_cast<uint64_t>(static_cast<unsigned __int128>(change.cycle) * PICOSECONDS_PER_SECOND / clockHz);
+    // Restoring a snapshot rewinds the cycle counter; VCD time can't go back
+    if (time < lastTime) {
+        time = lastTime;
+    }
+    if (time != lastTime) {
+        *out++ = '#';
+        out = std::to_chars(out, line + sizeof(line), time).ptr;
+        *out++ = '\n';
+        lastTime = time;
+    }
+
+    uint32_t mask = change.mask;
+    while (mask) {
+        unsigned pin = __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (pin >= signalCount) continue;
+        *out++ = static_cast<char>('0' + ((change.levels >> pin) & 1));
+        *out++ = signalId(pin);
+        *out++ = '\n';
+    }
+    currentLevels = change.levels;
+
+    buffer.append(line, out);
+    if (buffer.size() >= FLUSH_THRESHOLD) {
+        flushBuffer();
+    }
+}
+
+void VcdTrace::flushBuffer() {
+    // After a write error the ring still gets drained, so record() never
+    // blocks on a dead writer; close() reports the failure
+    if (!failed && !buffer.empty()) {
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        failed = !file;
+    }
+    buffer.clear();
+}
+
+void VcdTrace::close(uint64_t endCycle) {
+    if (!writer.joinable()) return;
+
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+
+    Change change;
+    while (changes.pop(change)) {
+        writeChange(change);
+    }
+    // A final timestamp so viewers show the last level for its full length
+    writeChange({endCycle, 0, currentLevels});
+    flushBuffer();
+    file.close();
+
+    if (failed || file.fail()) {
+        throw std::runtime_error("Failed writing VCD file: " + path);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "SpscQueue.h"
+
+
+// Logic-analyzer capture of up to 32 one-bit signals into a Value Change
+// Dump file. The emulator thread only pushes (cycle, changed mask, levels)
+// into a preallocated ring; a writer thread turns those into VCD text. If
+// the writer falls a whole ring behind, record() waits for it rather than
+// dropping edges, so the waveform is always complete.
+class VcdTrace {
+public:
+    struct Change {
+        uint64_t cycle;
+        uint32_t mask;      // Signals that changed
+        uint32_t levels;    // All signal levels after the change
+    };
+
+    static constexpr size_t RING_SIZE = 1 << 16;
+
+private:
+    SpscQueue<Change, RING_SIZE> changes;
+
+    std::string path;
+    std::ofstream file;
+    std::string buffer;
+    unsigned signalCount;
+    uint64_t clockHz;
+    uint32_t currentLevels;
+    uint64_t lastTime;
+    bool failed;
+
+    uint64_t recorded;
+    uint64_t stalls;
+    std::atomic<bool> stopping;
+    std::thread writer;
+
+    void writerLoop();
+    void writeChange(const Change& change);
+    void flushBuffer();
+    void waitForSpace(const Change& change);
+
+public:
+    // Writes the header and the initial levels. Signals are named
+    // prefix0..prefixN-1 inside a scope of the given name; timestamps are
+    // in picoseconds at clockHz.
+    VcdTrace(const std::string& path, const std::string& scope, const std::string& prefix,
+             unsigned signalCount, uint64_t clockHz, uint32_t initialLevels);
+    ~VcdTrace();
+
+    VcdTrace(const VcdTrace&) = delete;
+    VcdTrace& operator=(const VcdTrace&) = delete;
+
+    // Emulator thread only
+    void record(uint64_t cycle, uint32_t mask, uint32_t levels) {
+        Change change{cycle, mask, levels};
+        if (!changes.push(change)) {
+            waitForSpace(change);
+        }
+        recorded++;
+    }
+
+    // Drains the ring, writes the end time and closes the file. Throws if
+    // the file could not be written. Called by the destructor if needed.
+    void close(uint64_t endCycle);
+
+    const std::string& getPath() const { return path; }
+    uint64_t getRecorded() const { return recorded; }
+    // How often record() had to wait for the writer
+    uint64_t getStalls() const { return stalls; }
+};
@@ -0,0 +1,116 @@
+#include "VirtualNetwork.h"
+#include <cstring>
+#include <stdexcept>
+
+bool VirtualNetwork::Port::send(uint16_t destination, const uint8_t* data, size_t length) {
+    if (length > MAX_PAYLOAD) {
+        throw std::invalid_argument("Packet exceeds the network payload size");
+    }
+
+    Packet packet;
+    packet.source = id;
+    packet.destination = destination;
+    packet.length = static_cast<uint16_t>(length);
+    packet.deliverAt = (clock ? *clock : 0) + latency;
+    std::memcpy(packet.data, data, length);
+
+    if (!outbox.push(packet)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (doorbell) {
+        doorbell->fetch_add(1, std::memory_order_release);
+        doorbell->notify_one();
+    }
+    return true;
+}
+
+const VirtualNetwork::Packet* VirtualNetwork::Port::peek() const {
+    const Packet* packet = inbox.front();
+    if (packet && clock && packet->deliverAt > *clock) {
+        return nullptr;
+    }
+    return packet;
+}
+
+VirtualNetwork::VirtualNetwork(uint64_t latency)
+    : latencyCycles(latency), routing(false), doorbell(0), routed(0), dropped(0) {
+}
+
+VirtualNetwork::~VirtualNetwork() {
+    stop();
+}
+
+VirtualNetwork::Port* VirtualNetwork::createPort() {
+    if (routing.load()) {
+        throw std::runtime_error("Cannot add network ports while the router is running");
+    }
+    if (ports.size() >= BROADCAST) {
+        throw std::runtime_error("Virtual network is full");
+    }
+    ports.push_back(std::make_unique<Port>(static_cast<uint16_t>(ports.size()), latencyCycles));
+    ports.back()->doorbell = &doorbell;
+    return ports.back().get();
+}
+
+VirtualNetwork::Port* VirtualNetwork::getPort(uint16_t id) const {
+    return id < ports.size() ? ports[id].get() : nullptr;
+}
+
+void VirtualNetwork::deliver(const Packet& packet, Port& target) {
+    if (target.inbox.push(packet)) {
+        routed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        target.dropped.fetch_add(1, std::memory_order_relaxed);
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t VirtualNetwork::pump() {
+    size_t moved = 0;
+
+    for (auto& port : ports) {
+        while (const Packet* packet = port->outbox.front()) {
+            if (packet->destination == BROADCAST) {
+                for (auto& target : ports) {
+                    if (target.get() != port.get()) {
+                        deliver(*packet, *target);
+                    }
+                }
+            } else if (packet->destination < ports.size()) {
+                deliver(*packet, *ports[packet->destination]);
+            } else {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            port->outbox.popFront();
+            moved++;
+        }
+    }
+    return moved;
+}
+
+void VirtualNetwork::start() {
+    if (routing.exchange(true)) {
+        return;
+    }
+    router = std::thread([this]() {
+        while (routing.load(std::memory_order_relaxed)) {
+            // Read before pumping, so a send that pump() misses still
+            // changes the value and the wait returns straight away
+            uint32_t rung = doorbell.load(std::memory_order_acquire);
+            if (pump() == 0) {
+                doorbell.wait(rung, std::memory_order_acquire);
+            }
+        }
+        pump();
+    });
+}
+
+void VirtualNetwork::stop() {
+    if (!routing.exchange(false)) {
+        return;
+    }
+    doorbell.fetch_add(1, std::memory_order_release);
+    doorbell.notify_one();
+    router.join();
+}
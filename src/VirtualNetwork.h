@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+
+
+// In-process packet switch connecting the WiFi peripherals of many Emulator
+// instances (and host-side endpoints). Every node owns a pair of SPSC
+// queues, so node threads never contend; a single router moves packets from
+// outboxes to inboxes. Packets carry a delivery time in cycles and a
+// receiving node only sees them once its own clock has caught up.
+class VirtualNetwork {
+public:
+    static constexpr size_t MAX_PAYLOAD = 1500;
+    static constexpr size_t QUEUE_DEPTH = 64;
+    static constexpr uint16_t BROADCAST = 0xFFFF;
+
+    struct Packet {
+        uint16_t source;
+        uint16_t destination;
+        uint16_t length;
+        uint64_t deliverAt;
+        uint8_t data[MAX_PAYLOAD];
+    };
+
+    class Port {
+    private:
+        friend class VirtualNetwork;
+
+        uint16_t id;
+        const uint64_t* clock;  // Owner's virtual time, nullptr = always deliver
+        uint64_t latency;
+        SpscQueue<Packet, QUEUE_DEPTH> outbox;
+        SpscQueue<Packet, QUEUE_DEPTH> inbox;
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint32_t>* doorbell = nullptr;  // The network's, rung on every send
+
+    public:
+        Port(uint16_t nodeId, uint64_t latencyCycles) : id(nodeId), clock(nullptr), latency(latencyCycles) {}
+
+        uint16_t getId() const { return id; }
+        void setClock(const uint64_t* cycles) { clock = cycles; }
+
+        // Producer side, called from the owning node's thread
+        bool send(uint16_t destination, const uint8_t* data, size_t length);
+
+        // Consumer side: the next packet whose delivery time has passed
+        const Packet* peek() const;
+        void consume() { inbox.popFront(); }
+        // Drops everything received so far, due or not
+        void drain() {
+            while (inbox.front()) inbox.popFront();
+        }
+
+        uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+    };
+
+private:
+    std::vector<std::unique_ptr<Port>> ports;
+    uint64_t latencyCycles;
+
+    std::atomic<bool> routing;
+    std::thread router;
+    // Bumped by every send; the router sleeps on it while nothing is queued
+    std::atomic<uint32_t> doorbell;
+    std::atomic<uint64_t> routed;
+    std::atomic<uint64_t> dropped;
+
+    void deliver(const Packet& packet, Port& target);
+
+public:
+    explicit VirtualNetwork(uint64_t latency = 2400);  // 10us at 240 MHz
+    ~VirtualNetwork();
+
+    VirtualNetwork(const VirtualNetwork&) = delete;
+    VirtualNetwork& operator=(const VirtualNetwork&) = delete;
+
+    // All ports must be created before the router starts
+    Port* createPort();
+    Port* getPort(uint16_t id) const;
+    size_t getPortCount() const { return ports.size(); }
+
+    // Moves every queued outbound packet; returns how many were routed.
+    // Call from a single thread, or use start()/stop() for a router thread.
+    size_t pump();
+    void start();
+    void stop();
+
+    uint64_t getRouted() const { return routed.load(std::memory_order_relaxed); }
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+};
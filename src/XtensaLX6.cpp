@@ -1,32 +1,403 @@
 #include "XtensaLX6.h"
+#include "TimingModel.h"
+#include "SymbolIndex.h"
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <cstring>
 
-XtensaLX6::XtensaLX6(Memory* mem) : memory(mem), pc(0) {
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define VESP_SSE_FPU 1
+#else
+#include <cfenv>
+#endif
+
+namespace {
+
+constexpr uint32_t FSR_INEXACT = 1u << 7;
+constexpr uint32_t FSR_UNDERFLOW = 1u << 8;
+constexpr uint32_t FSR_OVERFLOW = 1u << 9;
+constexpr uint32_t FSR_DIVZERO = 1u << 10;
+constexpr uint32_t FSR_INVALID = 1u << 11;
+constexpr uint32_t FSR_FLAGS = 0x1F << 7;
+constexpr uint32_t FCR_WRITABLE = FSR_FLAGS | 0x3;
+
+// Special register numbers, as in the Xtensa ISA
+constexpr uint8_t SR_LBEG = 0;
+constexpr uint8_t SR_LEND = 1;
+constexpr uint8_t SR_LCOUNT = 2;
+constexpr uint8_t SR_BR = 4;
+constexpr uint8_t SR_ACCLO = 16;
+constexpr uint8_t SR_ACCHI = 17;
+constexpr uint8_t SR_M0 = 32;
+
+constexpr uint64_t ACC_MASK = (1ULL << 40) - 1;
+
+// Per opcode nibble: instruction size, and whether it ends a decoded block
+// (control flow, WAITI, loop setup, and anything undefined)
+constexpr uint8_t INSTRUCTION_LENGTH[16] = {2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 2, 2, 2, 2};
+constexpr bool ENDS_BLOCK[16] = {false, false, false, true, false, false, false, true,
+                                 true, false, true, false, true, true, true, true};
+
+float asFloat(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t asBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Runs host float arithmetic under the guest's FCR rounding mode and folds
+// the exceptions it raised into FSR. The host MXCSR is restored afterwards.
+class GuestRounding {
+private:
+    uint32_t& fsr;
+#ifdef VESP_SSE_FPU
+    // FCR.RM order is nearest, toward zero, +inf, -inf
+    static constexpr uint32_t MXCSR_ROUNDING[4] = {0x0000, 0x6000, 0x4000, 0x2000};
+    static constexpr uint32_t MXCSR_ALL_MASKED = 0x1F80;
+    uint32_t saved;
+#else
+    static constexpr int FE_ROUNDING[4] = {FE_TONEAREST, FE_TOWARDZERO, FE_UPWARD, FE_DOWNWARD};
+    int saved;
+#endif
+
+public:
+    GuestRounding(uint32_t fcr, uint32_t& status) : fsr(status) {
+#ifdef VESP_SSE_FPU
+        saved = _mm_getcsr();
+        _mm_setcsr(MXCSR_ALL_MASKED | MXCSR_ROUNDING[fcr & 3]);
+#else
+        saved = std::fegetround();
+        std::feclearexcept(FE_ALL_EXCEPT);
+        std::fesetround(FE_ROUNDING[fcr & 3]);
+#endif
+    }
+    
+    ~GuestRounding() {
+#ifdef VESP_SSE_FPU
+        uint32_t raised = _mm_getcsr();
+        _mm_setcsr(saved);
+        if (raised & 0x01) fsr |= FSR_INVALID;
+        if (raised & 0x04) fsr |= FSR_DIVZERO;
+        if (raised & 0x08) fsr |= FSR_OVERFLOW;
+        if (raised & 0x10) fsr |= FSR_UNDERFLOW;
+        if (raised & 0x20) fsr |= FSR_INEXACT;
+#else
+        int raised = std::fetestexcept(FE_ALL_EXCEPT);
+        std::fesetround(saved);
+        if (raised & FE_INVALID) fsr |= FSR_INVALID;
+        if (raised & FE_DIVBYZERO) fsr |= FSR_DIVZERO;
+        if (raised & FE_OVERFLOW) fsr |= FSR_OVERFLOW;
+        if (raised & FE_UNDERFLOW) fsr |= FSR_UNDERFLOW;
+        if (raised & FE_INEXACT) fsr |= FSR_INEXACT;
+#endif
+    }
+};
+
+// Scalar ops as SSE intrinsics so the compiler can't constant-fold or move
+// them outside the GuestRounding scope
+#ifdef VESP_SSE_FPU
+float hostAdd(float a, float b) { return _mm_cvtss_f32(_mm_add_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+float hostSub(float a, float b) { return _mm_cvtss_f32(_mm_sub_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+float hostMul(float a, float b) { return _mm_cvtss_f32(_mm_mul_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+float hostDiv(float a, float b) { return _mm_cvtss_f32(_mm_div_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+float hostFromInt(int64_t value) { return _mm_cvtss_f32(_mm_cvtsi64_ss(_mm_setzero_ps(), value)); }
+#else
+float hostAdd(volatile float a, volatile float b) { return a + b; }
+float hostSub(volatile float a, volatile float b) { return a - b; }
+float hostMul(volatile float a, volatile float b) { return a * b; }
+float hostDiv(volatile float a, volatile float b) { return a / b; }
+float hostFromInt(volatile int64_t value) { return static_cast<float>(value); }
+#endif
+
+enum class Rounding { Truncate, Nearest, Floor, Ceil };
+
+// TRUNC.S/ROUND.S/FLOOR.S/CEIL.S/UTRUNC.S: value * 2^scale to an integer,
+// saturating (and flagging invalid) on NaN or overflow
+uint32_t toInteger(float value, unsigned scale, Rounding mode, bool isUnsigned, uint32_t& fsr) {
+    double scaled = std::ldexp(static_cast<double>(value), static_cast<int>(scale));
+    double rounded;
+    switch (mode) {
+        case Rounding::Truncate: rounded = std::trunc(scaled); break;
+        case Rounding::Floor: rounded = std::floor(scaled); break;
+        case Rounding::Ceil: rounded = std::ceil(scaled); break;
+        default: rounded = std::nearbyint(scaled); break;
+    }
+    
+    const double low = isUnsigned ? 0.0 : -2147483648.0;
+    const double high = isUnsigned ? 4294967295.0 : 2147483647.0;
+    if (std::isnan(rounded) || rounded > high) {
+        fsr |= FSR_INVALID;
+        return isUnsigned ? 0xFFFFFFFF : 0x7FFFFFFF;
+    }
+    if (rounded < low) {
+        fsr |= FSR_INVALID;
+        return isUnsigned ? 0 : 0x80000000;
+    }
+    if (rounded != scaled) {
+        fsr |= FSR_INEXACT;
+    }
+    return isUnsigned ? static_cast<uint32_t>(rounded) : static_cast<uint32_t>(static_cast<int32_t>(rounded));
+}
+
+}
+
+XtensaLX6::XtensaLX6(Memory* mem, bool quiet) : memory(mem), pc(0), waiting(false), fcr(0), fsr(0), booleans(0),
+                                    lbeg(0), lend(0), lcount(0), acc(0), macRegisters{},
+                                    blockCache(BLOCK_CACHE_SIZE), cacheEpoch(1), currentBlock(nullptr),
+                                    blockIndex(0), blockPc(0), retired(0), fault{FaultKind::None, 0, 0}, pageGenerations(mem->getPageGenerations()),
+                                    edgeMap(nullptr), edgeMapMask(0), prevLocation(0), coverage(nullptr), symbols(nullptr),
+                                    timing(nullptr) {
     for (int i = 0; i < 16; i++) {
         registers[i] = 0;
+        floatRegisters[i] = 0;
     }
     
-    std::cout << "Xtensa LX6 CPU initialized" << std::endl;
+    // A store into the block being executed must take effect from the
+    // next instruction, not the next block
+    memory->setCodeWriteCallback([this] { currentBlock = nullptr; });
+    
+    if (!quiet) std::cout << "Xtensa LX6 CPU initialized" << std::endl;
+}
+
+inline void XtensaLX6::executeInstruction() {
+    if (!currentBlock || pc != blockPc) {
+        currentBlock = lookupBlock(pc);
+        blockIndex = 0;
+        if (!currentBlock) {
+            // Code outside RAM is fetched every time (and can't end a loop)
+            if (coverage) {
+                coverage->mark(pc);
+            }
+            decodeAndExecute(fetchInstruction());
+            retired++;
+            return;
+        }
+        // Coverage is marked a block at a time on entry, so an instruction
+        // after a fault in the same block counts as run too
+        if (coverage) {
+            coverage->markEach(currentBlock->start, currentBlock->starts);
+        }
+    }
+    
+    const DecodedBlock* block = currentBlock;
+    decodeAndExecute(block->words[blockIndex]);
+    blockIndex++;
+    blockPc = pc;
+    retired++;
+    
+    if (blockIndex == block->count) {
+        currentBlock = nullptr;
+        // Falling through to LEND loops back. Blocks are cut at LEND, so it
+        // can only be reached at the end of one.
+        if (pc == block->end && pc == lend && lcount != 0) {
+            lcount--;
+            pc = lbeg;
+            recordEdge(pc);
+        }
+    }
 }
 
 void XtensaLX6::execute() {
-    uint32_t instruction = fetchInstruction();
+    if (waiting) {
+        return;
+    }
+    if (timing) {
+        executeTimed();
+    } else {
+        executeInstruction();
+    }
     
-    decodeAndExecute(instruction);
+    // Helpers that fault mid-instruction can't stop the PC advancing
+    if (fault.kind != FaultKind::None) {
+        pc = fault.pc;
+        currentBlock = nullptr;
+    }
+}
+
+const char* XtensaLX6::describe(FaultKind kind) {
+    switch (kind) {
+        case FaultKind::None: return "No fault";
+        case FaultKind::IllegalInstruction: return "Illegal instruction";
+        case FaultKind::UnknownSpecialRegister: return "Unknown special register";
+        case FaultKind::UnalignedLoad: return "Unaligned 32-bit load";
+        case FaultKind::UnalignedStore: return "Unaligned 32-bit store";
+    }
+    return "Unknown fault";
+}
+
+void XtensaLX6::executeTimed() {
+    uint32_t address = pc;
+    const uint8_t* opcode = memory->ramSpan(address, 1);
+    uint32_t length = opcode ? INSTRUCTION_LENGTH[*opcode & 0x0F] : 2;
+    
+    executeInstruction();
     
+    // Falling off LEND back to LBEG is free on the real core, not a branch
+    uint32_t next = pc;
+    if (next == lbeg && address + length == lend) {
+        next = lend;
+    }
+    timing->retire(address, length, next);
+}
+
+inline const XtensaLX6::DecodedBlock* XtensaLX6::lookupBlock(uint32_t address) {
+    DecodedBlock& block = blockCache[(address >> 1) & (BLOCK_CACHE_SIZE - 1)];
+    if (block.epoch == cacheEpoch && block.start == address &&
+        pageGenerations[block.pages[0]] == block.generations[0] &&
+        pageGenerations[block.pages[1]] == block.generations[1]) {
+        return &block;
+    }
+    return decodeBlock(block, address);
+}
+
+const XtensaLX6::DecodedBlock* XtensaLX6::decodeBlock(DecodedBlock& block, uint32_t address) {
+    uint8_t count = 0;
+    uint64_t starts = 0;
+    uint32_t next = address;
+    const uint8_t* first = nullptr;
+    while (count < MAX_BLOCK_INSTRUCTIONS) {
+        const uint8_t* bytes = memory->ramSpan(next, 4);
+        if (!bytes) break;
+        // Stay in contiguous backing store, so the block spans at most two pages
+        if (!first) {
+            first = bytes;
+        } else if (bytes != first + (next - address)) {
+            break;
+        }
+        
+        uint32_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        block.words[count++] = word;
+        starts |= 1ULL << (next - address);
+        
+        uint8_t opcode = word & 0x0F;
+        next += INSTRUCTION_LENGTH[opcode];
+        if (ENDS_BLOCK[opcode] || next == lend) break;
+    }
+    if (count == 0) {
+        return nullptr;
+    }
+    
+    block.start = address;
+    block.end = next;
+    block.epoch = cacheEpoch;
+    block.pages[0] = static_cast<uint32_t>(memory->ramPage(address));
+    block.pages[1] = static_cast<uint32_t>(memory->ramPage(next - 1));
+    block.generations[0] = memory->watchCodePage(block.pages[0]);
+    block.generations[1] = memory->watchCodePage(block.pages[1]);
+    block.count = count;
+    block.starts = starts;
+    return &block;
+}
+
+void XtensaLX6::invalidateCodeCache() {
+    cacheEpoch++;
+    currentBlock = nullptr;
+}
+
+// A block that runs across a new LEND should have been cut there. Only
+// blocks starting less than a block's length before it can, so probing
+// those slots is enough; blocks cut at the old LEND are just short.
+void XtensaLX6::invalidateBlocksAcross(uint32_t address) {
+    for (uint32_t start = address - MAX_BLOCK_BYTES; start != address; start++) {
+        DecodedBlock& block = blockCache[(start >> 1) & (BLOCK_CACHE_SIZE - 1)];
+        if (block.start == start && block.end > address) {
+            block.epoch = cacheEpoch - 1;
+        }
+    }
+    currentBlock = nullptr;
 }
 
 void XtensaLX6::reset() {
     pc = 0;
+    waiting = false;
+    fcr = 0;
+    fsr = 0;
+    booleans = 0;
+    lbeg = 0;
+    lend = 0;
+    lcount = 0;
+    acc = 0;
     for (int i = 0; i < 16; i++) {
         registers[i] = 0;
+        floatRegisters[i] = 0;
     }
+    std::fill(std::begin(macRegisters), std::end(macRegisters), 0);
+    clearFault();
+    invalidateCodeCache();
+}
+
+XtensaLX6::State XtensaLX6::getState() const {
+    State state;
+    std::copy(std::begin(registers), std::end(registers), state.registers);
+    state.pc = pc;
+    state.waiting = waiting;
+    std::copy(std::begin(floatRegisters), std::end(floatRegisters), state.floatRegisters);
+    state.fcr = fcr;
+    state.fsr = fsr;
+    state.booleans = booleans;
+    state.lbeg = lbeg;
+    state.lend = lend;
+    state.lcount = lcount;
+    state.acc = acc;
+    std::copy(std::begin(macRegisters), std::end(macRegisters), state.macRegisters);
+    return state;
+}
+
+void XtensaLX6::setState(const State& state) {
+    std::copy(std::begin(state.registers), std::end(state.registers), registers);
+    pc = state.pc;
+    waiting = state.waiting;
+    std::copy(std::begin(state.floatRegisters), std::end(state.floatRegisters), floatRegisters);
+    fcr = state.fcr;
+    fsr = state.fsr;
+    booleans = state.booleans;
+    lbeg = state.lbeg;
+    lcount = state.lcount;
+    acc = state.acc;
+    std::copy(std::begin(state.macRegisters), std::end(state.macRegisters), macRegisters);
+    clearFault();
+    
+    // Restored RAM bumps its code pages' generations, so decoded blocks
+    // only depend on LEND here
+    if (state.lend != lend) {
+        invalidateBlocksAcross(state.lend);
+    }
+    lend = state.lend;
+    currentBlock = nullptr;
+}
+
+void XtensaLX6::setEdgeCoverageMap(uint8_t* map, size_t size) {
+    if (map && (size == 0 || (size & (size - 1)) != 0)) {
+        throw std::invalid_argument("Coverage map size must be a power of two");
+    }
+    
+    edgeMap = map;
+    edgeMapMask = map ? static_cast<uint32_t>(size - 1) : 0;
+    prevLocation = 0;
 }
 
 uint32_t XtensaLX6::fetchInstruction() {
-    return memory->read32(pc);
+    if ((pc & 3) == 0) {
+        return memory->read32(pc);
+    }
+    
+    // Narrow instructions leave the PC 2-byte aligned, so assemble the word bytewise
+    uint32_t instruction = 0;
+    for (uint32_t i = 0; i < 4 && memory->isValidAddress(pc + i); i++) {
+        instruction |= static_cast<uint32_t>(memory->read8(pc + i)) << (i * 8);
+    }
+    return instruction;
 }
 
 void XtensaLX6::decodeAndExecute(uint32_t instruction) {
@@ -57,8 +428,21 @@ void XtensaLX6::decodeAndExecute(uint32_t instruction) {
         case 0x7: // BEQ.N
             executeBEQN(instruction);
             break;
+        case 0x8: // WAITI
+            executeWAITI(instruction);
+            break;
+        case 0x9: // FPU group
+            executeFPU(instruction);
+            break;
+        case 0xA: // LOOP group
+            executeLoop(instruction);
+            break;
+        case 0xB: // MAC16
+            executeMAC16(instruction);
+            break;
         default:
-            throw std::runtime_error("Unknown instruction opcode: " + std::to_string(opcode));
+            raiseFault(FaultKind::IllegalInstruction, instruction);
+            break;
     }
 }
 
@@ -103,6 +487,7 @@ void XtensaLX6::executeJMP(uint32_t instruction) {
     uint8_t ar = (instruction >> 8) & 0x0F;
     
     pc = registers[ar];
+    recordEdge(pc);
 }
 
 void XtensaLX6::executeNOP(uint32_t instruction) {
@@ -139,6 +524,273 @@ void XtensaLX6::executeBEQN(uint32_t instruction) {
     }
     
     pc += 2; 
+    recordEdge(pc);
+}
+
+void XtensaLX6::executeWAITI(uint32_t instruction) {
+    (void)instruction;
+    
+    waiting = true;
+    pc += 2;
+}
+
+// FPU instructions are 3 bytes: t [7:4], r [11:8], s [15:12], op [19:16],
+// sub-op or immediate [23:20]. Operand order follows the Xtensa mnemonics.
+void XtensaLX6::executeFPU(uint32_t instruction) {
+    uint8_t t = (instruction >> 4) & 0x0F;
+    uint8_t r = (instruction >> 8) & 0x0F;
+    uint8_t s = (instruction >> 12) & 0x0F;
+    uint8_t op = (instruction >> 16) & 0x0F;
+    uint8_t sub = (instruction >> 20) & 0x0F;
+    
+    float fs = asFloat(floatRegisters[s]);
+    float ft = asFloat(floatRegisters[t]);
+    float fr = asFloat(floatRegisters[r]);
+    
+    switch (op) {
+        case 0x0: { GuestRounding scope(fcr, fsr); floatRegisters[r] = asBits(hostAdd(fs, ft)); break; }  // ADD.S
+        case 0x1: { GuestRounding scope(fcr, fsr); floatRegisters[r] = asBits(hostSub(fs, ft)); break; }  // SUB.S
+        case 0x2: { GuestRounding scope(fcr, fsr); floatRegisters[r] = asBits(hostMul(fs, ft)); break; }  // MUL.S
+        case 0x3: { GuestRounding scope(fcr, fsr); floatRegisters[r] = asBits(std::fma(fs, ft, fr)); break; }   // MADD.S
+        case 0x4: { GuestRounding scope(fcr, fsr); floatRegisters[r] = asBits(std::fma(-fs, ft, fr)); break; }  // MSUB.S
+        case 0x5: {
+            // DIV0.S seeds the Newton-Raphson divide sequence; an exact
+            // reciprocal is a valid (perfect) seed
+            GuestRounding scope(fcr, fsr);
+            floatRegisters[r] = asBits(hostDiv(1.0f, fs));
+            break;
+        }
+        case 0x6: {
+            // Conversions, immediate scale in t
+            switch (sub) {
+                case 0x0: {  // FLOAT.S fr, as, imm
+                    GuestRounding scope(fcr, fsr);
+                    floatRegisters[r] = asBits(std::ldexp(hostFromInt(static_cast<int32_t>(registers[s])), -t));
+                    break;
+                }
+                case 0x1: {  // UFLOAT.S fr, as, imm
+                    GuestRounding scope(fcr, fsr);
+                    floatRegisters[r] = asBits(std::ldexp(hostFromInt(registers[s]), -t));
+                    break;
+                }
+                case 0x2: registers[r] = toInteger(fs, t, Rounding::Truncate, false, fsr); break;  // TRUNC.S
+                case 0x3: registers[r] = toInteger(fs, t, Rounding::Truncate, true, fsr); break;   // UTRUNC.S
+                case 0x4: registers[r] = toInteger(fs, t, Rounding::Nearest, false, fsr); break;   // ROUND.S
+                case 0x5: registers[r] = toInteger(fs, t, Rounding::Floor, false, fsr); break;     // FLOOR.S
+                case 0x6: registers[r] = toInteger(fs, t, Rounding::Ceil, false, fsr); break;      // CEIL.S
+                default:
+                    raiseFault(FaultKind::IllegalInstruction, instruction);
+                    return;
+            }
+            break;
+        }
+        case 0x7: {
+            // Compares set boolean register br
+            bool unordered = std::isunordered(fs, ft);
+            bool result;
+            switch (sub) {
+                case 0x0: result = unordered; break;                      // UN.S
+                case 0x1: result = !unordered && fs == ft; break;         // OEQ.S
+                case 0x2: result = unordered || fs == ft; break;          // UEQ.S
+                case 0x3: result = !unordered && fs < ft; break;          // OLT.S
+                case 0x4: result = unordered || fs < ft; break;           // ULT.S
+                case 0x5: result = !unordered && fs <= ft; break;         // OLE.S
+                case 0x6: result = unordered || fs <= ft; break;          // ULE.S
+                default:
+                    raiseFault(FaultKind::IllegalInstruction, instruction);
+                    return;
+            }
+            booleans = static_cast<uint16_t>((booleans & ~(1u << r)) | (result ? 1u << r : 0));
+            break;
+        }
+        case 0x8: {
+            switch (sub) {
+                case 0x0: floatRegisters[r] = floatRegisters[s]; break;                  // MOV.S
+                case 0x1: floatRegisters[r] = floatRegisters[s] & 0x7FFFFFFF; break;     // ABS.S
+                case 0x2: floatRegisters[r] = floatRegisters[s] ^ 0x80000000; break;     // NEG.S
+                case 0x3: registers[r] = floatRegisters[s]; break;                       // RFR
+                case 0x4: floatRegisters[r] = registers[s]; break;                       // WFR
+                default:
+                    raiseFault(FaultKind::IllegalInstruction, instruction);
+                    return;
+            }
+            break;
+        }
+        case 0x9:    // LSI ft, as, imm
+        case 0xA: {  // SSI ft, as, imm
+            uint32_t address = registers[s] + ((static_cast<uint32_t>(sub) << 4 | r) << 2);
+            if (op == 0x9) {
+                floatRegisters[t] = readMemory(address);
+            } else {
+                writeMemory(address, floatRegisters[t]);
+            }
+            break;
+        }
+        case 0xB: {  // RUR ar, FCR/FSR/BR
+            switch (t) {
+                case 0x0: registers[r] = fcr; break;
+                case 0x1: registers[r] = fsr; break;
+                case 0x2: registers[r] = booleans; break;
+                default:
+                    raiseFault(FaultKind::IllegalInstruction, instruction);
+                    return;
+            }
+            break;
+        }
+        case 0xC: {  // WUR FCR/FSR/BR, as
+            switch (t) {
+                case 0x0: fcr = registers[s] & FCR_WRITABLE; break;
+                case 0x1: fsr = registers[s] & FSR_FLAGS; break;
+                case 0x2: booleans = static_cast<uint16_t>(registers[s]); break;
+                default:
+                    raiseFault(FaultKind::IllegalInstruction, instruction);
+                    return;
+            }
+            break;
+        }
+        default:
+            raiseFault(FaultKind::IllegalInstruction, instruction);
+            return;
+    }
+    
+    pc += 3;
+}
+
+// LOOP/LOOPNEZ/LOOPGTZ and RSR/WSR, 3 bytes: sub-op [7:4], register [11:8],
+// loop offset or special register number [23:16]. As on Xtensa, LEND is
+// pc + 4 + offset and the body starts right after the LOOP.
+void XtensaLX6::executeLoop(uint32_t instruction) {
+    uint8_t sub = (instruction >> 4) & 0x0F;
+    uint8_t reg = (instruction >> 8) & 0x0F;
+    uint8_t imm8 = (instruction >> 16) & 0xFF;
+    
+    switch (sub) {
+        case 0x0:    // LOOP
+        case 0x1:    // LOOPNEZ
+        case 0x2: {  // LOOPGTZ
+            uint32_t count = registers[reg];
+            bool skip = (sub == 0x1 && count == 0) || (sub == 0x2 && static_cast<int32_t>(count) <= 0);
+            
+            lbeg = pc + 3;
+            lcount = count - 1;
+            writeSpecialRegister(SR_LEND, pc + 4 + imm8);
+            
+            pc = skip ? lend : pc + 3;
+            if (skip) {
+                recordEdge(pc);
+            }
+            return;
+        }
+        case 0x3:  // RSR
+            registers[reg] = readSpecialRegister(imm8);
+            break;
+        case 0x4:  // WSR
+            writeSpecialRegister(imm8, registers[reg]);
+            break;
+        default:
+            raiseFault(FaultKind::IllegalInstruction, instruction);
+            return;
+    }
+    
+    pc += 3;
+}
+
+// MAC16, 3 bytes: operation [7:4], high-half selects [9:8], operand kinds
+// [11:10] (AA, AD, DA, DD), first operand [15:12], second operand [19:16].
+// LDINC/LDDEC use [9:8] for the m register and [15:12] for the address.
+void XtensaLX6::executeMAC16(uint32_t instruction) {
+    uint8_t op = (instruction >> 4) & 0x0F;
+    uint8_t halves = (instruction >> 8) & 0x03;
+    uint8_t kinds = (instruction >> 10) & 0x03;
+    uint8_t first = (instruction >> 12) & 0x0F;
+    uint8_t second = (instruction >> 16) & 0x0F;
+    
+    switch (op) {
+        case 0x0:    // UMUL.AA
+        case 0x1:    // MUL
+        case 0x2:    // MULA
+        case 0x3: {  // MULS
+            uint32_t x = (kinds & 0x2) ? macRegisters[first & 3] : registers[first];
+            uint32_t y = (kinds & 0x1) ? macRegisters[second & 3] : registers[second];
+            uint16_t xh = static_cast<uint16_t>((halves & 0x1) ? x >> 16 : x);
+            uint16_t yh = static_cast<uint16_t>((halves & 0x2) ? y >> 16 : y);
+            
+            if (op == 0x0) {
+                acc = static_cast<uint64_t>(xh) * yh;
+            } else {
+                int64_t product = static_cast<int64_t>(static_cast<int16_t>(xh)) * static_cast<int16_t>(yh);
+                if (op == 0x1) acc = static_cast<uint64_t>(product);
+                else if (op == 0x2) acc += static_cast<uint64_t>(product);
+                else acc -= static_cast<uint64_t>(product);
+            }
+            acc &= ACC_MASK;
+            break;
+        }
+        case 0x4:    // LDINC
+        case 0x5: {  // LDDEC
+            uint32_t address = (op == 0x4) ? registers[first] + 4 : registers[first] - 4;
+            macRegisters[halves] = readMemory(address);
+            registers[first] = address;
+            break;
+        }
+        default:
+            raiseFault(FaultKind::IllegalInstruction, instruction);
+            return;
+    }
+    
+    pc += 3;
+}
+
+uint32_t XtensaLX6::readSpecialRegister(uint8_t number) const {
+    switch (number) {
+        case SR_LBEG: return lbeg;
+        case SR_LEND: return lend;
+        case SR_LCOUNT: return lcount;
+        case SR_BR: return booleans;
+        case SR_ACCLO: return static_cast<uint32_t>(acc);
+        case SR_ACCHI: return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(acc >> 32)));
+        case SR_M0: case SR_M0 + 1: case SR_M0 + 2: case SR_M0 + 3:
+            return macRegisters[number - SR_M0];
+        default:
+            raiseFault(FaultKind::UnknownSpecialRegister, number);
+            return 0;
+    }
+}
+
+void XtensaLX6::writeSpecialRegister(uint8_t number, uint32_t value) {
+    switch (number) {
+        case SR_LBEG: lbeg = value; break;
+        case SR_LEND:
+            if (value != lend) {
+                lend = value;
+                invalidateBlocksAcross(value);
+            }
+            break;
+        case SR_LCOUNT: lcount = value; break;
+        case SR_BR: booleans = static_cast<uint16_t>(value); break;
+        case SR_ACCLO: acc = (acc & ~0xFFFFFFFFull) | value; break;
+        case SR_ACCHI: acc = (acc & 0xFFFFFFFFull) | (static_cast<uint64_t>(value & 0xFF) << 32); break;
+        case SR_M0: case SR_M0 + 1: case SR_M0 + 2: case SR_M0 + 3:
+            macRegisters[number - SR_M0] = value;
+            break;
+        default:
+            raiseFault(FaultKind::UnknownSpecialRegister, number);
+            break;
+    }
+}
+
+uint32_t XtensaLX6::getFloatRegister(uint8_t reg) const {
+    if (reg >= 16) {
+        throw std::out_of_range("Float register index out of range: " + std::to_string(reg));
+    }
+    return floatRegisters[reg];
+}
+
+void XtensaLX6::setFloatRegister(uint8_t reg, uint32_t bits) {
+    if (reg >= 16) {
+        throw std::out_of_range("Float register index out of range: " + std::to_string(reg));
+    }
+    floatRegisters[reg] = bits;
 }
 
 uint32_t XtensaLX6::getRegister(uint8_t reg) const {
@@ -156,24 +808,24 @@ void XtensaLX6::setRegister(uint8_t reg, uint32_t value) {
 }
 
 uint32_t XtensaLX6::readMemory(uint32_t address) const {
-    if (address >= 0x3FF00000 && address < 0x3FF80000) {
-        if (peripheralReadCallback) {
-            return peripheralReadCallback(address);
-        }
+    if (address & 3) {
+        raiseFault(FaultKind::UnalignedLoad, address);
         return 0;
     }
-    
+    if (timing) {
+        timing->load(address);
+    }
     return memory->read32(address);
 }
 
 void XtensaLX6::writeMemory(uint32_t address, uint32_t value) {
-    if (address >= 0x3FF00000 && address < 0x3FF80000) {
-        if (peripheralWriteCallback) {
-            peripheralWriteCallback(address, value);
-        }
+    if (address & 3) {
+        raiseFault(FaultKind::UnalignedStore, address);
         return;
     }
-    
+    if (timing) {
+        timing->store(address);
+    }
     memory->write32(address, value);
 }
 
@@ -183,8 +835,16 @@ void XtensaLX6::dumpRegisters() const {
         std::cout << "  A" << i << ": 0x" << std::hex << std::setw(8) << std::setfill('0') 
                   << registers[i] << std::dec << std::endl;
     }
+    for (int i = 0; i < 16; i++) {
+        std::cout << "  F" << i << ": " << asFloat(floatRegisters[i]) << std::endl;
+    }
+    std::cout << "  FCR: 0x" << std::hex << fcr << "  FSR: 0x" << fsr << "  BR: 0x" << booleans << std::dec << std::endl;
 }
 
 void XtensaLX6::dumpPC() const {
+    if (symbols) {
+        std::cout << "PC: " << symbols->describe(pc) << std::endl;
+        return;
+    }
     std::cout << "PC: 0x" << std::hex << pc << std::dec << std::endl;
 } 
\ No newline at end of file
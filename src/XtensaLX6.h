@@ -2,23 +2,141 @@
 
 #include <cstdint>
 #include <functional>
+#include <vector>
 #include "Memory.h"
+#include "Coverage.h"
 
 class Memory;
+class SymbolIndex;
+class TimingModel;
 
 
 class XtensaLX6 {
+public:
+    // Architectural state, trivially copyable so snapshots are a plain copy
+    struct State {
+        uint32_t registers[16];
+        uint32_t pc;
+        bool waiting;
+        uint32_t floatRegisters[16];
+        uint32_t fcr;
+        uint32_t fsr;
+        uint16_t booleans;
+        uint32_t lbeg;
+        uint32_t lend;
+        uint32_t lcount;
+        uint64_t acc;
+        uint32_t macRegisters[4];
+    };
+    
+    // Faults the guest causes are recorded rather than thrown, so a crashing
+    // input costs no allocation. The first one sticks, with the PC left on
+    // the faulting instruction, until reset(), setState() or clearFault().
+    enum class FaultKind : uint8_t {
+        None,
+        IllegalInstruction,      // detail is the instruction word
+        UnknownSpecialRegister,  // detail is the register number
+        UnalignedLoad,           // detail is the address
+        UnalignedStore,
+    };
+    struct Fault {
+        FaultKind kind;
+        uint32_t pc;
+        uint32_t detail;
+    };
+    static const char* describe(FaultKind kind);
+
 private:
     Memory* memory;
     
-    std::function<uint32_t(uint32_t)> peripheralReadCallback;
-    std::function<void(uint32_t, uint32_t)> peripheralWriteCallback;
-    
     uint32_t registers[16]; 
     uint32_t pc;             
+    bool waiting;            // Parked in WAITI until a peripheral has something pending
+    
+    // Single-precision FPU. f0-f15 keep raw IEEE bits so NaN payloads survive.
+    uint32_t floatRegisters[16];
+    uint32_t fcr;            // Rounding mode [1:0], exception enables [11:7]
+    uint32_t fsr;            // Sticky exception flags [11:7]
+    uint16_t booleans;       // b0-b15, written by FP compares
+    
+    // Zero-overhead loop registers
+    uint32_t lbeg;
+    uint32_t lend;
+    uint32_t lcount;
+    
+    // MAC16: 40-bit accumulator (ACCLO/ACCHI) and m0-m3
+    uint64_t acc;
+    uint32_t macRegisters[4];
+    
+    // Decoded block cache. A block runs up to a control-flow instruction or
+    // to LEND, so the loop-back test only happens when a block falls
+    // through, never per instruction. Bumping the epoch drops every block
+    // at once; a write to the RAM a block came from changes that page's
+    // generation in Memory and drops just the blocks from it, and moving
+    // LEND drops just the blocks that run across the new one.
+    static constexpr uint32_t MAX_BLOCK_INSTRUCTIONS = 16;
+    static constexpr uint32_t MAX_BLOCK_BYTES = MAX_BLOCK_INSTRUCTIONS * 3;
+    static constexpr uint32_t BLOCK_CACHE_SIZE = 1024;
+    struct DecodedBlock {
+        uint32_t start;
+        uint32_t end;            // Address after the last instruction
+        uint32_t epoch;
+        // RAM pages holding the first and last byte (usually the same one)
+        // and their generations when the block was decoded
+        uint32_t pages[2];
+        uint32_t generations[2];
+        uint8_t count;
+        uint64_t starts;         // Bit n set when an instruction starts at start + n
+        uint32_t words[MAX_BLOCK_INSTRUCTIONS];
+    };
+    static_assert(MAX_BLOCK_BYTES <= 64, "Instruction starts must fit one word");
+    std::vector<DecodedBlock> blockCache;
+    uint32_t cacheEpoch;
+    const DecodedBlock* currentBlock;
+    uint32_t blockIndex;
+    uint32_t blockPc;        // PC the next instruction of currentBlock expects
+    
+    uint64_t retired;        // Instructions completed, for benchmarks (not part of State)
+    mutable Fault fault;     // Not part of State either; restoring one clears it
+    
+    const uint32_t* pageGenerations;   // Memory's, read on every block lookup
+    
+    const DecodedBlock* lookupBlock(uint32_t address);
+    const DecodedBlock* decodeBlock(DecodedBlock& block, uint32_t address);
+    void invalidateBlocksAcross(uint32_t address);
+    
+    // AFL-style edge coverage: map[hash(prev) ^ hash(target)]++ on every branch
+    uint8_t* edgeMap;
+    uint32_t edgeMapMask;
+    uint32_t prevLocation;
+    
+    // Line coverage: one bit per executed instruction address
+    Coverage* coverage;
+    // Only for naming the PC in dumps
+    const SymbolIndex* symbols;
+    
+    // Optional cycle model, told about every retired instruction and access
+    TimingModel* timing;
+    
+    void recordEdge(uint32_t target) {
+        if (!edgeMap) return;
+        uint32_t location = (target >> 1) * 0x9E3779B1u;
+        location ^= location >> 16;
+        edgeMap[(location ^ prevLocation) & edgeMapMask]++;
+        prevLocation = location >> 1;
+    }
+    
+    void raiseFault(FaultKind kind, uint32_t detail) const {
+        if (fault.kind == FaultKind::None) {
+            fault = {kind, pc, detail};
+        }
+    }
     
     uint32_t fetchInstruction();
     void decodeAndExecute(uint32_t instruction);
+    void executeInstruction();
+    // executeInstruction plus reporting to the timing model
+    void executeTimed();
     
     void executeL32IN(uint32_t instruction);
     void executeS32IN(uint32_t instruction);
@@ -28,26 +146,54 @@ private:
     void executeSUBN(uint32_t instruction);
     void executeMOVN(uint32_t instruction);
     void executeBEQN(uint32_t instruction);
+    void executeWAITI(uint32_t instruction);
+    void executeFPU(uint32_t instruction);
+    void executeLoop(uint32_t instruction);
+    void executeMAC16(uint32_t instruction);
+    uint32_t readSpecialRegister(uint8_t number) const;
+    void writeSpecialRegister(uint8_t number, uint32_t value);
 
 public:
-    explicit XtensaLX6(Memory* mem);
+    explicit XtensaLX6(Memory* mem, bool quiet = false);
     ~XtensaLX6() = default;
 
     void execute();
     void reset();
+    
+    State getState() const;
+    void setState(const State& state);
+    
+    void setCoverage(Coverage* cov) { coverage = cov; }
+    void setSymbols(const SymbolIndex* index) { symbols = index; }
+    void setEdgeCoverageMap(uint8_t* map, size_t size);
+    void setTimingModel(TimingModel* model) { timing = model; }
+    
+    // Drops every decoded block. Writes through Memory, including the
+    // CPU's own stores, already invalidate the blocks they touch.
+    void invalidateCodeCache();
+    void resetEdgeState() { prevLocation = 0; }
 
     uint32_t getRegister(uint8_t reg) const;
     void setRegister(uint8_t reg, uint32_t value);
     
+    bool hasFault() const { return fault.kind != FaultKind::None; }
+    const Fault& getFault() const { return fault; }
+    void clearFault() { fault = {FaultKind::None, 0, 0}; }
+    
+    bool isWaiting() const { return waiting; }
+    void wake() { waiting = false; }
+    
+    uint64_t getRetiredInstructions() const { return retired; }
+    
+    uint32_t getFloatRegister(uint8_t reg) const;
+    void setFloatRegister(uint8_t reg, uint32_t bits);
+    
     uint32_t getPC() const { return pc; }
     void setPC(uint32_t newPC) { pc = newPC; }
     
     uint32_t readMemory(uint32_t address) const;
     void writeMemory(uint32_t address, uint32_t value);
     
-    void setPeripheralReadCallback(std::function<uint32_t(uint32_t)> callback);
-    void setPeripheralWriteCallback(std::function<void(uint32_t, uint32_t)> callback);
-    
     void dumpRegisters() const;
     void dumpPC() const;
 }; 
\ No newline at end of file
@@ -2,44 +2,228 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include "Emulator.h"
+#include "ElfFile.h"
+#include "HttpBackend.h"
+#include "peripherals/GPIO.h"
+#include "peripherals/WiFi.h"
+#include "peripherals/SharedMemoryPeripheral.h"
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " <firmware.bin>" << std::endl;
+    std::cout << "Usage: " << programName << " [options] <firmware.bin|firmware.elf>" << std::endl;
     std::cout << "  Loads and executes ESP32 firmware binary" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --max-cycles <n>     Stop after n cycles" << std::endl;
+    std::cout << "  --coverage <file>    Write lcov line coverage (ELF firmware with -g)" << std::endl;
+    std::cout << "  --soc <file>         SoC description: memory map, peripherals, clock (default ESP32)" << std::endl;
+    std::cout << "  --clock-mhz <n>      Guest clock frequency (default from the SoC, 240)" << std::endl;
+    std::cout << "  --realtime           Pace emulation to the guest clock in wall time" << std::endl;
+    std::cout << "  --idle-sleep         Sleep instead of spinning while the guest is in WAITI" << std::endl;
+    std::cout << "  --hle                Run memcpy/memset/strlen/ets_printf natively (ELF firmware)" << std::endl;
+    std::cout << "  --checkpoint <file>  Stream resumable checkpoints to file" << std::endl;
+    std::cout << "  --checkpoint-every <n>" << std::endl;
+    std::cout << "                       Cycles between checkpoints (default 60 guest seconds)" << std::endl;
+    std::cout << "  --resume <file>      Continue from a checkpoint (and keep checkpointing to it)" << std::endl;
+    std::cout << "  --vcd <file>         Record GPIO pin changes as a VCD waveform" << std::endl;
+    std::cout << "  --task-profile       Report per-task CPU share and context switches (FreeRTOS ELF)" << std::endl;
+    std::cout << "  --timing             Predict on-device cycles (flash cache, memory, MMIO, branches)" << std::endl;
+    std::cout << "  --shm <name[:bytes[@address]]>" << std::endl;
+    std::cout << "                       Map a POSIX shared-memory peripheral (default 4096 bytes at 0x3ff60000)" << std::endl;
+    std::cout << "  --http-endpoint <host=address:port>" << std::endl;
+    std::cout << "                       Map WiFi HTTP requests for host to a local server (repeatable)" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        printUsage(argv[0]);
-        return 1;
+    std::string firmwarePath;
+    std::string coveragePath;
+    uint64_t maxCycles = 0;
+    uint64_t clockMHz = 0;
+    std::string socPath;
+    bool realtime = false;
+    bool idleSleep = false;
+    bool intercepts = false;
+    bool taskProfile = false;
+    bool timing = false;
+    std::vector<std::string> httpEndpoints;
+    std::vector<std::string> sharedSegments;
+    std::string checkpointPath;
+    std::string resumePath;
+    std::string vcdPath;
+    uint64_t checkpointEvery = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--max-cycles" && i + 1 < argc) {
+            maxCycles = std::stoull(argv[++i]);
+        } else if (arg == "--coverage" && i + 1 < argc) {
+            coveragePath = argv[++i];
+        } else if (arg == "--soc" && i + 1 < argc) {
+            socPath = argv[++i];
+        } else if (arg == "--clock-mhz" && i + 1 < argc) {
+            clockMHz = std::stoull(argv[++i]);
+        } else if (arg == "--realtime") {
+            realtime = true;
+        } else if (arg == "--idle-sleep") {
+            idleSleep = true;
+        } else if (arg == "--hle") {
+            intercepts = true;
+        } else if (arg == "--task-profile") {
+            taskProfile = true;
+        } else if (arg == "--timing") {
+            timing = true;
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointPath = argv[++i];
+        } else if (arg == "--checkpoint-every" && i + 1 < argc) {
+            checkpointEvery = std::stoull(argv[++i]);
+        } else if (arg == "--resume" && i + 1 < argc) {
+            resumePath = argv[++i];
+        } else if (arg == "--vcd" && i + 1 < argc) {
+            vcdPath = argv[++i];
+        } else if (arg == "--shm" && i + 1 < argc) {
+            sharedSegments.push_back(argv[++i]);
+        } else if (arg == "--http-endpoint" && i + 1 < argc) {
+            httpEndpoints.push_back(argv[++i]);
+        } else if (arg.rfind("--", 0) == 0 || !firmwarePath.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            firmwarePath = arg;
+        }
     }
 
-    std::string firmwarePath = argv[1];
-    
-    std::ifstream firmwareFile(firmwarePath, std::ios::binary);
-    if (!firmwareFile.is_open()) {
-        std::cerr << "Error: Could not open firmware file: " << firmwarePath << std::endl;
+    // The checkpoint holds all of RAM, so the firmware is only needed on
+    // resume for its symbols (--hle, --coverage)
+    if (firmwarePath.empty() && resumePath.empty()) {
+        printUsage(argv[0]);
         return 1;
     }
+    if (checkpointPath.empty()) {
+        checkpointPath = resumePath;
+    }
 
     std::vector<uint8_t> firmware;
-    firmwareFile.seekg(0, std::ios::end);
-    firmware.resize(firmwareFile.tellg());
-    firmwareFile.seekg(0, std::ios::beg);
-    firmwareFile.read(reinterpret_cast<char*>(firmware.data()), firmware.size());
-    firmwareFile.close();
+    if (!firmwarePath.empty()) {
+        std::ifstream firmwareFile(firmwarePath, std::ios::binary);
+        if (!firmwareFile.is_open()) {
+            std::cerr << "Error: Could not open firmware file: " << firmwarePath << std::endl;
+            return 1;
+        }
+
+        firmwareFile.seekg(0, std::ios::end);
+        firmware.resize(firmwareFile.tellg());
+        firmwareFile.seekg(0, std::ios::beg);
+        firmwareFile.read(reinterpret_cast<char*>(firmware.data()), firmware.size());
+        firmwareFile.close();
 
-    std::cout << "Loaded firmware: " << firmwarePath << " (" << firmware.size() << " bytes)" << std::endl;
+        std::cout << "Loaded firmware: " << firmwarePath << " (" << firmware.size() << " bytes)" << std::endl;
+    }
+
+    if (!coveragePath.empty() && !ElfFile::isElf(firmware)) {
+        std::cerr << "Error: --coverage needs an ELF firmware image with debug info" << std::endl;
+        return 1;
+    }
 
     try {
-        Emulator emulator;
-        emulator.loadFirmware(firmware);
-        emulator.run();
+        SocDescription soc = socPath.empty() ? SocDescription::esp32() : SocDescription::load(socPath);
+        // The built-in ESP32 is dual-core too, but that's no news to anyone
+        // who didn't pick a SoC file
+        if (!socPath.empty() && soc.cores > 1) {
+            std::cout << soc.name << " has " << soc.cores << " cores; only core 0 is emulated" << std::endl;
+        }
+        Emulator emulator(soc);
+        if (clockMHz) {
+            emulator.setClockFrequency(clockMHz * 1000000);
+        }
+        emulator.setPacing(realtime);
+        emulator.setIdleSleep(idleSleep);
+        if (!coveragePath.empty()) {
+            emulator.enableCoverage();
+        }
+        if (timing) {
+            emulator.enableTiming();
+        }
+        
+        if (!httpEndpoints.empty()) {
+            auto backend = std::make_shared<HttpBackend>();
+            for (const auto& mapping : httpEndpoints) {
+                size_t equals = mapping.find('=');
+                size_t colon = mapping.rfind(':');
+                if (equals == std::string::npos || colon == std::string::npos || colon < equals) {
+                    std::cerr << "Error: --http-endpoint expects host=address:port, got " << mapping << std::endl;
+                    return 1;
+                }
+                backend->addEndpoint(mapping.substr(0, equals), mapping.substr(equals + 1, colon - equals - 1),
+                                     static_cast<uint16_t>(std::stoul(mapping.substr(colon + 1))));
+            }
+            emulator.enableWiFi()->setHttpBackend(backend);
+        }
+
+        for (const auto& segment : sharedSegments) {
+            size_t colon = segment.find(':');
+            size_t at = segment.find('@');
+            uint32_t bytes = 4096;
+            uint32_t base = SharedMemoryPeripheral::DEFAULT_BASE;
+            if (colon != std::string::npos) {
+                bytes = static_cast<uint32_t>(std::stoul(segment.substr(colon + 1, at - colon - 1), nullptr, 0));
+            }
+            if (at != std::string::npos) {
+                base = static_cast<uint32_t>(std::stoul(segment.substr(at + 1), nullptr, 0));
+            }
+            emulator.attachSharedMemory(segment.substr(0, std::min(colon, at)), bytes, base);
+        }
+        
+        if (!firmware.empty()) {
+            emulator.loadFirmware(firmware);
+        }
+        if (!resumePath.empty()) {
+            emulator.resume(resumePath);
+        }
+        if (intercepts) {
+            emulator.enableIntercepts();
+        }
+        if (taskProfile) {
+            emulator.enableTaskProfiling();
+        }
+        if (!checkpointPath.empty()) {
+            emulator.enableCheckpoints(checkpointPath, checkpointEvery ? checkpointEvery : emulator.getClockFrequency() * 60);
+        }
+        if (!vcdPath.empty()) {
+            if (!emulator.getGPIO()) {
+                std::cerr << "Error: --vcd needs a GPIO peripheral in the SoC description" << std::endl;
+                return 1;
+            }
+            emulator.getGPIO()->startCapture(vcdPath, emulator.getClockFrequency());
+        }
+        if (maxCycles) {
+            emulator.runFor(maxCycles);
+        } else {
+            emulator.run();
+        }
+        if (!vcdPath.empty()) {
+            emulator.getGPIO()->stopCapture();
+        }
+        if (taskProfile) {
+            emulator.writeTaskProfile(std::cout);
+        }
+        if (timing) {
+            emulator.getTimingModel()->writeReport(std::cout);
+        }
+
+        if (!coveragePath.empty()) {
+            std::ofstream coverageFile(coveragePath);
+            if (!coverageFile.is_open()) {
+                std::cerr << "Error: Could not write coverage file: " << coveragePath << std::endl;
+                return 1;
+            }
+            emulator.getCoverage()->writeLcov(ElfFile(firmware), coverageFile);
+            std::cout << "Coverage written to " << coveragePath << std::endl;
+        }
     } catch (const std::exception& e) {
         std::cerr << "Emulator error: " << e.what() << std::endl;
         return 1;
     }
 
     return 0;
-} 
+}
@@ -0,0 +1,126 @@
+#include "GPIO.h"
+#include <iostream>
+#include <iomanip>
+
+constexpr RegisterMap<GPIO, 11> GPIO::registerMap({
+    {.offset = GPIO_OUT_OFFSET, .storage = &GPIO::outRegister, .onWrite = &GPIO::setOut},
+    {.offset = GPIO_OUT_W1TS_OFFSET, .readMask = 0, .storage = &GPIO::strobeRegister,
+     .onWrite = &GPIO::setOutBits},
+    {.offset = GPIO_OUT_W1TC_OFFSET, .readMask = 0, .storage = &GPIO::strobeRegister,
+     .onWrite = &GPIO::clearOutBits},
+    {.offset = GPIO_ENABLE_OFFSET, .storage = &GPIO::enableRegister, .onWrite = &GPIO::setEnable},
+    {.offset = GPIO_ENABLE_W1TS_OFFSET, .readMask = 0, .storage = &GPIO::strobeRegister,
+     .onWrite = &GPIO::setEnableBits},
+    {.offset = GPIO_ENABLE_W1TC_OFFSET, .readMask = 0, .storage = &GPIO::strobeRegister,
+     .onWrite = &GPIO::clearEnableBits},
+    {.offset = GPIO_IN_OFFSET, .writeMask = 0, .storage = &GPIO::levelRegister},
+    {.offset = GPIO_STATUS_OFFSET, .writeMask = 0, .storage = &GPIO::statusRegister},
+    {.offset = GPIO_STATUS_W1TC_OFFSET, .readMask = 0, .storage = &GPIO::strobeRegister,
+     .onWrite = &GPIO::clearStatus},
+    {.offset = GPIO_PIN_SELECT_OFFSET, .width = 1, .writeMask = 0x1F, .storage = &GPIO::pinSelectRegister},
+    {.offset = GPIO_PIN_CONFIG_OFFSET, .storage = &GPIO::pinConfigRegister,
+     .onRead = &GPIO::readPinConfig, .onWrite = &GPIO::writePinConfig},
+});
+
+GPIO::GPIO(uint32_t baseAddress, bool quiet) : MappedPeripheral(baseAddress, 0x100), pinConfig{},
+                                   pullUpMask(0), openDrainMask(0), interruptMask(0),
+                                   hostDriven(0), hostLevels(0), clock(nullptr) {
+    resetRegisters();
+    if (!quiet) std::cout << "GPIO peripheral initialized at 0x" << std::hex << baseAddress << std::dec << std::endl;
+}
+
+GPIO::~GPIO() {
+    try {
+        stopCapture();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void GPIO::writePinConfig(uint32_t value) {
+    pinConfig[pinSelectRegister & 31] = value & (PIN_PULL_UP | PIN_OPEN_DRAIN | PIN_INTERRUPT);
+    rebuildConfigMasks();
+    updateLevels();
+}
+
+void GPIO::rebuildConfigMasks() {
+    pullUpMask = openDrainMask = interruptMask = 0;
+    for (unsigned pin = 0; pin < PIN_COUNT; pin++) {
+        uint32_t bit = 1u << pin;
+        if (pinConfig[pin] & PIN_PULL_UP) pullUpMask |= bit;
+        if (pinConfig[pin] & PIN_OPEN_DRAIN) openDrainMask |= bit;
+        if (pinConfig[pin] & PIN_INTERRUPT) interruptMask |= bit;
+    }
+}
+
+void GPIO::reset() {
+    // Levels carry over and get recomputed, so a trace sees the reset as
+    // ordinary edges. What the host drives is outside the chip and stays.
+    uint32_t levels = levelRegister;
+    resetRegisters();
+    levelRegister = levels;
+    pinConfig.fill(0);
+    rebuildConfigMasks();
+    updateLevels();
+    statusRegister = 0;
+}
+
+void GPIO::drive(uint32_t mask, uint32_t levels) {
+    hostDriven |= mask;
+    hostLevels = (hostLevels & ~mask) | (levels & mask);
+    updateLevels();
+}
+
+void GPIO::release(uint32_t mask) {
+    hostDriven &= ~mask;
+    hostLevels &= ~mask;
+    updateLevels();
+}
+
+void GPIO::startCapture(const std::string& path, uint64_t clockHz) {
+    stopCapture();
+    trace = std::make_unique<VcdTrace>(path, "gpio", "gpio", PIN_COUNT, clockHz, levelRegister);
+}
+
+void GPIO::stopCapture() {
+    if (!trace) return;
+
+    std::unique_ptr<VcdTrace> finished = std::move(trace);
+    finished->close(clock ? *clock : 0);
+    std::cout << "GPIO trace: " << finished->getRecorded() << " changes written to " << finished->getPath();
+    if (finished->getStalls()) {
+        std::cout << " (emulator waited for the writer " << finished->getStalls() << " times)";
+    }
+    std::cout << std::endl;
+}
+
+void GPIO::saveState(std::vector<uint8_t>& out) const {
+    for (uint32_t value : {outRegister, enableRegister, statusRegister, pinSelectRegister,
+                           hostDriven, hostLevels}) {
+        putState(out, value);
+    }
+    putState(out, pinConfig);
+}
+
+void GPIO::loadState(const uint8_t* data, size_t length) {
+    const uint8_t* end = data + length;
+    for (uint32_t* value : {&outRegister, &enableRegister, &statusRegister, &pinSelectRegister,
+                            &hostDriven, &hostLevels}) {
+        *value = takeState<uint32_t>(data, end);
+    }
+    pinConfig = takeState<decltype(pinConfig)>(data, end);
+    rebuildConfigMasks();
+
+    // Levels are derived, so restoring them shows up in a trace as edges
+    uint32_t status = statusRegister;
+    updateLevels();
+    statusRegister = status;
+}
+
+void GPIO::dumpRegisters() const {
+    std::cout << "GPIO Registers:" << std::endl;
+    std::cout << "  Out:       0x" << std::hex << std::setw(8) << std::setfill('0') << outRegister << std::dec << std::endl;
+    std::cout << "  Enable:    0x" << std::hex << std::setw(8) << std::setfill('0') << enableRegister << std::dec << std::endl;
+    std::cout << "  Levels:    0x" << std::hex << std::setw(8) << std::setfill('0') << levelRegister << std::dec << std::endl;
+    std::cout << "  Status:    0x" << std::hex << std::setw(8) << std::setfill('0') << statusRegister << std::dec << std::endl;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "RegisterMap.h"
+#include "../VcdTrace.h"
+#include <array>
+#include <memory>
+#include <string>
+
+
+// 32-pin GPIO bank using the ESP32 register offsets for output, enable,
+// input and interrupt status. Each pin's level is what an analyzer on the
+// wire would see: the output when the pin drives it, otherwise whatever
+// the host drives, otherwise the pull-up. Every level change can be
+// recorded into a VCD trace.
+class GPIO : public MappedPeripheral<GPIO> {
+private:
+    friend class MappedPeripheral<GPIO>;
+
+    uint32_t outRegister;
+    uint32_t enableRegister;
+    uint32_t levelRegister;        // Current pin levels, read through IN
+    uint32_t statusRegister;       // Pins with interrupts enabled that changed
+    uint32_t pinSelectRegister;
+    uint32_t pinConfigRegister;    // Scratch; PIN_CONFIG reads and writes pinConfig
+    uint32_t strobeRegister;       // Scratch for the write-1-to-set/clear registers
+    std::array<uint32_t, 32> pinConfig;
+
+    // Derived from pinConfig so recomputing levels is a few mask operations
+    uint32_t pullUpMask;
+    uint32_t openDrainMask;
+    uint32_t interruptMask;
+
+    // Inputs the host drives (vesp_gpio_drive); other undriven pins float
+    // to their pull
+    uint32_t hostDriven;
+    uint32_t hostLevels;
+
+    const uint64_t* clock;
+    std::unique_ptr<VcdTrace> trace;
+
+    static constexpr uint32_t GPIO_OUT_OFFSET = 0x04;
+    static constexpr uint32_t GPIO_OUT_W1TS_OFFSET = 0x08;
+    static constexpr uint32_t GPIO_OUT_W1TC_OFFSET = 0x0C;
+    static constexpr uint32_t GPIO_ENABLE_OFFSET = 0x20;
+    static constexpr uint32_t GPIO_ENABLE_W1TS_OFFSET = 0x24;
+    static constexpr uint32_t GPIO_ENABLE_W1TC_OFFSET = 0x28;
+    static constexpr uint32_t GPIO_IN_OFFSET = 0x3C;
+    static constexpr uint32_t GPIO_STATUS_OFFSET = 0x44;
+    static constexpr uint32_t GPIO_STATUS_W1TC_OFFSET = 0x4C;
+    static constexpr uint32_t GPIO_PIN_SELECT_OFFSET = 0x50;
+    static constexpr uint32_t GPIO_PIN_CONFIG_OFFSET = 0x54;
+
+    static const RegisterMap<GPIO, 11> registerMap;
+
+    void setOut(uint32_t value) { outRegister = value; updateLevels(); }
+    void setOutBits(uint32_t value) { setOut(outRegister | value); }
+    void clearOutBits(uint32_t value) { setOut(outRegister & ~value); }
+    void setEnable(uint32_t value) { enableRegister = value; updateLevels(); }
+    void setEnableBits(uint32_t value) { setEnable(enableRegister | value); }
+    void clearEnableBits(uint32_t value) { setEnable(enableRegister & ~value); }
+    void clearStatus(uint32_t value) { statusRegister &= ~value; }
+    uint32_t readPinConfig() const { return pinConfig[pinSelectRegister & 31]; }
+    void writePinConfig(uint32_t value);
+    void rebuildConfigMasks();
+
+    uint32_t computeLevels() const {
+        uint32_t driven = enableRegister & ~(openDrainMask & outRegister);
+        uint32_t floating = (hostLevels & hostDriven) | (pullUpMask & ~hostDriven);
+        return (outRegister & driven) | (floating & ~driven);
+    }
+
+    // The hot path for bit-banging: a handful of mask operations, plus one
+    // ring-buffer push when a trace is running
+    void updateLevels() {
+        uint32_t levels = computeLevels();
+        uint32_t changed = levels ^ levelRegister;
+        if (!changed) return;
+        levelRegister = levels;
+        statusRegister |= changed & interruptMask;
+        if (trace) {
+            trace->record(clock ? *clock : 0, changed, levels);
+        }
+    }
+
+public:
+    static constexpr uint32_t DEFAULT_BASE = 0x3FF44000;
+    static constexpr unsigned PIN_COUNT = 32;
+
+    // PIN_CONFIG bits
+    static constexpr uint32_t PIN_PULL_UP = 0x01;
+    static constexpr uint32_t PIN_OPEN_DRAIN = 0x04;   // Writing 1 releases the pin
+    static constexpr uint32_t PIN_INTERRUPT = 0x80;    // Set STATUS on either edge
+
+    explicit GPIO(uint32_t baseAddress = DEFAULT_BASE, bool quiet = false);
+    ~GPIO() override;
+
+    void reset() override;
+    void update() override {}
+    bool interruptPending() const override { return statusRegister != 0; }
+    void saveState(std::vector<uint8_t>& out) const override;
+    void loadState(const uint8_t* data, size_t length) override;
+    void dumpRegisters() const override;
+
+    // Timestamps for the trace come from here (the owning emulator's cycles)
+    void setClock(const uint64_t* cycles) { clock = cycles; }
+
+    // Host side of the pins: drive the masked inputs to levels, or let
+    // them float back to their pulls
+    void drive(uint32_t mask, uint32_t levels);
+    void release(uint32_t mask);
+    uint32_t getLevels() const { return levelRegister; }
+
+    // Starts streaming every level change to a VCD file; stopCapture()
+    // drains and closes it
+    void startCapture(const std::string& path, uint64_t clockHz);
+    void stopCapture();
+    const VcdTrace* getTrace() const { return trace.get(); }
+};
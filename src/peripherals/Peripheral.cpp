@@ -1,4 +1,5 @@
 #include "Peripheral.h"
+#include "../Memory.h"
 
 Peripheral::Peripheral(uint32_t baseAddr, uint32_t peripheralSize) 
     : baseAddress(baseAddr), size(peripheralSize) {
@@ -6,4 +7,26 @@ Peripheral::Peripheral(uint32_t baseAddr, uint32_t peripheralSize)
  
 bool Peripheral::isInRange(uint32_t address) const {
     return address >= baseAddress && address < (baseAddress + size);
-} 
\ No newline at end of file
+}
+
+bool Peripheral::dmaRead(uint32_t address, uint8_t* data, size_t length) const {
+    if (!memory || length > MAX_DMA_LENGTH) return false;
+    
+    try {
+        memory->readBytes(address, data, length);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return true;
+}
+
+bool Peripheral::dmaWrite(uint32_t address, const uint8_t* data, size_t length) {
+    if (!memory || length > MAX_DMA_LENGTH) return false;
+    
+    try {
+        memory->writeBytes(address, data, length);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return true;
+}
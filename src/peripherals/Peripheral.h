@@ -1,13 +1,47 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+class Memory;
 
 class Peripheral {
 protected:
     uint32_t baseAddress;
     uint32_t size;
+    Memory* memory = nullptr;  // Guest memory for DMA, set by the owning emulator
+    
+    // Bulk copies for DMA engines. A transfer that is too long or touches
+    // unmapped memory copies nothing and returns false.
+    bool dmaRead(uint32_t address, uint8_t* data, size_t length) const;
+    bool dmaWrite(uint32_t address, const uint8_t* data, size_t length);
+    
+    // Helpers for saveState/loadState: fixed-width little-endian host copies
+    template <typename T>
+    static void putState(std::vector<uint8_t>& out, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+    
+    template <typename T>
+    static T takeState(const uint8_t*& data, const uint8_t* end) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (static_cast<size_t>(end - data) < sizeof(T)) {
+            throw std::runtime_error("Truncated peripheral state");
+        }
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
 
 public:
+    static constexpr uint32_t MAX_DMA_LENGTH = 0x10000;
+    
     Peripheral(uint32_t baseAddr, uint32_t peripheralSize);
     virtual ~Peripheral() = default;
 
@@ -23,9 +57,17 @@ public:
     virtual void reset() = 0;
     virtual void update() = 0;  
     
+    // True while the peripheral has something the guest should wake up for
+    virtual bool interruptPending() const { return false; }
+    
+    // Snapshot support: append all guest-visible state to out / restore it
+    virtual void saveState(std::vector<uint8_t>& out) const = 0;
+    virtual void loadState(const uint8_t* data, size_t length) = 0;
+    
     bool isInRange(uint32_t address) const;
     uint32_t getBaseAddress() const { return baseAddress; }
     uint32_t getSize() const { return size; }
+    void attachMemory(Memory* guestMemory) { memory = guestMemory; }
     
     virtual void dumpRegisters() const = 0;
 }; 
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include "Peripheral.h"
+
+
+// One memory-mapped register. Registers sit on 4-byte boundaries; width
+// limits which byte lanes exist. Hooks run once per access, whatever its size.
+template <typename Owner>
+struct RegisterDef {
+    uint32_t offset;
+    uint8_t width = 4;                  // Bytes: 1, 2 or 4
+    uint32_t resetValue = 0;
+    uint32_t readMask = 0xFFFFFFFF;
+    uint32_t writeMask = 0xFFFFFFFF;
+    uint32_t Owner::*storage = nullptr;
+    uint32_t (Owner::*onRead)() const = nullptr;       // Replaces the stored value on reads
+    void (Owner::*onWrite)(uint32_t value) = nullptr;  // Runs after storage is updated
+
+    constexpr uint32_t widthMask() const {
+        return width >= 4 ? 0xFFFFFFFF : (1u << (width * 8)) - 1;
+    }
+};
+
+// Compile-time register table for a peripheral window. The constructor
+// builds a word-indexed slot table, so dispatch is a single array lookup.
+template <typename Owner, size_t Count, uint32_t WindowSize = 0x100>
+class RegisterMap {
+private:
+    std::array<RegisterDef<Owner>, Count> registers;
+    std::array<uint8_t, WindowSize / 4> slots{};  // Register index + 1, 0 = unmapped
+
+    static constexpr uint32_t accessMask(unsigned size) {
+        return size >= 4 ? 0xFFFFFFFF : (1u << (size * 8)) - 1;
+    }
+
+    constexpr const RegisterDef<Owner>* find(uint32_t offset) const {
+        if (offset >= WindowSize) return nullptr;
+        uint8_t slot = slots[offset >> 2];
+        return slot ? &registers[slot - 1] : nullptr;
+    }
+
+public:
+    constexpr explicit RegisterMap(const RegisterDef<Owner> (&defs)[Count]) {
+        static_assert(Count < 256, "Register index must fit in a slot byte");
+        for (size_t i = 0; i < Count; i++) {
+            registers[i] = defs[i];
+        }
+        for (size_t i = 0; i < Count; i++) {
+            const auto& reg = registers[i];
+            if (reg.offset % 4 != 0 || reg.offset >= WindowSize) {
+                throw std::logic_error("Register offset must be word aligned and inside the window");
+            }
+            if (reg.width != 1 && reg.width != 2 && reg.width != 4) {
+                throw std::logic_error("Register width must be 1, 2 or 4 bytes");
+            }
+            if (!reg.storage) {
+                throw std::logic_error("Register needs backing storage");
+            }
+            if (slots[reg.offset >> 2]) {
+                throw std::logic_error("Overlapping register definitions");
+            }
+            slots[reg.offset >> 2] = static_cast<uint8_t>(i + 1);
+        }
+    }
+
+    // Unaligned accesses read as zero and are ignored on write, like the
+    // hand-written dispatch this replaces
+    uint32_t read(const Owner& owner, uint32_t offset, unsigned size) const {
+        if (offset % size != 0) return 0;
+
+        const RegisterDef<Owner>* reg = find(offset);
+        if (!reg) return 0;
+
+        uint32_t value = reg->onRead ? (owner.*(reg->onRead))() : owner.*(reg->storage);
+        value &= reg->readMask & reg->widthMask();
+
+        unsigned shift = (offset & 3) * 8;
+        return (value >> shift) & accessMask(size);
+    }
+
+    void write(Owner& owner, uint32_t offset, unsigned size, uint32_t value) const {
+        if (offset % size != 0) return;
+
+        const RegisterDef<Owner>* reg = find(offset);
+        if (!reg) return;
+
+        unsigned shift = (offset & 3) * 8;
+        uint32_t lanes = (accessMask(size) << shift) & reg->writeMask & reg->widthMask();
+        if (!lanes) return;
+
+        uint32_t& stored = owner.*(reg->storage);
+        stored = (stored & ~lanes) | ((value << shift) & lanes);
+
+        if (reg->onWrite) {
+            (owner.*(reg->onWrite))(stored);
+        }
+    }
+
+    void reset(Owner& owner) const {
+        for (const auto& reg : registers) {
+            owner.*(reg.storage) = reg.resetValue;
+        }
+    }
+
+    static constexpr uint32_t windowSize() { return WindowSize; }
+};
+
+// Implements the Peripheral MMIO interface from Derived::registerMap.
+// Derived must befriend MappedPeripheral<Derived> if the map is private.
+template <typename Derived>
+class MappedPeripheral : public Peripheral {
+private:
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+    Derived& self() { return static_cast<Derived&>(*this); }
+
+public:
+    using Peripheral::Peripheral;
+
+    uint8_t read8(uint32_t offset) const override {
+        return static_cast<uint8_t>(Derived::registerMap.read(self(), offset, 1));
+    }
+    uint16_t read16(uint32_t offset) const override {
+        return static_cast<uint16_t>(Derived::registerMap.read(self(), offset, 2));
+    }
+    uint32_t read32(uint32_t offset) const override {
+        return Derived::registerMap.read(self(), offset, 4);
+    }
+
+    void write8(uint32_t offset, uint8_t value) override {
+        Derived::registerMap.write(self(), offset, 1, value);
+    }
+    void write16(uint32_t offset, uint16_t value) override {
+        Derived::registerMap.write(self(), offset, 2, value);
+    }
+    void write32(uint32_t offset, uint32_t value) override {
+        Derived::registerMap.write(self(), offset, 4, value);
+    }
+
+protected:
+    void resetRegisters() {
+        Derived::registerMap.reset(self());
+    }
+};
@@ -0,0 +1,175 @@
+#include "SharedMemoryPeripheral.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <iomanip>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(vesp_shm_header) == VESP_SHM_DATA_OFFSET, "Shared header must fill the register block");
+
+SharedMemoryPeripheral::SharedMemoryPeripheral(const std::string& segmentName, uint32_t requestedSize, uint32_t baseAddress,
+                                               bool quiet)
+    : Peripheral(baseAddress, VESP_SHM_DATA_OFFSET), name(segmentName), header(nullptr), data(nullptr),
+      mappingSize(0), dataSize(requestedSize), created(false), ackRegister(0) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        created = true;
+        if (dataSize == 0 || dataSize > MAX_DATA_SIZE || ftruncate(fd, sizeof(vesp_shm_header) + dataSize) < 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::invalid_argument("Could not size shared memory segment " + name);
+        }
+    } else if (errno == EEXIST) {
+        fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("shm_open " + name + " failed: " + std::strerror(errno));
+    }
+    
+    struct stat info{};
+    if (fstat(fd, &info) < 0) {
+        int error = errno;
+        close(fd);
+        if (created) shm_unlink(name.c_str());
+        throw std::runtime_error("fstat " + name + " failed: " + std::strerror(error));
+    }
+    mappingSize = static_cast<size_t>(info.st_size);
+    void* mapping = mappingSize >= sizeof(vesp_shm_header)
+                  ? mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        if (created) shm_unlink(name.c_str());
+        throw std::runtime_error("Could not map shared memory segment " + name);
+    }
+    
+    header = static_cast<vesp_shm_header*>(mapping);
+    data = vesp_shm_data(header);
+    
+    if (created) {
+        header->version = VESP_SHM_VERSION;
+        header->data_size = dataSize;
+        header->host_sequence = 0;
+        header->guest_sequence = 0;
+        // Magic last, so a host polling for it sees a complete header
+        __atomic_store_n(&header->magic, VESP_SHM_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        bool valid = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == VESP_SHM_MAGIC &&
+                     header->version == VESP_SHM_VERSION;
+        // Read once: the host could change it between a check and a use
+        dataSize = __atomic_load_n(&header->data_size, __ATOMIC_RELAXED);
+        if (!valid || dataSize > MAX_DATA_SIZE || sizeof(vesp_shm_header) + dataSize > mappingSize) {
+            munmap(header, mappingSize);
+            throw std::runtime_error("Not a vesp shared memory segment: " + name);
+        }
+    }
+    
+    size = VESP_SHM_DATA_OFFSET + dataSize;
+    if (!quiet) {
+        std::cout << "Shared memory peripheral " << name << " (" << dataSize << " bytes) at 0x"
+                  << std::hex << baseAddress << std::dec << std::endl;
+    }
+}
+
+SharedMemoryPeripheral::~SharedMemoryPeripheral() {
+    munmap(header, mappingSize);
+    if (created) {
+        shm_unlink(name.c_str());
+    }
+}
+
+uint32_t SharedMemoryPeripheral::hostSequence() const {
+    // Orders the guest's earlier data reads before this load, which is what
+    // makes "read sequence, read data, read sequence again" work
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return __atomic_load_n(&header->host_sequence, __ATOMIC_ACQUIRE);
+}
+
+uint32_t SharedMemoryPeripheral::readWindow(uint32_t offset, unsigned accessSize) const {
+    if (offset % accessSize != 0) return 0;
+    
+    if (offset >= VESP_SHM_DATA_OFFSET) {
+        uint32_t index = offset - VESP_SHM_DATA_OFFSET;
+        if (index + accessSize > dataSize) return 0;
+        
+        // Aligned loads straight from the segment; each one is atomic, the
+        // sequence lock makes a run of them consistent
+        const uint8_t* address = data + index;
+        switch (accessSize) {
+            case 1: return __atomic_load_n(address, __ATOMIC_RELAXED);
+            case 2: return __atomic_load_n(reinterpret_cast<const uint16_t*>(address), __ATOMIC_RELAXED);
+            default: return __atomic_load_n(reinterpret_cast<const uint32_t*>(address), __ATOMIC_RELAXED);
+        }
+    }
+    
+    uint32_t value;
+    switch (offset & ~3u) {
+        case VESP_SHM_SEQUENCE: value = hostSequence(); break;
+        case VESP_SHM_ACK: value = ackRegister; break;
+        case VESP_SHM_COMMIT: value = __atomic_load_n(&header->guest_sequence, __ATOMIC_RELAXED); break;
+        case VESP_SHM_SIZE: value = dataSize; break;
+        default: return 0;
+    }
+    unsigned shift = (offset & 3) * 8;
+    uint32_t mask = accessSize >= 4 ? 0xFFFFFFFF : (1u << (accessSize * 8)) - 1;
+    return (value >> shift) & mask;
+}
+
+void SharedMemoryPeripheral::writeWindow(uint32_t offset, unsigned accessSize, uint32_t value) {
+    if (offset % accessSize != 0) return;
+    
+    if (offset >= VESP_SHM_DATA_OFFSET) {
+        uint32_t index = offset - VESP_SHM_DATA_OFFSET;
+        if (index + accessSize > dataSize) return;
+        
+        uint8_t* address = data + index;
+        switch (accessSize) {
+            case 1: __atomic_store_n(address, static_cast<uint8_t>(value), __ATOMIC_RELAXED); break;
+            case 2: __atomic_store_n(reinterpret_cast<uint16_t*>(address), static_cast<uint16_t>(value), __ATOMIC_RELAXED); break;
+            default: __atomic_store_n(reinterpret_cast<uint32_t*>(address), value, __ATOMIC_RELAXED); break;
+        }
+        return;
+    }
+    
+    switch (offset) {
+        case VESP_SHM_ACK:
+            if (accessSize == 4) ackRegister = value;
+            break;
+        case VESP_SHM_COMMIT:
+            // Publishes every guest write before it to the host
+            __atomic_fetch_add(&header->guest_sequence, 1, __ATOMIC_RELEASE);
+            break;
+        default:
+            break;
+    }
+}
+
+bool SharedMemoryPeripheral::interruptPending() const {
+    uint32_t sequence = __atomic_load_n(&header->host_sequence, __ATOMIC_RELAXED);
+    return (sequence & 1) == 0 && sequence != ackRegister;
+}
+
+void SharedMemoryPeripheral::reset() {
+    ackRegister = 0;
+}
+
+void SharedMemoryPeripheral::saveState(std::vector<uint8_t>& out) const {
+    putState(out, ackRegister);
+}
+
+void SharedMemoryPeripheral::loadState(const uint8_t* state, size_t length) {
+    const uint8_t* end = state + length;
+    ackRegister = takeState<uint32_t>(state, end);
+}
+
+void SharedMemoryPeripheral::dumpRegisters() const {
+    std::cout << "Shared memory " << name << ":" << std::endl;
+    std::cout << "  Host sequence:  " << __atomic_load_n(&header->host_sequence, __ATOMIC_RELAXED) << std::endl;
+    std::cout << "  Ack:            " << ackRegister << std::endl;
+    std::cout << "  Guest sequence: " << __atomic_load_n(&header->guest_sequence, __ATOMIC_RELAXED) << std::endl;
+    std::cout << "  Data size:      0x" << std::hex << std::setw(8) << std::setfill('0') << dataSize
+              << std::dec << std::setfill(' ') << std::endl;
+}
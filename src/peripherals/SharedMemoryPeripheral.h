@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Peripheral.h"
+#include "../vesp_shm.h"
+#include <string>
+
+
+// Peripheral whose window is backed by a POSIX shared-memory segment, so a
+// host process can stream samples, pin levels or frames straight into
+// guest-visible memory with no copies and no locks. Data accesses go to the
+// segment directly; consistency comes from the sequence lock described in
+// vesp_shm.h. The guest can WAITI until the host publishes a sequence it
+// hasn't acknowledged yet.
+class SharedMemoryPeripheral : public Peripheral {
+private:
+    std::string name;
+    vesp_shm_header* header;
+    uint8_t* data;
+    size_t mappingSize;
+    // Checked against the mapping once at construction. The header copy is
+    // host-writable, so accesses never bound themselves by it.
+    uint32_t dataSize;
+    bool created;            // This instance created the segment and unlinks it
+    uint32_t ackRegister;
+    
+    uint32_t hostSequence() const;
+    uint32_t readWindow(uint32_t offset, unsigned size) const;
+    void writeWindow(uint32_t offset, unsigned size, uint32_t value);
+
+public:
+    static constexpr uint32_t DEFAULT_BASE = 0x3FF60000;
+    static constexpr uint32_t MAX_DATA_SIZE = 0x10000 - VESP_SHM_DATA_OFFSET;
+    
+    // Opens the named segment (e.g. "/vesp-sensor"), creating it with
+    // dataSize bytes if it doesn't exist yet. An existing segment keeps
+    // its own size.
+    SharedMemoryPeripheral(const std::string& name, uint32_t dataSize, uint32_t baseAddress = DEFAULT_BASE,
+                           bool quiet = false);
+    ~SharedMemoryPeripheral() override;
+    
+    SharedMemoryPeripheral(const SharedMemoryPeripheral&) = delete;
+    SharedMemoryPeripheral& operator=(const SharedMemoryPeripheral&) = delete;
+    
+    uint8_t read8(uint32_t offset) const override { return static_cast<uint8_t>(readWindow(offset, 1)); }
+    uint16_t read16(uint32_t offset) const override { return static_cast<uint16_t>(readWindow(offset, 2)); }
+    uint32_t read32(uint32_t offset) const override { return readWindow(offset, 4); }
+    
+    void write8(uint32_t offset, uint8_t value) override { writeWindow(offset, 1, value); }
+    void write16(uint32_t offset, uint16_t value) override { writeWindow(offset, 2, value); }
+    void write32(uint32_t offset, uint32_t value) override { writeWindow(offset, 4, value); }
+    
+    void reset() override;
+    void update() override {}
+    // New data is an even sequence the guest hasn't acknowledged
+    bool interruptPending() const override;
+    
+    // Only the guest-side registers are saved; the data belongs to the host
+    void saveState(std::vector<uint8_t>& out) const override;
+    void loadState(const uint8_t* data, size_t length) override;
+    void dumpRegisters() const override;
+    
+    vesp_shm_header* getHeader() const { return header; }
+    uint32_t getDataSize() const { return dataSize; }
+    const std::string& getName() const { return name; }
+};
@@ -1,96 +1,125 @@
 #include "UART.h"
+#include "../Memory.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
-UART::UART() : Peripheral(0x3FF40000, 0x100), 
-                dataRegister(0), statusRegister(0), 
-                controlRegister(0), baudRateRegister(115200),
-                txReady(true), rxReady(false) {
-    std::cout << "UART peripheral initialized at 0x" << std::hex << baseAddress << std::dec << std::endl;
+constexpr RegisterMap<UART, 11> UART::registerMap({
+    {.offset = UART_DATA_OFFSET, .width = 1, .storage = &UART::dataRegister,
+     .onRead = &UART::readData, .onWrite = &UART::writeData},
+    {.offset = UART_STATUS_OFFSET, .width = 1, .storage = &UART::statusRegister},
+    {.offset = UART_CONTROL_OFFSET, .width = 1, .storage = &UART::controlRegister},
+    {.offset = UART_BAUD_OFFSET, .resetValue = 115200, .storage = &UART::baudRateRegister},
+    {.offset = UART_DMA_TX_ADDRESS_OFFSET, .storage = &UART::dmaTxAddressRegister},
+    {.offset = UART_DMA_TX_LENGTH_OFFSET, .storage = &UART::dmaTxLengthRegister},
+    {.offset = UART_DMA_RX_ADDRESS_OFFSET, .storage = &UART::dmaRxAddressRegister},
+    {.offset = UART_DMA_RX_LENGTH_OFFSET, .storage = &UART::dmaRxLengthRegister},
+    {.offset = UART_DMA_CONTROL_OFFSET, .width = 1, .storage = &UART::dmaControlRegister,
+     .onWrite = &UART::writeDmaControl},
+    // Write 1 to clear; the written value is only scratch
+    {.offset = UART_DMA_STATUS_OFFSET, .width = 1, .storage = &UART::dmaStatusClearRegister,
+     .onRead = &UART::readDmaStatus, .onWrite = &UART::clearDmaStatus},
+    {.offset = UART_DMA_RX_COUNT_OFFSET, .writeMask = 0, .storage = &UART::dmaRxCountRegister},
+});
+
+UART::UART(uint32_t baseAddress, bool quiet) : MappedPeripheral(baseAddress, 0x100), 
+                                   dmaStatusRegister(0), rxDmaArmed(false), rxBuffer(RX_CAPACITY),
+                                   txReady(true), rxReady(false) {
+    resetRegisters();
+    if (!quiet) std::cout << "UART peripheral initialized at 0x" << std::hex << baseAddress << std::dec << std::endl;
 }
 
-uint8_t UART::read8(uint32_t offset) const {
-    switch (offset) {
-        case UART_DATA_OFFSET:
-            return dataRegister & 0xFF;
-        case UART_STATUS_OFFSET:
-            return statusRegister & 0xFF;
-        case UART_CONTROL_OFFSET:
-            return controlRegister & 0xFF;
-        case UART_BAUD_OFFSET:
-            return baudRateRegister & 0xFF;
-        default:
-            return 0;
+uint32_t UART::readData() const {
+    if (!rxBuffer.empty()) {
+        uint8_t byte = rxBuffer.front();
+        rxBuffer.pop();
+        rxReady = !rxBuffer.empty();
+        return byte;
     }
+    return dataRegister;
 }
 
-uint16_t UART::read16(uint32_t offset) const {
-    if (offset % 2 != 0) return 0;
-    
-    uint16_t value = 0;
-    value |= static_cast<uint16_t>(read8(offset));
-    value |= static_cast<uint16_t>(read8(offset + 1)) << 8;
-    return value;
+void UART::writeData(uint32_t value) {
+    sendByte(static_cast<uint8_t>(value));
 }
 
-uint32_t UART::read32(uint32_t offset) const {
-    if (offset % 4 != 0) return 0;
-    
-    uint32_t value = 0;
-    value |= static_cast<uint32_t>(read8(offset));
-    value |= static_cast<uint32_t>(read8(offset + 1)) << 8;
-    value |= static_cast<uint32_t>(read8(offset + 2)) << 16;
-    value |= static_cast<uint32_t>(read8(offset + 3)) << 24;
-    return value;
-}
-
-void UART::write8(uint32_t offset, uint8_t value) {
-    switch (offset) {
-        case UART_DATA_OFFSET:
-            dataRegister = value;
-            sendByte(value);
-            break;
-        case UART_STATUS_OFFSET:
-            statusRegister = value;
-            break;
-        case UART_CONTROL_OFFSET:
-            controlRegister = value;
-            break;
-        case UART_BAUD_OFFSET:
-            baudRateRegister = (baudRateRegister & 0xFFFFFF00) | value;
-            break;
-    }
-}
-
-void UART::write16(uint32_t offset, uint16_t value) {
-    if (offset % 2 != 0) return;
+void UART::writeDmaControl(uint32_t value) {
+    if (value & DMA_CONTROL_TX_START) {
+        startTxDma();
+    }
+    if (value & DMA_CONTROL_RX_ARM) {
+        dmaRxCountRegister = 0;
+        dmaStatusRegister &= ~DMA_STATUS_RX_DONE;
+        rxDmaArmed = true;
+        serviceRxDma();
+    }
+    dmaControlRegister = 0;
+}
+
+void UART::startTxDma() {
+    // The guest picks the length, so it is checked before anything is sized by it
+    uint32_t length = dmaTxLengthRegister;
+    if (length == 0 || length > MAX_DMA_LENGTH) {
+        dmaStatusRegister |= DMA_STATUS_ERROR;
+        return;
+    }
     
-    write8(offset, value & 0xFF);
-    write8(offset + 1, (value >> 8) & 0xFF);
+    if (const uint8_t* span = memory ? memory->ramSpan(dmaTxAddressRegister, length) : nullptr) {
+        for (uint32_t i = 0; i < length; i++) {
+            sendByte(span[i]);
+        }
+    } else {
+        // Flash or split sources go through the bounded bulk copy
+        std::vector<uint8_t> buffer(length);
+        if (!dmaRead(dmaTxAddressRegister, buffer.data(), buffer.size())) {
+            dmaStatusRegister |= DMA_STATUS_ERROR;
+            return;
+        }
+        for (uint8_t byte : buffer) {
+            sendByte(byte);
+        }
+    }
+    dmaStatusRegister |= DMA_STATUS_TX_DONE;
 }
 
-void UART::write32(uint32_t offset, uint32_t value) {
-    if (offset % 4 != 0) return;
+// Moves whatever RX data has arrived into the armed buffer. The transfer
+// completes once the buffer is full or the FIFO runs dry, which stands in
+// for the hardware's idle-line timeout.
+void UART::serviceRxDma() {
+    if (!rxDmaArmed || rxBuffer.empty()) return;
+    
+    // Bytes leave the FIFO only once they've landed, so a faulting
+    // transfer leaves them for the next attempt or a register read
+    uint32_t space = dmaRxLengthRegister - dmaRxCountRegister;
+    size_t count = std::min<size_t>(space, rxBuffer.size());
     
-    write8(offset, value & 0xFF);
-    write8(offset + 1, (value >> 8) & 0xFF);
-    write8(offset + 2, (value >> 16) & 0xFF);
-    write8(offset + 3, (value >> 24) & 0xFF);
+    rxDmaArmed = false;
+    if (!dmaWrite(dmaRxAddressRegister + dmaRxCountRegister, rxBuffer.contiguous(count), count)) {
+        dmaStatusRegister |= DMA_STATUS_ERROR;
+        return;
+    }
+    rxBuffer.pop(count);
+    rxReady = !rxBuffer.empty();
+    dmaRxCountRegister += static_cast<uint32_t>(count);
+    dmaStatusRegister |= DMA_STATUS_RX_DONE;
 }
 
 void UART::reset() {
-    dataRegister = 0;
-    statusRegister = 0;
-    controlRegister = 0;
-    baudRateRegister = 115200;
+    resetRegisters();
+    dmaStatusRegister = 0;
+    rxDmaArmed = false;
     txReady = true;
     rxReady = false;
     
     while (!txBuffer.empty()) txBuffer.pop();
-    while (!rxBuffer.empty()) rxBuffer.pop();
+    rxBuffer.clear();
 }
 
 void UART::update() {
+    if (rxDmaArmed && !rxBuffer.empty()) {
+        serviceRxDma();
+    }
+    
     if (txReady) {
         statusRegister |= 0x01;  
     } else {
@@ -104,16 +133,64 @@ void UART::update() {
     }
 }
 
+void UART::saveState(std::vector<uint8_t>& out) const {
+    putState(out, dataRegister);
+    putState(out, statusRegister);
+    putState(out, controlRegister);
+    putState(out, baudRateRegister);
+    putState(out, txReady);
+    putState(out, rxReady);
+    
+    for (uint32_t value : {dmaTxAddressRegister, dmaTxLengthRegister, dmaRxAddressRegister,
+                           dmaRxLengthRegister, dmaStatusRegister, dmaRxCountRegister}) {
+        putState(out, value);
+    }
+    putState(out, rxDmaArmed);
+    
+    putState(out, static_cast<uint32_t>(rxBuffer.size()));
+    for (size_t i = 0; i < rxBuffer.size(); i++) {
+        putState(out, rxBuffer[i]);
+    }
+}
+
+void UART::loadState(const uint8_t* data, size_t length) {
+    const uint8_t* end = data + length;
+    dataRegister = takeState<uint32_t>(data, end);
+    statusRegister = takeState<uint32_t>(data, end);
+    controlRegister = takeState<uint32_t>(data, end);
+    baudRateRegister = takeState<uint32_t>(data, end);
+    txReady = takeState<bool>(data, end);
+    rxReady = takeState<bool>(data, end);
+    
+    for (uint32_t* value : {&dmaTxAddressRegister, &dmaTxLengthRegister, &dmaRxAddressRegister,
+                            &dmaRxLengthRegister, &dmaStatusRegister, &dmaRxCountRegister}) {
+        *value = takeState<uint32_t>(data, end);
+    }
+    rxDmaArmed = takeState<bool>(data, end);
+    
+    rxBuffer.clear();
+    uint32_t pending = takeState<uint32_t>(data, end);
+    for (uint32_t i = 0; i < pending; i++) {
+        rxBuffer.push(takeState<uint8_t>(data, end));
+    }
+}
+
 void UART::dumpRegisters() const {
     std::cout << "UART Registers:" << std::endl;
     std::cout << "  Data:      0x" << std::hex << std::setw(8) << std::setfill('0') << dataRegister << std::dec << std::endl;
     std::cout << "  Status:    0x" << std::hex << std::setw(8) << std::setfill('0') << statusRegister << std::dec << std::endl;
     std::cout << "  Control:   0x" << std::hex << std::setw(8) << std::setfill('0') << controlRegister << std::dec << std::endl;
     std::cout << "  Baud Rate: 0x" << std::hex << std::setw(8) << std::setfill('0') << baudRateRegister << std::dec << std::endl;
+    std::cout << "  DMA:       0x" << std::hex << std::setw(8) << std::setfill('0') << dmaStatusRegister << std::dec
+              << (rxDmaArmed ? " (RX armed)" : "") << std::endl;
 }
 
 void UART::sendByte(uint8_t byte) {
-    // For now, just print to console
+    if (outputCallback) {
+        outputCallback(byte);
+        return;
+    }
+    
     std::cout << static_cast<char>(byte);
     std::cout.flush();
 }
@@ -125,6 +202,7 @@ uint8_t UART::receiveByte() {
     
     uint8_t byte = rxBuffer.front();
     rxBuffer.pop();
+    rxReady = !rxBuffer.empty();
     return byte;
 }
 
@@ -136,4 +214,13 @@ void UART::print(const std::string& message) {
     for (char c : message) {
         sendByte(static_cast<uint8_t>(c));
     }
-} 
\ No newline at end of file
+}
+
+void UART::injectRx(const uint8_t* data, size_t length) {
+    rxBuffer.push(data, length);
+    rxReady = !rxBuffer.empty();
+}
+
+void UART::setOutputCallback(std::function<void(uint8_t)> callback) {
+    outputCallback = callback;
+}
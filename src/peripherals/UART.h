@@ -1,45 +1,87 @@
 #pragma once
 
-#include "Peripheral.h"
+#include "RegisterMap.h"
+#include "../ByteRing.h"
 #include <queue>
 #include <string>
+#include <functional>
 
 
-class UART : public Peripheral {
+class UART : public MappedPeripheral<UART> {
 private:
+    friend class MappedPeripheral<UART>;
+    
     uint32_t dataRegister;      
     uint32_t statusRegister;    
     uint32_t controlRegister;  
     uint32_t baudRateRegister;  
+    uint32_t dmaTxAddressRegister;
+    uint32_t dmaTxLengthRegister;
+    uint32_t dmaRxAddressRegister;
+    uint32_t dmaRxLengthRegister;
+    uint32_t dmaControlRegister;
+    uint32_t dmaStatusRegister;
+    uint32_t dmaStatusClearRegister;
+    uint32_t dmaRxCountRegister;
+    
+    bool rxDmaArmed;
     
     std::queue<uint8_t> txBuffer;
-    std::queue<uint8_t> rxBuffer;
+    mutable ByteRing rxBuffer;             // Guest reads of the data register drain it
     bool txReady;
-    bool rxReady;
+    mutable bool rxReady;
+    
+    std::function<void(uint8_t)> outputCallback;
     
     static constexpr uint32_t UART_DATA_OFFSET = 0x00;
     static constexpr uint32_t UART_STATUS_OFFSET = 0x04;
     static constexpr uint32_t UART_CONTROL_OFFSET = 0x08;
     static constexpr uint32_t UART_BAUD_OFFSET = 0x0C;
+    static constexpr uint32_t UART_DMA_TX_ADDRESS_OFFSET = 0x10;
+    static constexpr uint32_t UART_DMA_TX_LENGTH_OFFSET = 0x14;
+    static constexpr uint32_t UART_DMA_RX_ADDRESS_OFFSET = 0x18;
+    static constexpr uint32_t UART_DMA_RX_LENGTH_OFFSET = 0x1C;
+    static constexpr uint32_t UART_DMA_CONTROL_OFFSET = 0x20;
+    static constexpr uint32_t UART_DMA_STATUS_OFFSET = 0x24;
+    static constexpr uint32_t UART_DMA_RX_COUNT_OFFSET = 0x28;
+    
+    static constexpr uint32_t DMA_CONTROL_TX_START = 0x01;
+    static constexpr uint32_t DMA_CONTROL_RX_ARM = 0x02;
+    static constexpr uint32_t DMA_STATUS_TX_DONE = 0x01;
+    static constexpr uint32_t DMA_STATUS_RX_DONE = 0x02;
+    static constexpr uint32_t DMA_STATUS_ERROR = 0x04;
+    
+    // Host-injected input beyond this is dropped as an RX overrun
+    static constexpr size_t RX_CAPACITY = 1 << 16;
+    
+    static const RegisterMap<UART, 11> registerMap;
+    
+    uint32_t readData() const;
+    void writeData(uint32_t value);
+    void writeDmaControl(uint32_t value);
+    uint32_t readDmaStatus() const { return dmaStatusRegister; }
+    void clearDmaStatus(uint32_t value) { dmaStatusRegister &= ~value; }
+    void startTxDma();
+    void serviceRxDma();
 
 public:
-    UART();
-    ~UART() = default;
-
-    uint8_t read8(uint32_t offset) const override;
-    uint16_t read16(uint32_t offset) const override;
-    uint32_t read32(uint32_t offset) const override;
+    static constexpr uint32_t DEFAULT_BASE = 0x3FF40000;
     
-    void write8(uint32_t offset, uint8_t value) override;
-    void write16(uint32_t offset, uint16_t value) override;
-    void write32(uint32_t offset, uint32_t value) override;
+    explicit UART(uint32_t baseAddress = DEFAULT_BASE, bool quiet = false);
+    ~UART() = default;
     
     void reset() override;
     void update() override;
+    bool interruptPending() const override { return rxReady || dmaStatusRegister; }
+    void saveState(std::vector<uint8_t>& out) const override;
+    void loadState(const uint8_t* data, size_t length) override;
     void dumpRegisters() const override;
     
     void sendByte(uint8_t byte);
     uint8_t receiveByte();
     bool hasData() const;
     void print(const std::string& message);
+    
+    void injectRx(const uint8_t* data, size_t length);
+    void setOutputCallback(std::function<void(uint8_t)> callback);
 }; 
\ No newline at end of file
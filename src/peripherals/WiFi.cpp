@@ -1,111 +1,241 @@
 #include "WiFi.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstring>
 
-WiFi::WiFi() : Peripheral(0x3FF50000, 0x100),
-               controlRegister(0), statusRegister(0),
-               dataRegister(0), addressRegister(0),
-               responseRegister(0), connected(false),
-               requestPending(false) {
-    std::cout << "WiFi peripheral initialized at 0x" << std::hex << baseAddress << std::dec << std::endl;
-}
-
-uint8_t WiFi::read8(uint32_t offset) const {
-    switch (offset) {
-        case WIFI_CONTROL_OFFSET:
-            return controlRegister & 0xFF;
-        case WIFI_STATUS_OFFSET:
-            return statusRegister & 0xFF;
-        case WIFI_DATA_OFFSET:
-            return dataRegister & 0xFF;
-        case WIFI_ADDRESS_OFFSET:
-            return addressRegister & 0xFF;
-        case WIFI_RESPONSE_OFFSET:
-            return responseRegister & 0xFF;
-        default:
-            return 0;
-    }
-}
-
-uint16_t WiFi::read16(uint32_t offset) const {
-    if (offset % 2 != 0) return 0;
-    
-    uint16_t value = 0;
-    value |= static_cast<uint16_t>(read8(offset));
-    value |= static_cast<uint16_t>(read8(offset + 1)) << 8;
-    return value;
-}
-
-uint32_t WiFi::read32(uint32_t offset) const {
-    if (offset % 4 != 0) return 0;
-    
-    uint32_t value = 0;
-    value |= static_cast<uint32_t>(read8(offset));
-    value |= static_cast<uint32_t>(read8(offset + 1)) << 8;
-    value |= static_cast<uint32_t>(read8(offset + 2)) << 16;
-    value |= static_cast<uint32_t>(read8(offset + 3)) << 24;
-    return value;
-}
-
-void WiFi::write8(uint32_t offset, uint8_t value) {
-    switch (offset) {
-        case WIFI_CONTROL_OFFSET:
-            controlRegister = value;
-            if (value & 0x01) {  
-                connect();
-            }
-            if (value & 0x02) {  
-                disconnect();
-            }
-            if (value & 0x04) { 
-                std::cout << "WiFi: HTTP request triggered" << std::endl;
-            }
-            break;
-        case WIFI_STATUS_OFFSET:
-            statusRegister = value;
-            break;
-        case WIFI_DATA_OFFSET:
-            dataRegister = value;
-            break;
-        case WIFI_ADDRESS_OFFSET:
-            addressRegister = (addressRegister & 0xFFFFFF00) | value;
-            break;
-        case WIFI_RESPONSE_OFFSET:
-            responseRegister = value;
-            break;
+constexpr RegisterMap<WiFi, 17> WiFi::registerMap({
+    {.offset = WIFI_CONTROL_OFFSET, .width = 1, .storage = &WiFi::controlRegister,
+     .onWrite = &WiFi::writeControl},
+    {.offset = WIFI_STATUS_OFFSET, .width = 1, .storage = &WiFi::statusRegister},
+    {.offset = WIFI_DATA_OFFSET, .width = 1, .storage = &WiFi::dataRegister,
+     .onWrite = &WiFi::writeData},
+    {.offset = WIFI_ADDRESS_OFFSET, .storage = &WiFi::addressRegister},
+    {.offset = WIFI_RESPONSE_OFFSET, .width = 1, .writeMask = 0, .storage = &WiFi::responseRegister,
+     .onRead = &WiFi::readResponse},
+    {.offset = WIFI_NET_TX_DATA_OFFSET, .width = 1, .storage = &WiFi::netTxDataRegister,
+     .onWrite = &WiFi::writeNetTxData},
+    {.offset = WIFI_NET_DEST_OFFSET, .width = 2, .storage = &WiFi::netDestRegister},
+    {.offset = WIFI_NET_CONTROL_OFFSET, .width = 1, .storage = &WiFi::netControlRegister,
+     .onWrite = &WiFi::writeNetControl},
+    {.offset = WIFI_NET_RX_DATA_OFFSET, .width = 1, .writeMask = 0, .storage = &WiFi::netRxDataRegister,
+     .onRead = &WiFi::readNetRxData},
+    {.offset = WIFI_NET_RX_LENGTH_OFFSET, .width = 2, .writeMask = 0, .storage = &WiFi::netRxLengthRegister,
+     .onRead = &WiFi::readNetRxLength},
+    {.offset = WIFI_NET_RX_SOURCE_OFFSET, .width = 2, .writeMask = 0, .storage = &WiFi::netRxSourceRegister},
+    {.offset = WIFI_NET_NODE_OFFSET, .width = 2, .writeMask = 0, .storage = &WiFi::netNodeRegister},
+    {.offset = WIFI_DMA_ADDRESS_OFFSET, .storage = &WiFi::dmaAddressRegister},
+    {.offset = WIFI_DMA_LENGTH_OFFSET, .storage = &WiFi::dmaLengthRegister},
+    {.offset = WIFI_DMA_CONTROL_OFFSET, .width = 1, .storage = &WiFi::dmaControlRegister,
+     .onWrite = &WiFi::writeDmaControl},
+    // Write 1 to clear; the written value is only scratch
+    {.offset = WIFI_DMA_STATUS_OFFSET, .width = 1, .storage = &WiFi::dmaStatusClearRegister,
+     .onRead = &WiFi::readDmaStatus, .onWrite = &WiFi::clearDmaStatus},
+    {.offset = WIFI_DMA_COUNT_OFFSET, .writeMask = 0, .storage = &WiFi::dmaCountRegister},
+});
+
+WiFi::WiFi(uint32_t baseAddress, bool quiet) : MappedPeripheral(baseAddress, 0x100), dmaStatusRegister(0),
+                                   connected(false), requestPending(false), quiet(quiet),
+                                   responseBuffer(RESPONSE_CAPACITY), httpInbox(std::make_shared<HttpInbox>()),
+                                   requestsInFlight(0), networkPort(nullptr), rxPosition(0) {
+    resetRegisters();
+    // Frames are reassigned on every restore; this keeps that from allocating
+    txFrame.reserve(VirtualNetwork::MAX_PAYLOAD);
+    rxFrame.reserve(VirtualNetwork::MAX_PAYLOAD);
+    if (!quiet) std::cout << "WiFi peripheral initialized at 0x" << std::hex << baseAddress << std::dec << std::endl;
+}
+
+void WiFi::writeControl(uint32_t value) {
+    if (value & 0x01) {  
+        connect();
+    }
+    if (value & 0x02) {  
+        disconnect();
+    }
+    if (value & 0x04) { 
+        sendHttpRequest(urlBuffer);
+        urlBuffer.clear();
     }
 }
 
-void WiFi::write16(uint32_t offset, uint16_t value) {
-    if (offset % 2 != 0) return;
+void WiFi::writeData(uint32_t value) {
+    if (urlBuffer.size() < MAX_URL_LENGTH) {
+        urlBuffer.push_back(static_cast<char>(value));
+    }
+}
+
+uint32_t WiFi::readResponse() const {
+    if (responseBuffer.empty()) return 0;
     
-    write8(offset, value & 0xFF);
-    write8(offset + 1, (value >> 8) & 0xFF);
+    uint8_t byte = responseBuffer.front();
+    responseBuffer.pop();
+    return byte;
 }
 
-void WiFi::write32(uint32_t offset, uint32_t value) {
-    if (offset % 4 != 0) return;
+void WiFi::collectResponses() {
+    std::lock_guard<std::mutex> lock(httpInbox->mutex);
+    httpInbox->ready = false;
     
-    write8(offset, value & 0xFF);
-    write8(offset + 1, (value >> 8) & 0xFF);
-    write8(offset + 2, (value >> 16) & 0xFF);
-    write8(offset + 3, (value >> 24) & 0xFF);
+    for (auto& response : httpInbox->responses) {
+        requestsInFlight--;
+        if (response.ok) {
+            responseBuffer.push(reinterpret_cast<const uint8_t*>(response.data.data()), response.data.size());
+        } else {
+            statusRegister |= STATUS_HTTP_ERROR;
+            if (!quiet) std::cout << "WiFi: HTTP request failed: " << response.data << std::endl;
+        }
+    }
+    httpInbox->responses.clear();
+    requestPending = requestsInFlight > 0;
+}
+
+void WiFi::dropHttpReplies() {
+    std::lock_guard<std::mutex> lock(httpInbox->mutex);
+    httpInbox->generation++;
+    httpInbox->responses.clear();
+    httpInbox->ready = false;
+    requestsInFlight = 0;
+}
+
+void WiFi::setHttpBackend(std::shared_ptr<HttpBackend> backend) {
+    httpBackend = std::move(backend);
+}
+
+void WiFi::writeNetTxData(uint32_t value) {
+    if (txFrame.size() < VirtualNetwork::MAX_PAYLOAD) {
+        txFrame.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+void WiFi::writeNetControl(uint32_t value) {
+    if (value & NET_CONTROL_SEND) {
+        sendFrame();
+    }
+    if (value & NET_CONTROL_DROP_RX) {
+        rxPosition = rxFrame.size();
+    }
+    netControlRegister = 0;
+}
+
+uint32_t WiFi::readNetRxData() const {
+    return rxPosition < rxFrame.size() ? rxFrame[rxPosition++] : 0;
+}
+
+uint32_t WiFi::readNetRxLength() const {
+    return static_cast<uint32_t>(rxFrame.size() - rxPosition);
+}
+
+void WiFi::sendFrame() {
+    if (!networkPort || !connected) {
+        if (!quiet) std::cout << "WiFi: Not connected, dropping " << txFrame.size() << " byte frame" << std::endl;
+    } else if (!txFrame.empty()) {
+        networkPort->send(static_cast<uint16_t>(netDestRegister), txFrame.data(), txFrame.size());
+    }
+    txFrame.clear();
+}
+
+void WiFi::pollNetwork() {
+    const VirtualNetwork::Packet* packet = networkPort->peek();
+    if (!packet) return;
+    
+    rxFrame.assign(packet->data, packet->data + packet->length);
+    rxPosition = 0;
+    netRxSourceRegister = packet->source;
+    networkPort->consume();
+}
+
+void WiFi::writeDmaControl(uint32_t value) {
+    dmaControlRegister = 0;
+    
+    for (uint32_t operation = 1; operation <= DMA_MEMORY_TO_REQUEST; operation <<= 1) {
+        if (!(value & operation)) continue;
+        
+        dmaStatusRegister &= ~DMA_STATUS_DONE;
+        dmaStatusRegister |= runDma(operation) ? DMA_STATUS_DONE : DMA_STATUS_ERROR;
+    }
+}
+
+// Copies between guest memory and the WiFi buffers in one bulk operation.
+// Transfers into memory move at most DMA length bytes and report how many
+// they moved in the count register.
+bool WiFi::runDma(uint32_t operation) {
+    dmaCountRegister = 0;
+    
+    switch (operation) {
+        case DMA_RESPONSE_TO_MEMORY: {
+            // Bytes stay buffered unless the write lands
+            size_t count = std::min<size_t>(dmaLengthRegister, responseBuffer.size());
+            if (!dmaWrite(dmaAddressRegister, responseBuffer.contiguous(count), count)) return false;
+            responseBuffer.pop(count);
+            dmaCountRegister = static_cast<uint32_t>(count);
+            return true;
+        }
+        
+        case DMA_MEMORY_TO_FRAME: {
+            if (dmaLengthRegister > VirtualNetwork::MAX_PAYLOAD) return false;
+            txFrame.resize(dmaLengthRegister);
+            if (!dmaRead(dmaAddressRegister, txFrame.data(), txFrame.size())) {
+                txFrame.clear();
+                return false;
+            }
+            dmaCountRegister = dmaLengthRegister;
+            sendFrame();
+            return true;
+        }
+        
+        case DMA_FRAME_TO_MEMORY: {
+            size_t count = std::min<size_t>(dmaLengthRegister, rxFrame.size() - rxPosition);
+            if (!dmaWrite(dmaAddressRegister, rxFrame.data() + rxPosition, count)) return false;
+            rxPosition += count;
+            dmaCountRegister = static_cast<uint32_t>(count);
+            return true;
+        }
+        
+        case DMA_MEMORY_TO_REQUEST: {
+            // The guest picks the length, so nothing is sized by it until it is checked
+            if (dmaLengthRegister > MAX_URL_LENGTH) return false;
+            char url[MAX_URL_LENGTH];
+            if (!dmaRead(dmaAddressRegister, reinterpret_cast<uint8_t*>(url), dmaLengthRegister)) return false;
+            dmaCountRegister = dmaLengthRegister;
+            return sendHttpRequest(std::string(url, strnlen(url, dmaLengthRegister)));
+        }
+    }
+    return false;
+}
+
+void WiFi::attachNetwork(VirtualNetwork::Port* port) {
+    networkPort = port;
+    netNodeRegister = port ? port->getId() : 0;
 }
 
 void WiFi::reset() {
-    controlRegister = 0;
-    statusRegister = 0;
-    dataRegister = 0;
-    addressRegister = 0;
-    responseRegister = 0;
+    resetRegisters();
     connected = false;
     requestPending = false;
     currentUrl.clear();
+    urlBuffer.clear();
+    
+    responseBuffer.clear();
+    
+    // Replies to requests issued before the reset are stale
+    dropHttpReplies();
     
-    while (!responseBuffer.empty()) responseBuffer.pop();
+    txFrame.clear();
+    rxFrame.clear();
+    rxPosition = 0;
+    dmaStatusRegister = 0;
+    netNodeRegister = networkPort ? networkPort->getId() : 0;
+    // Frames queued before the reset are stamped with the old clock
+    if (networkPort) {
+        networkPort->drain();
+    }
 }
 
 void WiFi::update() {
+    if (httpInbox->ready.load(std::memory_order_acquire)) {
+        collectResponses();
+    }
+    
     if (connected) {
         statusRegister |= 0x01; 
     } else {
@@ -123,6 +253,93 @@ void WiFi::update() {
     } else {
         statusRegister &= ~0x04;
     }
+    
+    if (networkPort && rxPosition >= rxFrame.size()) {
+        pollNetwork();
+    }
+    if (rxPosition < rxFrame.size()) {
+        statusRegister |= STATUS_NET_RX_READY;
+    } else {
+        statusRegister &= ~STATUS_NET_RX_READY;
+    }
+}
+
+void WiFi::saveState(std::vector<uint8_t>& out) const {
+    putState(out, controlRegister);
+    putState(out, statusRegister);
+    putState(out, dataRegister);
+    putState(out, addressRegister);
+    putState(out, responseRegister);
+    putState(out, connected);
+    putState(out, requestPending);
+    
+    for (const std::string* text : {&currentUrl, &urlBuffer}) {
+        putState(out, static_cast<uint32_t>(text->size()));
+        out.insert(out.end(), text->begin(), text->end());
+    }
+    
+    putState(out, static_cast<uint32_t>(responseBuffer.size()));
+    for (size_t i = 0; i < responseBuffer.size(); i++) {
+        putState(out, responseBuffer[i]);
+    }
+    
+    // Packets still in flight belong to the network, not the snapshot
+    putState(out, netDestRegister);
+    putState(out, netRxSourceRegister);
+    putState(out, dmaAddressRegister);
+    putState(out, dmaLengthRegister);
+    putState(out, dmaStatusRegister);
+    putState(out, dmaCountRegister);
+    putState(out, static_cast<uint32_t>(txFrame.size()));
+    out.insert(out.end(), txFrame.begin(), txFrame.end());
+    putState(out, static_cast<uint32_t>(rxFrame.size() - rxPosition));
+    out.insert(out.end(), rxFrame.begin() + rxPosition, rxFrame.end());
+}
+
+void WiFi::loadState(const uint8_t* data, size_t length) {
+    const uint8_t* end = data + length;
+    controlRegister = takeState<uint32_t>(data, end);
+    statusRegister = takeState<uint32_t>(data, end);
+    dataRegister = takeState<uint32_t>(data, end);
+    addressRegister = takeState<uint32_t>(data, end);
+    responseRegister = takeState<uint32_t>(data, end);
+    connected = takeState<bool>(data, end);
+    requestPending = takeState<bool>(data, end);
+    
+    for (std::string* text : {&currentUrl, &urlBuffer}) {
+        uint32_t textLength = takeState<uint32_t>(data, end);
+        if (static_cast<size_t>(end - data) < textLength) {
+            throw std::runtime_error("Truncated WiFi state");
+        }
+        text->assign(reinterpret_cast<const char*>(data), textLength);
+        data += textLength;
+    }
+    
+    // Requests in flight when the state was saved are not replayed
+    dropHttpReplies();
+    requestPending = false;
+    
+    responseBuffer.clear();
+    uint32_t pending = takeState<uint32_t>(data, end);
+    for (uint32_t i = 0; i < pending; i++) {
+        responseBuffer.push(takeState<uint8_t>(data, end));
+    }
+    
+    netDestRegister = takeState<uint32_t>(data, end);
+    netRxSourceRegister = takeState<uint32_t>(data, end);
+    dmaAddressRegister = takeState<uint32_t>(data, end);
+    dmaLengthRegister = takeState<uint32_t>(data, end);
+    dmaStatusRegister = takeState<uint32_t>(data, end);
+    dmaCountRegister = takeState<uint32_t>(data, end);
+    for (std::vector<uint8_t>* frame : {&txFrame, &rxFrame}) {
+        uint32_t frameLength = takeState<uint32_t>(data, end);
+        if (static_cast<size_t>(end - data) < frameLength) {
+            throw std::runtime_error("Truncated WiFi state");
+        }
+        frame->assign(data, data + frameLength);
+        data += frameLength;
+    }
+    rxPosition = 0;
 }
 
 void WiFi::dumpRegisters() const {
@@ -133,43 +350,57 @@ void WiFi::dumpRegisters() const {
     std::cout << "  Address:   0x" << std::hex << std::setw(8) << std::setfill('0') << addressRegister << std::dec << std::endl;
     std::cout << "  Response:  0x" << std::hex << std::setw(8) << std::setfill('0') << responseRegister << std::dec << std::endl;
     std::cout << "  Connected: " << (connected ? "Yes" : "No") << std::endl;
+    if (networkPort) {
+        std::cout << "  Node:      " << networkPort->getId() << " (rx frame " << (rxFrame.size() - rxPosition)
+                  << " bytes, " << networkPort->getDropped() << " dropped)" << std::endl;
+    }
 }
 
 bool WiFi::connect() {
     connected = true;
-    std::cout << "WiFi: Connected to network" << std::endl;
+    if (!quiet) std::cout << "WiFi: Connected to network" << std::endl;
     return true;
 }
 
 void WiFi::disconnect() {
     connected = false;
-    std::cout << "WiFi: Disconnected from network" << std::endl;
+    if (!quiet) std::cout << "WiFi: Disconnected from network" << std::endl;
 }
 
 bool WiFi::sendHttpRequest(const std::string& url) {
     if (!connected) {
-        std::cout << "WiFi: Not connected, cannot send request" << std::endl;
+        if (!quiet) std::cout << "WiFi: Not connected, cannot send request" << std::endl;
         return false;
     }
     
     currentUrl = url;
     requestPending = true;
-    std::cout << "WiFi: Sending HTTP request to " << url << std::endl;
+    statusRegister &= ~STATUS_HTTP_ERROR;
+    if (!quiet) std::cout << "WiFi: Sending HTTP request to " << url << std::endl;
     
-    std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\nHello, World!";
-    for (char c : response) {
-        responseBuffer.push(static_cast<uint8_t>(c));
+    if (httpBackend) {
+        requestsInFlight++;
+        std::shared_ptr<HttpInbox> inbox = httpInbox;
+        uint32_t generation = httpInbox->generation;
+        httpBackend->get(url, [inbox, generation](HttpBackend::Response response) {
+            std::lock_guard<std::mutex> lock(inbox->mutex);
+            if (inbox->generation != generation) return;
+            inbox->responses.push_back(std::move(response));
+            inbox->ready.store(true, std::memory_order_release);
+        });
+        return true;
     }
     
+    static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\nHello, World!";
+    responseBuffer.push(reinterpret_cast<const uint8_t*>(response), sizeof(response) - 1);
+    
     requestPending = false;
     return true;
 }
 
 std::string WiFi::getResponse() {
-    std::string response;
-    while (!responseBuffer.empty()) {
-        response += static_cast<char>(responseBuffer.front());
-        responseBuffer.pop();
-    }
+    std::string response(reinterpret_cast<const char*>(responseBuffer.contiguous(responseBuffer.size())),
+                         responseBuffer.size());
+    responseBuffer.clear();
     return response;
 } 
\ No newline at end of file
@@ -1,44 +1,137 @@
 #pragma once
 
-#include "Peripheral.h"
+#include "RegisterMap.h"
+#include "../VirtualNetwork.h"
+#include "../HttpBackend.h"
+#include "../ByteRing.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <queue>
 
 
-class WiFi : public Peripheral {
+class WiFi : public MappedPeripheral<WiFi> {
 private:
+    friend class MappedPeripheral<WiFi>;
+    
     uint32_t controlRegister;    
     uint32_t statusRegister;     
     uint32_t dataRegister;       
     uint32_t addressRegister;   
     uint32_t responseRegister;  
+    uint32_t netTxDataRegister;
+    uint32_t netDestRegister;
+    uint32_t netControlRegister;
+    uint32_t netRxDataRegister;
+    uint32_t netRxLengthRegister;
+    uint32_t netRxSourceRegister;
+    uint32_t netNodeRegister;
+    uint32_t dmaAddressRegister;
+    uint32_t dmaLengthRegister;
+    uint32_t dmaControlRegister;
+    uint32_t dmaStatusRegister;
+    uint32_t dmaStatusClearRegister;
+    uint32_t dmaCountRegister;
     
     bool connected;
     bool requestPending;
+    bool quiet;                                    // Keeps connection and request logs off stdout
     std::string currentUrl;
-    std::queue<uint8_t> responseBuffer;
+    std::string urlBuffer;                         // Built up by guest data register writes
+    mutable ByteRing responseBuffer;               // Guest reads of the response register drain it
+    
+    // Responses come back on the backend's I/O thread and wait here until
+    // update() moves them into responseBuffer on the emulator thread. A
+    // reset or restore bumps the generation instead of replacing the inbox,
+    // and replies to requests from an older generation are dropped.
+    struct HttpInbox {
+        std::mutex mutex;
+        std::deque<HttpBackend::Response> responses;
+        uint32_t generation = 0;
+        std::atomic<bool> ready{false};
+    };
+    std::shared_ptr<HttpBackend> httpBackend;
+    std::shared_ptr<HttpInbox> httpInbox;
+    uint32_t requestsInFlight;
+    
+    // Virtual network frames: the guest appends bytes to txFrame and sends
+    // it whole; received frames are read a byte at a time from rxFrame
+    VirtualNetwork::Port* networkPort;
+    std::vector<uint8_t> txFrame;
+    std::vector<uint8_t> rxFrame;
+    mutable size_t rxPosition;
     
     static constexpr uint32_t WIFI_CONTROL_OFFSET = 0x00;
     static constexpr uint32_t WIFI_STATUS_OFFSET = 0x04;
     static constexpr uint32_t WIFI_DATA_OFFSET = 0x08;
     static constexpr uint32_t WIFI_ADDRESS_OFFSET = 0x0C;
     static constexpr uint32_t WIFI_RESPONSE_OFFSET = 0x10;
+    static constexpr uint32_t WIFI_NET_TX_DATA_OFFSET = 0x20;
+    static constexpr uint32_t WIFI_NET_DEST_OFFSET = 0x24;
+    static constexpr uint32_t WIFI_NET_CONTROL_OFFSET = 0x28;
+    static constexpr uint32_t WIFI_NET_RX_DATA_OFFSET = 0x2C;
+    static constexpr uint32_t WIFI_NET_RX_LENGTH_OFFSET = 0x30;
+    static constexpr uint32_t WIFI_NET_RX_SOURCE_OFFSET = 0x34;
+    static constexpr uint32_t WIFI_NET_NODE_OFFSET = 0x38;
+    static constexpr uint32_t WIFI_DMA_ADDRESS_OFFSET = 0x40;
+    static constexpr uint32_t WIFI_DMA_LENGTH_OFFSET = 0x44;
+    static constexpr uint32_t WIFI_DMA_CONTROL_OFFSET = 0x48;
+    static constexpr uint32_t WIFI_DMA_STATUS_OFFSET = 0x4C;
+    static constexpr uint32_t WIFI_DMA_COUNT_OFFSET = 0x50;
+    
+    static constexpr uint32_t STATUS_NET_RX_READY = 0x08;
+    static constexpr uint32_t STATUS_HTTP_ERROR = 0x10;
+    static constexpr uint32_t NET_CONTROL_SEND = 0x01;
+    static constexpr uint32_t NET_CONTROL_DROP_RX = 0x02;
+    
+    // DMA operations, one per control bit; each runs to completion at once
+    static constexpr uint32_t DMA_RESPONSE_TO_MEMORY = 0x01;
+    static constexpr uint32_t DMA_MEMORY_TO_FRAME = 0x02;
+    static constexpr uint32_t DMA_FRAME_TO_MEMORY = 0x04;
+    static constexpr uint32_t DMA_MEMORY_TO_REQUEST = 0x08;
+    static constexpr uint32_t DMA_STATUS_DONE = 0x01;
+    static constexpr uint32_t DMA_STATUS_ERROR = 0x02;
+    
+    // Room for one maximum-size reply; bytes past it are dropped
+    static constexpr size_t RESPONSE_CAPACITY = HttpBackend::MAX_RESPONSE;
+    // Longest URL either the data register or DMA can build; the data
+    // register drops bytes past it, DMA refuses the transfer
+    static constexpr uint32_t MAX_URL_LENGTH = 2048;
+    static_assert(MAX_URL_LENGTH <= MAX_DMA_LENGTH);
+    
+    static const RegisterMap<WiFi, 17> registerMap;
+    
+    void writeControl(uint32_t value);
+    void writeData(uint32_t value);
+    uint32_t readResponse() const;
+    void collectResponses();
+    void dropHttpReplies();
+    void writeNetTxData(uint32_t value);
+    void writeNetControl(uint32_t value);
+    uint32_t readNetRxData() const;
+    uint32_t readNetRxLength() const;
+    void sendFrame();
+    void writeDmaControl(uint32_t value);
+    uint32_t readDmaStatus() const { return dmaStatusRegister; }
+    void clearDmaStatus(uint32_t value) { dmaStatusRegister &= ~value; }
+    bool runDma(uint32_t operation);
+    void pollNetwork();
 
 public:
-    WiFi();
-    ~WiFi() = default;
-
-    uint8_t read8(uint32_t offset) const override;
-    uint16_t read16(uint32_t offset) const override;
-    uint32_t read32(uint32_t offset) const override;
+    static constexpr uint32_t DEFAULT_BASE = 0x3FF50000;
     
-    void write8(uint32_t offset, uint8_t value) override;
-    void write16(uint32_t offset, uint16_t value) override;
-    void write32(uint32_t offset, uint32_t value) override;
+    explicit WiFi(uint32_t baseAddress = DEFAULT_BASE, bool quiet = false);
+    ~WiFi() = default;
     
     void reset() override;
     void update() override;
+    bool interruptPending() const override {
+        return !responseBuffer.empty() || rxPosition < rxFrame.size() || dmaStatusRegister;
+    }
+    void saveState(std::vector<uint8_t>& out) const override;
+    void loadState(const uint8_t* data, size_t length) override;
     void dumpRegisters() const override;
     
     bool connect();
@@ -46,4 +139,13 @@ public:
     bool sendHttpRequest(const std::string& url);
     std::string getResponse();
     bool isConnected() const { return connected; }
+    
+    // Without a backend, requests get a canned "Hello, World!" reply
+    void setHttpBackend(std::shared_ptr<HttpBackend> backend);
+    
+    // The port's clock should be the owning emulator's cycle counter
+    void attachNetwork(VirtualNetwork::Port* port);
+    // Forgets the port, for when its network is going away first
+    void detachNetwork() { attachNetwork(nullptr); }
+    VirtualNetwork::Port* getNetworkPort() const { return networkPort; }
 }; 
\ No newline at end of file
@@ -0,0 +1,665 @@
+#include "vesp.h"
+#include "Emulator.h"
+#include "EmulatorPool.h"
+#include "Fuzzer.h"
+#include "ElfFile.h"
+#include "HttpBackend.h"
+#include "VirtualNetwork.h"
+#include "peripherals/UART.h"
+#include "peripherals/GPIO.h"
+#include "peripherals/WiFi.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <stdexcept>
+
+struct vesp_emulator {
+    // Either built for this handle or leased from a pool
+    std::unique_ptr<Emulator> owned;
+    EmulatorPool::Lease lease;
+    Emulator& emulator;
+    std::deque<uint8_t> uartOutput;
+    std::string lastError;
+    std::unique_ptr<Fuzzer> fuzzer;
+    vesp_network* network = nullptr;  // The one this instance is a node of
+
+    // Quiet: a library shouldn't write banners to the host's stdout
+    explicit vesp_emulator(const SocDescription& soc)
+        : owned(std::make_unique<Emulator>(soc, true)), emulator(*owned) {
+        captureUart();
+    }
+
+    explicit vesp_emulator(EmulatorPool::Lease leased) : lease(std::move(leased)), emulator(*lease) {
+        captureUart();
+    }
+
+    void captureUart() {
+        if (UART* uart = emulator.getUART()) {
+            uart->setOutputCallback([this](uint8_t byte) {
+                uartOutput.push_back(byte);
+            });
+        }
+    }
+};
+
+struct vesp_symbols {
+    std::shared_ptr<const SymbolIndex> index;
+};
+
+struct vesp_pool {
+    EmulatorPool pool;
+
+    vesp_pool(const SocDescription& soc, const std::vector<uint8_t>& firmware, size_t count)
+        : pool(soc, firmware, count) {}
+};
+
+struct vesp_http_backend {
+    std::shared_ptr<HttpBackend> backend;
+};
+
+struct vesp_network {
+    VirtualNetwork network;
+    std::vector<bool> hostNodes;
+    // Detached on destroy, so none keeps a pointer to a freed port
+    std::vector<vesp_emulator*> attached;
+
+    explicit vesp_network(uint64_t latency) : network(latency) {}
+
+    VirtualNetwork::Port* hostPort(unsigned node) const {
+        return node < hostNodes.size() && hostNodes[node] ? network.getPort(static_cast<uint16_t>(node)) : nullptr;
+    }
+};
+
+namespace {
+
+int fail(vesp_emulator* emu, vesp_status status, const std::string& message) {
+    emu->lastError = message;
+    return status;
+}
+
+}
+
+vesp_emulator* vesp_create(void) {
+    try {
+        return new vesp_emulator(SocDescription::esp32());
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+vesp_emulator* vesp_create_with_soc(const char* path) {
+    if (!path) return nullptr;
+
+    try {
+        return new vesp_emulator(SocDescription::load(path));
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void vesp_destroy(vesp_emulator* emu) {
+    if (emu && emu->network) {
+        // A pooled instance lives on, so it mustn't keep the port either
+        emu->emulator.detachNetwork();
+        auto& attached = emu->network->attached;
+        attached.erase(std::find(attached.begin(), attached.end(), emu));
+    }
+    delete emu;
+}
+
+vesp_pool* vesp_pool_create(const char* soc_path, const uint8_t* firmware, size_t size, size_t count) {
+    if (!firmware || size == 0) return nullptr;
+
+    try {
+        SocDescription soc = soc_path ? SocDescription::load(soc_path) : SocDescription::esp32();
+        return new vesp_pool(soc, std::vector<uint8_t>(firmware, firmware + size), count);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void vesp_pool_destroy(vesp_pool* pool) {
+    delete pool;
+}
+
+vesp_emulator* vesp_pool_acquire(vesp_pool* pool) {
+    if (!pool) return nullptr;
+
+    try {
+        return new vesp_emulator(pool->pool.acquire());
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+size_t vesp_pool_available(vesp_pool* pool) {
+    return pool ? pool->pool.available() : 0;
+}
+
+int vesp_load_firmware(vesp_emulator* emu, const uint8_t* data, size_t size) {
+    if (!emu || !data) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.loadFirmware(std::vector<uint8_t>(data, data + size));
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_MEMORY, e.what());
+    }
+    return VESP_OK;
+}
+
+uint64_t vesp_run(vesp_emulator* emu, uint64_t maxCycles) {
+    if (!emu) return 0;
+    return emu->emulator.runFor(maxCycles);
+}
+
+void vesp_stop(vesp_emulator* emu) {
+    if (emu) emu->emulator.stop();
+}
+
+int vesp_is_running(const vesp_emulator* emu) {
+    return emu && emu->emulator.isRunning();
+}
+
+uint64_t vesp_get_cycles(const vesp_emulator* emu) {
+    return emu ? emu->emulator.getCycles() : 0;
+}
+
+void vesp_pause(vesp_emulator* emu) {
+    if (emu) emu->emulator.post(Emulator::Command::Pause);
+}
+
+void vesp_unpause(vesp_emulator* emu) {
+    if (emu) emu->emulator.post(Emulator::Command::Resume);
+}
+
+void vesp_request_stop(vesp_emulator* emu) {
+    if (emu) emu->emulator.post(Emulator::Command::Stop);
+}
+
+int vesp_is_paused(const vesp_emulator* emu) {
+    return emu && emu->emulator.isPaused();
+}
+
+int vesp_peek_registers(vesp_emulator* emu, uint32_t regs[17], uint64_t* cycles) {
+    if (!emu || !regs) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.peek([&](const Emulator& emulator) {
+        const XtensaLX6* cpu = emulator.getCPU();
+        for (uint8_t i = 0; i < 16; i++) {
+            regs[i] = cpu->getRegister(i);
+        }
+        regs[16] = cpu->getPC();
+        if (cycles) *cycles = emulator.getCycles();
+    });
+    return VESP_OK;
+}
+
+int vesp_peek_memory(vesp_emulator* emu, uint32_t address, void* buffer, size_t length) {
+    if (!emu || (!buffer && length)) return VESP_ERROR_INVALID_ARGUMENT;
+
+    // Errors are carried out of the callback; it runs on the emulator thread
+    std::string error;
+    emu->emulator.peek([&](const Emulator& emulator) {
+        try {
+            emulator.getMemory()->readBytes(address, static_cast<uint8_t*>(buffer), length);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+    });
+    if (!error.empty()) {
+        return fail(emu, VESP_ERROR_MEMORY, error);
+    }
+    return VESP_OK;
+}
+
+int vesp_set_clock(vesp_emulator* emu, uint64_t hz) {
+    if (!emu || hz == 0) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.setClockFrequency(hz);
+    return VESP_OK;
+}
+
+int vesp_set_pacing(vesp_emulator* emu, int enabled) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.setPacing(enabled != 0);
+    return VESP_OK;
+}
+
+int vesp_set_idle_sleep(vesp_emulator* emu, int enabled) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.setIdleSleep(enabled != 0);
+    return VESP_OK;
+}
+
+int vesp_read_memory(vesp_emulator* emu, uint32_t address, void* buffer, size_t length) {
+    if (!emu || (!buffer && length)) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.getMemory()->readBytes(address, static_cast<uint8_t*>(buffer), length);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_MEMORY, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_write_memory(vesp_emulator* emu, uint32_t address, const void* buffer, size_t length) {
+    if (!emu || (!buffer && length)) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.getMemory()->writeBytes(address, static_cast<const uint8_t*>(buffer), length);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_MEMORY, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_get_register(const vesp_emulator* emu, unsigned reg, uint32_t* value) {
+    if (!emu || !value || reg > VESP_REG_PC) return VESP_ERROR_INVALID_ARGUMENT;
+
+    const XtensaLX6* cpu = emu->emulator.getCPU();
+    *value = (reg == VESP_REG_PC) ? cpu->getPC() : cpu->getRegister(static_cast<uint8_t>(reg));
+    return VESP_OK;
+}
+
+int vesp_set_register(vesp_emulator* emu, unsigned reg, uint32_t value) {
+    if (!emu || reg > VESP_REG_PC) return VESP_ERROR_INVALID_ARGUMENT;
+
+    XtensaLX6* cpu = emu->emulator.getCPU();
+    if (reg == VESP_REG_PC) {
+        cpu->setPC(value);
+    } else {
+        cpu->setRegister(static_cast<uint8_t>(reg), value);
+    }
+    return VESP_OK;
+}
+
+int vesp_uart_inject(vesp_emulator* emu, const uint8_t* data, size_t length) {
+    if (!emu || (!data && length)) return VESP_ERROR_INVALID_ARGUMENT;
+
+    UART* uart = emu->emulator.getUART();
+    if (!uart) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, "This SoC has no UART");
+    }
+    uart->injectRx(data, length);
+    return VESP_OK;
+}
+
+size_t vesp_uart_read(vesp_emulator* emu, uint8_t* buffer, size_t capacity) {
+    if (!emu || !buffer) return 0;
+
+    size_t count = std::min(capacity, emu->uartOutput.size());
+    std::copy_n(emu->uartOutput.begin(), count, buffer);
+    emu->uartOutput.erase(emu->uartOutput.begin(), emu->uartOutput.begin() + count);
+    return count;
+}
+
+size_t vesp_uart_pending(const vesp_emulator* emu) {
+    return emu ? emu->uartOutput.size() : 0;
+}
+
+const char* vesp_last_error(const vesp_emulator* emu) {
+    return emu ? emu->lastError.c_str() : "Invalid emulator handle";
+}
+
+vesp_symbols* vesp_symbols_load(const uint8_t* elf, size_t size) {
+    if (!elf) return nullptr;
+
+    try {
+        return new vesp_symbols{SymbolIndex::fromElf(ElfFile(std::vector<uint8_t>(elf, elf + size)))};
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void vesp_symbols_release(vesp_symbols* symbols) {
+    delete symbols;
+}
+
+int vesp_set_symbols(vesp_emulator* emu, const vesp_symbols* symbols) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.setSymbols(symbols ? symbols->index : nullptr);
+    return VESP_OK;
+}
+
+size_t vesp_symbolize(const vesp_symbols* symbols, uint32_t address, char* buffer, size_t capacity) {
+    if (!symbols) return 0;
+
+    std::string text = symbols->index->describe(address);
+    if (buffer && capacity) {
+        size_t count = std::min(capacity - 1, text.size());
+        std::memcpy(buffer, text.data(), count);
+        buffer[count] = '\0';
+    }
+    return text.size();
+}
+
+int vesp_intercepts_enable(vesp_emulator* emu) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        return static_cast<int>(emu->emulator.enableIntercepts()->size());
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+}
+
+namespace {
+
+GPIO* gpioOf(vesp_emulator* emu) {
+    GPIO* gpio = emu->emulator.getGPIO();
+    if (!gpio) {
+        fail(emu, VESP_ERROR_INVALID_ARGUMENT, "This SoC has no GPIO");
+    }
+    return gpio;
+}
+
+}
+
+int vesp_gpio_drive(vesp_emulator* emu, uint32_t mask, uint32_t levels) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    GPIO* gpio = gpioOf(emu);
+    if (!gpio) return VESP_ERROR_INVALID_ARGUMENT;
+    gpio->drive(mask, levels);
+    return VESP_OK;
+}
+
+int vesp_gpio_release(vesp_emulator* emu, uint32_t mask) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    GPIO* gpio = gpioOf(emu);
+    if (!gpio) return VESP_ERROR_INVALID_ARGUMENT;
+    gpio->release(mask);
+    return VESP_OK;
+}
+
+int vesp_gpio_levels(const vesp_emulator* emu, uint32_t* levels) {
+    if (!emu || !levels) return VESP_ERROR_INVALID_ARGUMENT;
+
+    const GPIO* gpio = emu->emulator.getGPIO();
+    if (!gpio) return VESP_ERROR_INVALID_ARGUMENT;
+    *levels = gpio->getLevels();
+    return VESP_OK;
+}
+
+int vesp_gpio_capture(vesp_emulator* emu, const char* vcd_path) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    GPIO* gpio = gpioOf(emu);
+    if (!gpio) return VESP_ERROR_INVALID_ARGUMENT;
+    try {
+        if (vcd_path) {
+            gpio->startCapture(vcd_path, emu->emulator.getClockFrequency());
+        } else {
+            gpio->stopCapture();
+        }
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_shm_attach(vesp_emulator* emu, const char* name, uint32_t data_size, uint32_t base_address) {
+    if (!emu || !name) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.attachSharedMemory(name, data_size, base_address);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_checkpoint_enable(vesp_emulator* emu, const char* path, uint64_t interval_cycles) {
+    if (!emu || !path || interval_cycles == 0) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.enableCheckpoints(path, interval_cycles);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_resume(vesp_emulator* emu, const char* path) {
+    if (!emu || !path) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.resume(path);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_MEMORY, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_coverage_enable(vesp_emulator* emu) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.enableCoverage();
+    return VESP_OK;
+}
+
+const uint8_t* vesp_coverage_bitmap(const vesp_emulator* emu, size_t* size) {
+    if (!emu || !emu->emulator.getCoverage()) return nullptr;
+
+    const Coverage* coverage = emu->emulator.getCoverage();
+    if (size) *size = coverage->size();
+    return coverage->data();
+}
+
+int vesp_coverage_merge(vesp_emulator* emu, const uint8_t* bitmap, size_t size) {
+    if (!emu || !bitmap || !emu->emulator.getCoverage()) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->emulator.getCoverage()->merge(bitmap, size);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_coverage_write_lcov(vesp_emulator* emu, const uint8_t* elf, size_t elf_size, const char* path) {
+    if (!emu || !elf || !path || !emu->emulator.getCoverage()) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            return fail(emu, VESP_ERROR_INVALID_ARGUMENT, std::string("Could not open ") + path);
+        }
+        emu->emulator.getCoverage()->writeLcov(ElfFile(std::vector<uint8_t>(elf, elf + elf_size)), out);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_fuzz_setup(vesp_emulator* emu, const vesp_fuzz_config* config) {
+    if (!emu || !config) return VESP_ERROR_INVALID_ARGUMENT;
+
+    Fuzzer::Config fuzzConfig;
+    fuzzConfig.entryAddress = config->entry_address;
+    fuzzConfig.exitAddress = config->exit_address;
+    fuzzConfig.maxCycles = config->max_cycles;
+    fuzzConfig.inputMode = (config->input_mode == VESP_FUZZ_INPUT_MEMORY)
+        ? Fuzzer::InputMode::Memory : Fuzzer::InputMode::UART;
+    fuzzConfig.inputAddress = config->input_address;
+    fuzzConfig.inputCapacity = config->input_capacity;
+
+    try {
+        emu->fuzzer.reset();
+        auto fuzzer = std::make_unique<Fuzzer>(emu->emulator, fuzzConfig);
+        if (!fuzzer->boot(config->max_boot_cycles)) {
+            return fail(emu, VESP_ERROR_EMULATION, "Firmware never reached the fuzz entry point");
+        }
+        emu->fuzzer = std::move(fuzzer);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_fuzz_set_coverage_map(vesp_emulator* emu, uint8_t* map, size_t size) {
+    if (!emu || !emu->fuzzer) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        emu->fuzzer->setCoverageMap(map, size);
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+    return VESP_OK;
+}
+
+int vesp_fuzz_attach_afl_map(vesp_emulator* emu) {
+    if (!emu || !emu->fuzzer) return VESP_ERROR_INVALID_ARGUMENT;
+
+    if (!emu->fuzzer->attachAflSharedMemory()) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, "No usable __AFL_SHM_ID segment");
+    }
+    return VESP_OK;
+}
+
+const uint8_t* vesp_fuzz_coverage_map(const vesp_emulator* emu, size_t* size) {
+    if (!emu || !emu->fuzzer) return nullptr;
+
+    if (size) *size = emu->fuzzer->getCoverageSize();
+    return emu->fuzzer->getCoverageMap();
+}
+
+int vesp_fuzz_run(vesp_emulator* emu, const uint8_t* data, size_t size) {
+    if (!emu || !emu->fuzzer || (!data && size)) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        switch (emu->fuzzer->runOne(data, size)) {
+            case Fuzzer::Result::Completed: return VESP_FUZZ_COMPLETED;
+            case Fuzzer::Result::Timeout: return VESP_FUZZ_TIMEOUT;
+            case Fuzzer::Result::Crashed: return VESP_FUZZ_CRASHED;
+        }
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_EMULATION, e.what());
+    }
+    return VESP_FUZZ_CRASHED;
+}
+
+vesp_http_backend* vesp_http_backend_create(void) {
+    try {
+        return new vesp_http_backend{std::make_shared<HttpBackend>()};
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void vesp_http_backend_release(vesp_http_backend* backend) {
+    delete backend;
+}
+
+int vesp_http_backend_add_endpoint(vesp_http_backend* backend, const char* host, const char* address, uint16_t port) {
+    if (!backend || !host || !address) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        backend->backend->addEndpoint(host, address, port);
+    } catch (const std::exception&) {
+        return VESP_ERROR_INVALID_ARGUMENT;
+    }
+    return VESP_OK;
+}
+
+int vesp_set_http_backend(vesp_emulator* emu, const vesp_http_backend* backend) {
+    if (!emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    emu->emulator.enableWiFi()->setHttpBackend(backend ? backend->backend : nullptr);
+    return VESP_OK;
+}
+
+vesp_network* vesp_network_create(uint64_t latency_cycles) {
+    try {
+        return new vesp_network(latency_cycles);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void vesp_network_destroy(vesp_network* network) {
+    if (!network) return;
+    
+    network->network.stop();
+    for (vesp_emulator* emu : network->attached) {
+        emu->emulator.detachNetwork();
+        emu->network = nullptr;
+    }
+    delete network;
+}
+
+int vesp_network_attach(vesp_network* network, vesp_emulator* emu) {
+    if (!network || !emu) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        if (emu->network) {
+            return fail(emu, VESP_ERROR_INVALID_ARGUMENT, "Emulator is already on a network");
+        }
+        uint16_t node = emu->emulator.attachNetwork(network->network);
+        network->hostNodes.resize(node + 1, false);
+        network->attached.push_back(emu);
+        emu->network = network;
+        return node;
+    } catch (const std::exception& e) {
+        return fail(emu, VESP_ERROR_INVALID_ARGUMENT, e.what());
+    }
+}
+
+int vesp_network_add_host(vesp_network* network) {
+    if (!network) return VESP_ERROR_INVALID_ARGUMENT;
+
+    try {
+        uint16_t node = network->network.createPort()->getId();
+        network->hostNodes.resize(node + 1, false);
+        network->hostNodes[node] = true;
+        return node;
+    } catch (const std::exception&) {
+        return VESP_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+int vesp_network_start(vesp_network* network) {
+    if (!network) return VESP_ERROR_INVALID_ARGUMENT;
+
+    network->network.start();
+    return VESP_OK;
+}
+
+void vesp_network_stop(vesp_network* network) {
+    if (network) network->network.stop();
+}
+
+size_t vesp_network_pump(vesp_network* network) {
+    return network ? network->network.pump() : 0;
+}
+
+int vesp_network_send(vesp_network* network, unsigned node, unsigned destination, const uint8_t* data, size_t length) {
+    if (!network || (!data && length) || length > VirtualNetwork::MAX_PAYLOAD) return VESP_ERROR_INVALID_ARGUMENT;
+
+    VirtualNetwork::Port* port = network->hostPort(node);
+    if (!port) return VESP_ERROR_INVALID_ARGUMENT;
+    return port->send(static_cast<uint16_t>(destination), data, length) ? VESP_OK : VESP_ERROR_MEMORY;
+}
+
+int vesp_network_receive(vesp_network* network, unsigned node, unsigned* source, uint8_t* buffer, size_t capacity) {
+    if (!network || (!buffer && capacity)) return VESP_ERROR_INVALID_ARGUMENT;
+
+    VirtualNetwork::Port* port = network->hostPort(node);
+    if (!port) return VESP_ERROR_INVALID_ARGUMENT;
+
+    const VirtualNetwork::Packet* packet = port->peek();
+    if (!packet) return 0;
+
+    size_t length = std::min<size_t>(packet->length, capacity);
+    if (length) std::memcpy(buffer, packet->data, length);
+    if (source) *source = packet->source;
+    port->consume();
+    return static_cast<int>(length);
+}
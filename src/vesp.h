@@ -0,0 +1,239 @@
+#pragma once
+
+/*
+ * libvesp - C API for driving the emulator in-process.
+ *
+ * Every function taking a vesp_emulator* is safe to call with NULL and
+ * reports VESP_ERROR_INVALID_ARGUMENT. Functions that can fail return
+ * VESP_OK (0) or a negative vesp_status; vesp_last_error() then describes
+ * the most recent failure on that instance.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vesp_emulator vesp_emulator;
+
+typedef enum {
+    VESP_OK = 0,
+    VESP_ERROR_INVALID_ARGUMENT = -1,
+    VESP_ERROR_MEMORY = -2,
+    VESP_ERROR_EMULATION = -3
+} vesp_status;
+
+/* Register indices for vesp_get_register / vesp_set_register */
+#define VESP_REG_A0 0
+#define VESP_REG_A15 15
+#define VESP_REG_PC 16
+
+vesp_emulator* vesp_create(void);
+/* Same, with the memory map, peripherals and clock from a SoC description
+ * file (see soc/esp32.soc). Returns NULL if the file is missing or invalid. */
+vesp_emulator* vesp_create_with_soc(const char* path);
+void vesp_destroy(vesp_emulator* emu);
+
+/*
+ * Pool of emulators that have already loaded one firmware image, for test
+ * suites that want a fresh device per test without paying for it. An
+ * acquired emulator is at the firmware entry point with power-on CPU and
+ * peripheral state; vesp_destroy() resets it (restoring only the RAM the
+ * test wrote) and returns it to the pool. soc_path NULL means the default
+ * ESP32. Acquire is thread-safe; destroy the pool after every emulator
+ * taken from it.
+ */
+typedef struct vesp_pool vesp_pool;
+
+vesp_pool* vesp_pool_create(const char* soc_path, const uint8_t* firmware, size_t size, size_t count);
+void vesp_pool_destroy(vesp_pool* pool);
+/* Builds another instance when none are idle */
+vesp_emulator* vesp_pool_acquire(vesp_pool* pool);
+size_t vesp_pool_available(vesp_pool* pool);
+
+int vesp_load_firmware(vesp_emulator* emu, const uint8_t* data, size_t size);
+
+/* Runs until maxCycles have executed or the firmware stops. Returns the
+ * number of cycles executed. */
+uint64_t vesp_run(vesp_emulator* emu, uint64_t maxCycles);
+void vesp_stop(vesp_emulator* emu);
+int vesp_is_running(const vesp_emulator* emu);
+uint64_t vesp_get_cycles(const vesp_emulator* emu);
+
+/* Control from another thread while vesp_run is going. Requests are picked
+ * up within a few thousand guest cycles, never block the emulator thread,
+ * and a pause or stop posted while idle applies to the next vesp_run. The
+ * peek functions wait for the emulator thread to copy the data out, so
+ * they return a consistent view even mid-run (or while paused). */
+void vesp_pause(vesp_emulator* emu);
+void vesp_unpause(vesp_emulator* emu);
+void vesp_request_stop(vesp_emulator* emu);
+int vesp_is_paused(const vesp_emulator* emu);
+/* regs receives a0-a15 followed by the PC */
+int vesp_peek_registers(vesp_emulator* emu, uint32_t regs[17], uint64_t* cycles);
+int vesp_peek_memory(vesp_emulator* emu, uint32_t address, void* buffer, size_t length);
+
+int vesp_read_memory(vesp_emulator* emu, uint32_t address, void* buffer, size_t length);
+int vesp_write_memory(vesp_emulator* emu, uint32_t address, const void* buffer, size_t length);
+
+/* Guest clock (default 240 MHz). With pacing on, vesp_run sleeps so that
+ * cycles track wall time; idle sleep stops a core parked in WAITI from
+ * spinning a host CPU. */
+int vesp_set_clock(vesp_emulator* emu, uint64_t hz);
+int vesp_set_pacing(vesp_emulator* emu, int enabled);
+int vesp_set_idle_sleep(vesp_emulator* emu, int enabled);
+
+int vesp_get_register(const vesp_emulator* emu, unsigned reg, uint32_t* value);
+int vesp_set_register(vesp_emulator* emu, unsigned reg, uint32_t value);
+
+/* Queues bytes for the guest to read from the UART data register */
+int vesp_uart_inject(vesp_emulator* emu, const uint8_t* data, size_t length);
+
+/* Drains captured UART output into the caller's buffer. Returns the number
+ * of bytes copied; vesp_uart_pending() reports how many remain. */
+size_t vesp_uart_read(vesp_emulator* emu, uint8_t* buffer, size_t capacity);
+size_t vesp_uart_pending(const vesp_emulator* emu);
+
+const char* vesp_last_error(const vesp_emulator* emu);
+
+/*
+ * Symbol index built from a firmware ELF. One index can be attached to any
+ * number of emulators; each holds a reference, so releasing the handle
+ * after attaching is fine.
+ */
+typedef struct vesp_symbols vesp_symbols;
+
+vesp_symbols* vesp_symbols_load(const uint8_t* elf, size_t size);
+void vesp_symbols_release(vesp_symbols* symbols);
+int vesp_set_symbols(vesp_emulator* emu, const vesp_symbols* symbols);
+
+/* Writes "0x400800a4 <func+0x1c>" (NUL-terminated, truncated to capacity).
+ * Returns the untruncated length. */
+size_t vesp_symbolize(const vesp_symbols* symbols, uint32_t address, char* buffer, size_t capacity);
+
+/*
+ * Guest code coverage: one bit per executed instruction address in every RAM
+ * region, aliased windows included.
+ * Bitmaps from parallel instances (or saved runs) merge by OR; the lcov
+ * export maps them to source lines via the firmware ELF's .debug_line.
+ */
+int vesp_coverage_enable(vesp_emulator* emu);
+const uint8_t* vesp_coverage_bitmap(const vesp_emulator* emu, size_t* size);
+int vesp_coverage_merge(vesp_emulator* emu, const uint8_t* bitmap, size_t size);
+int vesp_coverage_write_lcov(vesp_emulator* emu, const uint8_t* elf, size_t elf_size, const char* path);
+
+/* Runs memcpy, memmove, memset, memcmp, strlen and ets_printf natively
+ * when the PC reaches their symbol addresses (call0 ABI). Needs symbols
+ * from an ELF image. Returns how many routines were bound, or a negative
+ * vesp_status. */
+int vesp_intercepts_enable(vesp_emulator* emu);
+
+/* GPIO pins from outside the chip. vesp_gpio_drive sets the level of the
+ * masked pins wherever the guest isn't driving them as outputs, and
+ * vesp_gpio_release lets them float back to their pull-ups.
+ * vesp_gpio_capture streams every pin change to a VCD file from a
+ * background thread; pass NULL to finish and close the file. */
+int vesp_gpio_drive(vesp_emulator* emu, uint32_t mask, uint32_t levels);
+int vesp_gpio_release(vesp_emulator* emu, uint32_t mask);
+int vesp_gpio_levels(const vesp_emulator* emu, uint32_t* levels);
+int vesp_gpio_capture(vesp_emulator* emu, const char* vcd_path);
+
+/* Maps the POSIX shared-memory segment name (e.g. "/vesp-sensor") into the
+ * peripheral space at base_address, creating it with data_size bytes if it
+ * doesn't exist. See vesp_shm.h for the layout and the sequence protocol a
+ * host process uses to write into it. */
+int vesp_shm_attach(vesp_emulator* emu, const char* name, uint32_t data_size, uint32_t base_address);
+
+/* Writes a checkpoint to path every interval_cycles while the emulator runs.
+ * Only pages written since the previous checkpoint are saved, and the
+ * compression and disk I/O happen on a background thread. */
+int vesp_checkpoint_enable(vesp_emulator* emu, const char* path, uint64_t interval_cycles);
+
+/* Restores the last complete checkpoint in path. Enable the same
+ * peripherals as the original run before calling this. */
+int vesp_resume(vesp_emulator* emu, const char* path);
+
+/*
+ * Persistent-mode fuzzing. vesp_fuzz_setup() runs the loaded firmware until
+ * the PC reaches entry_address and snapshots it; each vesp_fuzz_run() then
+ * restores that snapshot, injects the input and runs until exit_address,
+ * a fault, or max_cycles. Branch edges are counted into the coverage map,
+ * which is either internal, the caller's (e.g. libFuzzer extra counters or
+ * __afl_area_ptr) or the AFL shared memory segment named by __AFL_SHM_ID.
+ */
+typedef enum {
+    VESP_FUZZ_INPUT_UART = 0,
+    VESP_FUZZ_INPUT_MEMORY = 1  /* copied to input_address, a2/a3 = (buffer, length) */
+} vesp_fuzz_input_mode;
+
+typedef enum {
+    VESP_FUZZ_COMPLETED = 0,
+    VESP_FUZZ_TIMEOUT = 1,
+    VESP_FUZZ_CRASHED = 2
+} vesp_fuzz_result;
+
+typedef struct {
+    uint32_t entry_address;
+    uint32_t exit_address;
+    uint64_t max_cycles;
+    uint64_t max_boot_cycles;
+    vesp_fuzz_input_mode input_mode;
+    uint32_t input_address;
+    uint32_t input_capacity;
+} vesp_fuzz_config;
+
+int vesp_fuzz_setup(vesp_emulator* emu, const vesp_fuzz_config* config);
+int vesp_fuzz_set_coverage_map(vesp_emulator* emu, uint8_t* map, size_t size);
+int vesp_fuzz_attach_afl_map(vesp_emulator* emu);
+const uint8_t* vesp_fuzz_coverage_map(const vesp_emulator* emu, size_t* size);
+
+/* Returns a vesp_fuzz_result, or a negative vesp_status on misuse */
+int vesp_fuzz_run(vesp_emulator* emu, const uint8_t* data, size_t size);
+
+/*
+ * Socket backend for the WiFi HTTP registers. Requests run on the
+ * backend's own I/O thread, so the guest keeps executing while the host
+ * talks to the server. Firmware hostnames are mapped to local endpoints;
+ * unmapped names fail. One backend can serve any number of emulators.
+ */
+typedef struct vesp_http_backend vesp_http_backend;
+
+vesp_http_backend* vesp_http_backend_create(void);
+void vesp_http_backend_release(vesp_http_backend* backend);
+int vesp_http_backend_add_endpoint(vesp_http_backend* backend, const char* host, const char* address, uint16_t port);
+int vesp_set_http_backend(vesp_emulator* emu, const vesp_http_backend* backend);
+
+/*
+ * In-process network switch. Attaching an emulator maps its WiFi
+ * peripheral and makes it a node; host nodes let the caller exchange
+ * packets with the fleet (e.g. a fake gateway). Add every node before
+ * vesp_network_start(); an emulator joins at most one network. Destroying
+ * the network detaches its emulators, so stop running them first. Each
+ * node must only be driven from one thread at a time.
+ */
+typedef struct vesp_network vesp_network;
+
+#define VESP_NETWORK_BROADCAST 0xFFFF
+
+vesp_network* vesp_network_create(uint64_t latency_cycles);
+void vesp_network_destroy(vesp_network* network);
+
+/* Both return the new node id, or a negative vesp_status */
+int vesp_network_attach(vesp_network* network, vesp_emulator* emu);
+int vesp_network_add_host(vesp_network* network);
+
+/* Routes queued packets on a background thread, or once per pump call */
+int vesp_network_start(vesp_network* network);
+void vesp_network_stop(vesp_network* network);
+size_t vesp_network_pump(vesp_network* network);
+
+/* Host nodes only. receive returns the payload length (truncated to
+ * capacity), 0 if nothing is waiting, or a negative vesp_status. */
+int vesp_network_send(vesp_network* network, unsigned node, unsigned destination, const uint8_t* data, size_t length);
+int vesp_network_receive(vesp_network* network, unsigned node, unsigned* source, uint8_t* buffer, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,57 @@
+#ifndef VESP_SHM_H
+#define VESP_SHM_H
+
+/*
+ * Layout of a shared-memory peripheral segment, for host processes that
+ * feed a running emulator (sensor simulators, test drivers).
+ *
+ * The segment is a vesp_shm_header followed by data_size bytes that the
+ * guest sees at window offset VESP_SHM_DATA_OFFSET. Host writes follow a
+ * sequence lock: bump host_sequence to odd, write the data, bump it back
+ * to even. Readers (the guest, through the SEQUENCE register) retry while
+ * the sequence is odd or changed under them. The guest signals its own
+ * writes by bumping guest_sequence through the COMMIT register.
+ *
+ * Header only, usable from C and C++ (GCC/Clang atomics).
+ */
+
+#include <stdint.h>
+
+#define VESP_SHM_MAGIC 0x4D485356u  /* "VSHM" */
+#define VESP_SHM_VERSION 1u
+
+/* Guest-visible window, relative to the peripheral base */
+#define VESP_SHM_SEQUENCE 0x00  /* R:  host_sequence */
+#define VESP_SHM_ACK 0x04       /* RW: last sequence the guest consumed */
+#define VESP_SHM_COMMIT 0x08    /* W:  any write bumps guest_sequence */
+#define VESP_SHM_SIZE 0x0C      /* R:  data_size */
+#define VESP_SHM_DATA_OFFSET 0x40
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t data_size;
+    uint32_t reserved;
+    uint32_t host_sequence;
+    uint32_t guest_sequence;
+    uint32_t padding[10];
+} vesp_shm_header;
+
+static inline uint8_t* vesp_shm_data(vesp_shm_header* header) {
+    return (uint8_t*)(header + 1);
+}
+
+static inline void vesp_shm_write_begin(vesp_shm_header* header) {
+    __atomic_fetch_add(&header->host_sequence, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void vesp_shm_write_end(vesp_shm_header* header) {
+    __atomic_fetch_add(&header->host_sequence, 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t vesp_shm_guest_sequence(const vesp_shm_header* header) {
+    return __atomic_load_n(&header->guest_sequence, __ATOMIC_ACQUIRE);
+}
+
+#endif